@@ -7,17 +7,23 @@
 
 #include <atomic>
 #include <chrono>
+#include <errno.h>
 #include <inttypes.h>
+#include <limits>
+#include <memory>
 #include <mutex>
 #include <signal.h>
 #include <stdarg.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string>
 #include <sys/stat.h>
+#include <vector>
 
 #include "../../public/common/TracyProtocol.hpp"
 #include "../../public/common/TracyStackFrames.hpp"
+#include "../../server/TracyFileRead.hpp"
 #include "../../server/TracyFileWrite.hpp"
 #include "../../server/TracyMemory.hpp"
 #include "../../server/TracyPrint.hpp"
@@ -90,10 +96,218 @@ void AnsiPrintf( const char* ansiEscape, const char* format, ... ) {
 
 [[noreturn]] void Usage()
 {
-    printf( "Usage: capture -o output.tracy [-a address] [-p port] [-f] [-s seconds]\n" );
+    printf( "Usage: capture -o output.tracy [-a address] [-p port] [-f] [-s seconds] [-b frames] [-m megabytes] [-r [-c seconds]]\n" );
+    printf( "       capture -o output.tracy [-a address] [-p port] [-f] [-s seconds] [-b frames] [-m megabytes] [-w seconds] [-l megabytes] [-k message]\n" );
+    printf( "       capture -o output.tracy [-a address]... [-p port] [-n ports] [-f] [-s seconds] [-b frames] [-m megabytes] [-r [-c seconds]]\n" );
     exit( 1 );
 }
 
+static uint64_t ParseMegabytes( const char* str )
+{
+    char* end;
+    errno = 0;
+    const auto mb = strtoull( str, &end, 10 );
+    if( *str < '0' || *str > '9' || *end != '\0' || errno == ERANGE || mb > std::numeric_limits<uint64_t>::max() / ( 1024 * 1024 ) ) Usage();
+    return uint64_t( mb ) * 1024 * 1024;
+}
+
+void InstallSignalHandlers()
+{
+#ifdef _WIN32
+    signal( SIGINT, SigInt );
+#else
+    struct sigaction sigint, oldsigint;
+    memset( &sigint, 0, sizeof( sigint ) );
+    sigint.sa_handler = SigInt;
+    sigaction( SIGINT, &sigint, &oldsigint );
+    // SIGUSR1 does the same, so that other processes can have a flight recording saved.
+    struct sigaction sigusr1, oldsigusr1;
+    memset( &sigusr1, 0, sizeof( sigusr1 ) );
+    sigusr1.sa_handler = SigInt;
+    sigaction( SIGUSR1, &sigusr1, &oldsigusr1 );
+#endif
+}
+
+// Captures several clients at once, for example all the processes of a parallel job, each into its own
+// output file. Every address is tried on a range of consecutive ports, as clients running on the same
+// host listen on the next free port. The workers share the ingest thread pool.
+int CaptureMultiple( const std::vector<const char*>& addresses, int port, int ports, const char* output, bool overwrite, int seconds, int netBufferDepth, uint64_t memoryLimit, bool recordStream, int checkpoint )
+{
+    struct Client
+    {
+        std::string address;
+        int port;
+        std::string output;
+        std::unique_ptr<tracy::FileWrite> stream;
+        std::unique_ptr<tracy::Worker> worker;
+        bool failed;
+    };
+
+    // Output trace.tracy becomes trace.0.tracy, trace.1.tracy and so on.
+    std::string base = output;
+    std::string ext;
+    const auto dot = base.rfind( '.' );
+    const auto slash = base.find_last_of( "/\\" );
+    if( dot != std::string::npos && ( slash == std::string::npos || dot > slash ) )
+    {
+        ext = base.substr( dot );
+        base.resize( dot );
+    }
+
+    std::vector<Client> clients;
+    for( auto& addr : addresses )
+    {
+        for( int i=0; i<ports; i++ )
+        {
+            clients.emplace_back( Client { addr, port + i, base + "." + std::to_string( clients.size() ) + ext, nullptr, nullptr, false } );
+        }
+    }
+
+    for( auto& client : clients )
+    {
+        struct stat st;
+        if( stat( client.output.c_str(), &st ) == 0 && !overwrite )
+        {
+            printf( "Output file %s already exists! Use -f to force overwrite.\n", client.output.c_str() );
+            return 4;
+        }
+        if( recordStream )
+        {
+            // Each client's network thread compresses its own stream, so the work follows the event rate.
+            client.stream.reset( tracy::FileWrite::Open( client.output.c_str(), tracy::FileWrite::Compression::Fast, 1, 0 ) );
+            if( !client.stream )
+            {
+                printf( "Cannot open output file %s for writing!\n", client.output.c_str() );
+                return 5;
+            }
+        }
+    }
+
+    for( auto& client : clients )
+    {
+        printf( "%s:%i -> %s\n", client.address.c_str(), client.port, client.output.c_str() );
+        client.worker = std::make_unique<tracy::Worker>( client.address.c_str(), client.port, netBufferDepth, client.stream.get() );
+        client.worker->SetMemoryLimit( memoryLimit );
+        client.worker->SetCheckpointInterval( checkpoint );
+    }
+    InstallSignalHandlers();
+
+    const auto t0 = std::chrono::high_resolution_clock::now();
+    for(;;)
+    {
+        if( s_disconnect.load( std::memory_order_relaxed ) )
+        {
+            for( auto& client : clients ) client.worker->Disconnect();
+            break;
+        }
+
+        // Clients which have not connected yet are waited for until one of the clients has connected. After that
+        // the capture ends when all the connected clients have disconnected, as some of the scanned ports may
+        // never be used.
+        size_t waiting = 0;
+        size_t finished = 0;
+        size_t connected = 0;
+        float mbps = 0;
+        for( auto& client : clients )
+        {
+            auto& worker = *client.worker;
+            const auto handshake = worker.GetHandshakeStatus();
+            if( handshake == tracy::HandshakeProtocolMismatch || handshake == tracy::HandshakeNotAvailable || handshake == tracy::HandshakeDropped )
+            {
+                if( !client.failed )
+                {
+                    client.failed = true;
+                    printf( "%s%s:%i: connection handshake failed\n", IsStdoutATerminal() ? "\r" ANSI_ERASE_LINE : "", client.address.c_str(), client.port );
+                }
+                continue;
+            }
+            if( !worker.HasData() )
+            {
+                waiting++;
+            }
+            else if( !worker.IsConnected() )
+            {
+                finished++;
+            }
+            else
+            {
+                connected++;
+                auto& lock = worker.GetMbpsDataLock();
+                lock.lock();
+                mbps += worker.GetMbpsData().back();
+                lock.unlock();
+            }
+        }
+        if( connected == 0 && ( waiting == 0 || finished != 0 ) ) break;
+
+        if( IsStdoutATerminal() )
+        {
+            AnsiPrintf( ANSI_ERASE_LINE ANSI_GREEN ANSI_BOLD, "\r%zu/%zu", connected, clients.size() );
+            printf( " connected | " );
+            AnsiPrintf( ANSI_CYAN ANSI_BOLD, "%7.2f Mbps", mbps );
+            printf( " | " );
+            AnsiPrintf( ANSI_RED ANSI_BOLD, "%s", tracy::MemSizeToString( tracy::memUsage ) );
+            fflush( stdout );
+        }
+
+        std::this_thread::sleep_for( std::chrono::milliseconds( 100 ) );
+        if( seconds != -1 )
+        {
+            const auto dur = std::chrono::high_resolution_clock::now() - t0;
+            if( std::chrono::duration_cast<std::chrono::seconds>(dur).count() >= seconds )
+            {
+                s_disconnect.store( true, std::memory_order_relaxed );
+            }
+        }
+    }
+    printf( "\n" );
+
+    for( auto& client : clients )
+    {
+        auto& worker = *client.worker;
+        while( worker.IsConnected() ) std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+        if( !worker.HasData() )
+        {
+            if( client.stream )
+            {
+                client.stream.reset();
+                unlink( client.output.c_str() );
+            }
+            continue;
+        }
+
+        printf( "%s:%i: zones: %s", client.address.c_str(), client.port, tracy::RealToString( worker.GetZoneCount() ) );
+        const auto failure = worker.GetFailureType();
+        if( failure != tracy::Worker::Failure::None )
+        {
+            AnsiPrintf( ANSI_RED ANSI_BOLD, " (instrumentation failure: %s)", tracy::Worker::GetFailureString( failure ) );
+        }
+        printf( ", saving %s...", client.output.c_str() );
+        fflush( stdout );
+        if( client.stream )
+        {
+            client.stream->Finish();
+            AnsiPrintf( ANSI_GREEN ANSI_BOLD, " done!\n" );
+            continue;
+        }
+        auto f = std::unique_ptr<tracy::FileWrite>( tracy::FileWrite::Open( client.output.c_str() ) );
+        if( f )
+        {
+            worker.Write( *f, false );
+            f->Finish();
+            AnsiPrintf( ANSI_GREEN ANSI_BOLD, " done!\n" );
+        }
+        else
+        {
+            AnsiPrintf( ANSI_RED ANSI_BOLD, " failed!\n" );
+        }
+        // Each trace is freed as soon as it is saved.
+        client.worker.reset();
+    }
+
+    return 0;
+}
+
 int main( int argc, char** argv )
 {
 #ifdef _WIN32
@@ -107,18 +321,25 @@ int main( int argc, char** argv )
     InitIsStdoutATerminal();
 
     bool overwrite = false;
-    const char* address = "127.0.0.1";
+    std::vector<const char*> addresses;
     const char* output = nullptr;
     int port = 8086;
+    int ports = 1;
     int seconds = -1;
+    int netBufferDepth = tracy::Worker::DefaultNetBufferDepth;
+    uint64_t memoryLimit = 0;
+    bool recordStream = false;
+    int checkpoint = 0;
+    bool flightRecorder = false;
+    tracy::Worker::FlightRecorder recorder;
 
     int c;
-    while( ( c = getopt( argc, argv, "a:o:p:fs:" ) ) != -1 )
+    while( ( c = getopt( argc, argv, "a:o:p:n:fs:b:m:rc:w:l:k:" ) ) != -1 )
     {
         switch( c )
         {
         case 'a':
-            address = optarg;
+            addresses.push_back( optarg );
             break;
         case 'o':
             output = optarg;
@@ -126,19 +347,55 @@ int main( int argc, char** argv )
         case 'p':
             port = atoi( optarg );
             break;
+        case 'n':
+            ports = atoi( optarg );
+            break;
         case 'f':
             overwrite = true;
             break;
         case 's':
             seconds = atoi (optarg);
             break;
+        case 'b':
+            netBufferDepth = atoi( optarg );
+            break;
+        case 'm':
+            memoryLimit = ParseMegabytes( optarg );
+            break;
+        case 'r':
+            recordStream = true;
+            break;
+        case 'c':
+            checkpoint = atoi( optarg );
+            break;
+        case 'w':
+            flightRecorder = true;
+            recorder.seconds = atoi( optarg );
+            break;
+        case 'l':
+            flightRecorder = true;
+            recorder.size = ParseMegabytes( optarg );
+            break;
+        case 'k':
+            flightRecorder = true;
+            recorder.freezeMessage = optarg;
+            break;
         default:
             Usage();
             break;
         }
     }
 
-    if( !address || !output ) Usage();
+    if( !output || ports < 1 ) Usage();
+    if( recordStream && flightRecorder ) Usage();
+    if( checkpoint < 0 || ( checkpoint > 0 && !recordStream ) ) Usage();
+    if( addresses.empty() ) addresses.push_back( "127.0.0.1" );
+    if( addresses.size() > 1 || ports > 1 )
+    {
+        if( flightRecorder ) Usage();
+        return CaptureMultiple( addresses, port, ports, output, overwrite, seconds, netBufferDepth, memoryLimit, recordStream, checkpoint );
+    }
+    const auto address = addresses[0];
 
     struct stat st;
     if( stat( output, &st ) == 0 && !overwrite )
@@ -147,18 +404,35 @@ int main( int argc, char** argv )
         return 4;
     }
 
-    FILE* test = fopen( output, "wb" );
-    if( !test )
+    // In stream recording mode the received events go straight to the output file, to be converted
+    // into a trace with the update utility later.
+    std::unique_ptr<tracy::FileWrite> stream;
+    if( recordStream )
+    {
+        stream.reset( tracy::FileWrite::Open( output, tracy::FileWrite::Compression::Fast, 1, 1 ) );
+        if( !stream )
+        {
+            printf( "Cannot open output file %s for writing!\n", output );
+            return 5;
+        }
+    }
+    else
     {
-        printf( "Cannot open output file %s for writing!\n", output );
-        return 5;
+        FILE* test = fopen( output, "wb" );
+        if( !test )
+        {
+            printf( "Cannot open output file %s for writing!\n", output );
+            return 5;
+        }
+        fclose( test );
+        unlink( output );
     }
-    fclose( test );
-    unlink( output );
 
     printf( "Connecting to %s:%i...", address, port );
     fflush( stdout );
-    tracy::Worker worker( address, port );
+    tracy::Worker worker( address, port, netBufferDepth, stream.get(), flightRecorder ? &recorder : nullptr );
+    worker.SetMemoryLimit( memoryLimit );
+    worker.SetCheckpointInterval( checkpoint );
     while( !worker.HasData() )
     {
         const auto handshake = worker.GetHandshakeStatus();
@@ -181,19 +455,13 @@ int main( int argc, char** argv )
     }
     printf( "\nQueue delay: %s\nTimer resolution: %s\n", tracy::TimeToString( worker.GetDelay() ), tracy::TimeToString( worker.GetResolution() ) );
 
-#ifdef _WIN32
-    signal( SIGINT, SigInt );
-#else
-    struct sigaction sigint, oldsigint;
-    memset( &sigint, 0, sizeof( sigint ) );
-    sigint.sa_handler = SigInt;
-    sigaction( SIGINT, &sigint, &oldsigint );
-#endif
+    InstallSignalHandlers();
 
     const auto firstTime = worker.GetFirstTime();
     auto& lock = worker.GetMbpsDataLock();
 
     const auto t0 = std::chrono::high_resolution_clock::now();
+    bool disconnectIssued = false;
     while( worker.IsConnected() )
     {
         // Relaxed order is sufficient here because `s_disconnect` is only ever
@@ -201,7 +469,16 @@ int main( int argc, char** argv )
         // nothing else than storing `s_disconnect`.
         if( s_disconnect.load( std::memory_order_relaxed ) )
         {
-            worker.Disconnect();
+            // The flight recorder stops keeping new events, but still waits for the pending query responses.
+            if( flightRecorder )
+            {
+                worker.FreezeFlightRecording();
+            }
+            else
+            {
+                worker.Disconnect();
+            }
+            disconnectIssued = true;
             // Relaxed order is sufficient because only this thread ever reads
             // this value.
             s_disconnect.store(false, std::memory_order_relaxed );
@@ -331,6 +608,70 @@ int main( int argc, char** argv )
         }
     }
 
+    if( stream )
+    {
+        while( worker.IsConnected() ) std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+        printf( "\nZones: %s\nElapsed time: %s\nSaving event stream...", tracy::RealToString( worker.GetZoneCount() ),
+            tracy::TimeToString( std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count() ) );
+        stream->Finish();
+        AnsiPrintf( ANSI_GREEN ANSI_BOLD, " done!\n" );
+        const auto stats = stream->GetCompressionStatistics();
+        printf( "Event stream size %s (%.2f%% ratio)\n", tracy::MemSizeToString( stats.second ), 100.f * stats.second / stats.first );
+        return 0;
+    }
+
+    if( flightRecorder )
+    {
+        while( worker.IsConnected() ) std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+        if( !disconnectIssued && worker.IsFlightRecordingFrozen() ) printf( worker.IsTimelineDropped() ? "\nMemory budget reached." : "\nFreeze message received." );
+        printf( "\nSaving flight recording..." );
+        fflush( stdout );
+
+        // The kept events are written out as an event stream, which is then converted into a trace.
+        const auto tmp = std::string( output ) + ".stream";
+        auto sf = std::unique_ptr<tracy::FileWrite>( tracy::FileWrite::Open( tmp.c_str() ) );
+        if( !sf )
+        {
+            AnsiPrintf( ANSI_RED ANSI_BOLD, " failed!\n" );
+            return 0;
+        }
+        worker.WriteFlightRecording( *sf );
+        sf->Finish();
+        sf.reset();
+
+        auto sr = std::unique_ptr<tracy::FileRead>( tracy::FileRead::Open( tmp.c_str() ) );
+        if( !sr )
+        {
+            AnsiPrintf( ANSI_RED ANSI_BOLD, " failed!\n" );
+            return 0;
+        }
+        try
+        {
+            tracy::Worker trace( *sr, tracy::EventType::All, false );
+            sr.reset();
+            unlink( tmp.c_str() );
+            auto f = std::unique_ptr<tracy::FileWrite>( tracy::FileWrite::Open( output ) );
+            if( !f )
+            {
+                AnsiPrintf( ANSI_RED ANSI_BOLD, " failed!\n" );
+                return 0;
+            }
+            trace.Write( *f, false );
+            AnsiPrintf( ANSI_GREEN ANSI_BOLD, " done!\n" );
+            f->Finish();
+            const auto stats = f->GetCompressionStatistics();
+            printf( "Time span: %s\nZones: %s\nTrace size %s (%.2f%% ratio)\n", tracy::TimeToString( trace.GetLastTime() - trace.GetFirstTime() ),
+                tracy::RealToString( trace.GetZoneCount() ), tracy::MemSizeToString( stats.second ), 100.f * stats.second / stats.first );
+        }
+        catch( const tracy::LoadFailure& e )
+        {
+            AnsiPrintf( ANSI_RED ANSI_BOLD, " failed!\n" );
+            printf( "%s\n", e.what() );
+            unlink( tmp.c_str() );
+        }
+        return 0;
+    }
+
     printf( "\nFrames: %" PRIu64 "\nTime span: %s\nZones: %s\nElapsed time: %s\nSaving trace...",
         worker.GetFrameCount( *worker.GetFramesBase() ), tracy::TimeToString( worker.GetLastTime() - firstTime ), tracy::RealToString( worker.GetZoneCount() ),
         tracy::TimeToString( std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count() ) );
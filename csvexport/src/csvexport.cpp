@@ -268,7 +268,7 @@ int main(int argc, char** argv)
         return 1;
     }
 
-    auto worker = tracy::Worker(*f);
+    auto worker = tracy::Worker(*f, tracy::EventType::Messages);
 
     if (args.unwrapMessages)
     {
@@ -0,0 +1,12 @@
+CFLAGS +=
+CXXFLAGS := $(CFLAGS) -std=gnu++17
+DEFINES += -DTRACY_NO_STATISTICS
+INCLUDES := $(shell pkg-config --cflags capstone)
+LIBS := $(shell pkg-config --libs capstone) -lpthread
+PROJECT := merge
+IMAGE := $(PROJECT)-$(BUILD)
+
+FILTER :=
+include ../../../common/src-from-vcxproj.mk
+
+include ../../../common/unix.mk
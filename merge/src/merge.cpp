@@ -0,0 +1,205 @@
+#ifdef _WIN32
+#  include <windows.h>
+#endif
+
+#include <chrono>
+#include <memory>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <unordered_map>
+
+#include "../../server/TracyFileRead.hpp"
+#include "../../server/TracyFileWrite.hpp"
+#include "../../server/TracyPrint.hpp"
+#include "../../server/TracyWorker.hpp"
+#include "../../zstd/zstd.h"
+#include "../../getopt/getopt.h"
+
+void Usage()
+{
+    printf( "Usage: merge [options] output.tracy input1.tracy input2.tracy [...]\n\n" );
+    printf( "  -s text: align the traces on the first message containing text\n" );
+    printf( "  -h: enable LZ4HC compression\n" );
+    printf( "  -e: enable extreme LZ4HC compression (very slow)\n" );
+    printf( "  -z level: use Zstd compression with given compression level\n" );
+    printf( "\n  Without -s the traces are aligned on their capture start time, which has one second resolution.\n" );
+    printf( "  Each input is shifted by a single offset. Clock drift between the traces is not corrected.\n" );
+    printf( "  Zones, messages, frames and plots are merged. Other data is not carried over.\n" );
+    printf( "  The merge is done in memory. The merged trace is kept whole, along with one input at a time,\n" );
+    printf( "  so the available memory must fit the sum of the inputs plus the largest one.\n" );
+
+    exit( 1 );
+}
+
+static bool FindMarker( const tracy::Worker& worker, const char* marker, int64_t& time )
+{
+    for( auto& v : worker.GetMessages() )
+    {
+        if( strstr( worker.GetString( v->ref ), marker ) )
+        {
+            time = v->time;
+            return true;
+        }
+    }
+    return false;
+}
+
+int main( int argc, char** argv )
+{
+#ifdef _WIN32
+    if( !AttachConsole( ATTACH_PARENT_PROCESS ) )
+    {
+        AllocConsole();
+        SetConsoleMode( GetStdHandle( STD_OUTPUT_HANDLE ), 0x07 );
+    }
+#endif
+
+    tracy::FileWrite::Compression clev = tracy::FileWrite::Compression::Fast;
+    int zstdLevel = 1;
+    const char* marker = nullptr;
+
+    int c;
+    while( ( c = getopt( argc, argv, "s:hez:" ) ) != -1 )
+    {
+        switch( c )
+        {
+        case 's':
+            marker = optarg;
+            break;
+        case 'h':
+            clev = tracy::FileWrite::Compression::Slow;
+            break;
+        case 'e':
+            clev = tracy::FileWrite::Compression::Extreme;
+            break;
+        case 'z':
+            clev = tracy::FileWrite::Compression::Zstd;
+            zstdLevel = atoi( optarg );
+            if( zstdLevel > ZSTD_maxCLevel() || zstdLevel < ZSTD_minCLevel() )
+            {
+                printf( "Available Zstd compression levels range: %i - %i\n", ZSTD_minCLevel(), ZSTD_maxCLevel() );
+                exit( 1 );
+            }
+            break;
+        default:
+            Usage();
+            break;
+        }
+    }
+
+    if( argc < optind + 3 ) Usage();
+
+    const char* output = argv[optind];
+    const auto t0 = std::chrono::high_resolution_clock::now();
+
+    // Inputs are loaded one at a time and freed once merged, so only the merged trace and a single input are kept in memory.
+    std::unique_ptr<tracy::Worker> merged;
+    std::unordered_map<std::string, int> programs;
+    uint64_t refCaptureTime = 0;
+    int64_t refMarker = 0;
+
+    try
+    {
+        for( int i=optind+1; i<argc; i++ )
+        {
+            const char* input = argv[i];
+            printf( "Loading %s...\n", input );
+            fflush( stdout );
+            auto f = std::unique_ptr<tracy::FileRead>( tracy::FileRead::Open( input ) );
+            if( !f )
+            {
+                fprintf( stderr, "Cannot open input file %s!\n", input );
+                exit( 1 );
+            }
+            tracy::Worker worker( *f, tracy::EventType::Type( tracy::EventType::Messages | tracy::EventType::Plots ), false );
+
+            int64_t time = 0;
+            if( marker && !FindMarker( worker, marker, time ) )
+            {
+                fprintf( stderr, "Message \"%s\" not found in %s!\n", marker, input );
+                exit( 1 );
+            }
+
+            int64_t offset = 0;
+            if( !merged )
+            {
+                merged = std::make_unique<tracy::Worker>( worker.GetCaptureName().c_str(), worker.GetCaptureProgram().c_str() );
+                refCaptureTime = worker.GetCaptureTime();
+                refMarker = time;
+            }
+            else if( marker )
+            {
+                offset = refMarker - time;
+            }
+            else
+            {
+                offset = ( int64_t( worker.GetCaptureTime() ) - int64_t( refCaptureTime ) ) * 1000000000ll;
+            }
+            if( offset < 0 )
+            {
+                fprintf( stderr, "Warning: %s starts before the first input, list the earliest trace first.\n", input );
+            }
+
+            std::string prefix = worker.GetCaptureProgram();
+            if( prefix.empty() ) prefix = input;
+            const auto cnt = ++programs[prefix];
+            if( cnt > 1 ) prefix += " #" + std::to_string( cnt );
+
+            merged->Merge( worker, offset, prefix.c_str() );
+        }
+
+        auto w = std::unique_ptr<tracy::FileWrite>( tracy::FileWrite::Open( output, clev, zstdLevel ) );
+        if( !w )
+        {
+            fprintf( stderr, "Cannot open output file!\n" );
+            exit( 1 );
+        }
+        printf( "Saving...\n" );
+        fflush( stdout );
+        merged->Write( *w, false );
+        w->Finish();
+    }
+    catch( const tracy::UnsupportedVersion& e )
+    {
+        fprintf( stderr, "The file you are trying to open is from the future version.\n" );
+        exit( 1 );
+    }
+    catch( const tracy::NotTracyDump& e )
+    {
+        fprintf( stderr, "The file you are trying to open is not a tracy dump.\n" );
+        exit( 1 );
+    }
+    catch( const tracy::DictionaryNotFound& e )
+    {
+        fprintf( stderr, "The file you are trying to open needs the dictionary %s.\n", e.path.c_str() );
+        exit( 1 );
+    }
+    catch( const tracy::PackNotFound& e )
+    {
+        fprintf( stderr, "The file you are trying to open needs the pack %s.\n", e.path.c_str() );
+        exit( 1 );
+    }
+    catch( const tracy::FileReadError& e )
+    {
+        fprintf( stderr, "The file you are trying to open cannot be mapped to memory.\n" );
+        exit( 1 );
+    }
+    catch( const tracy::LegacyVersion& e )
+    {
+        fprintf( stderr, "The file you are trying to open is from a legacy version.\n" );
+        exit( 1 );
+    }
+    catch( const tracy::LoadFailure& e )
+    {
+        fprintf( stderr, "Failed to load the file: %s\n", e.msg.c_str() );
+        exit( 1 );
+    }
+
+    const auto t1 = std::chrono::high_resolution_clock::now();
+    printf( "Merged %i traces into %s in %s\n", argc - optind - 1, output, tracy::TimeToString( std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count() ) );
+
+    return 0;
+}
@@ -182,6 +182,8 @@ static void LoadConfig()
 
     int v;
     if( ini_sget( ini, "core", "threadedRendering", "%d", &v ) ) s_config.threadedRendering = v;
+    if( ini_sget( ini, "core", "memoryLimit", "%d", &v ) && v >= 0 ) s_config.memoryLimit = v;
+    if( ini_sget( ini, "core", "checkpointInterval", "%d", &v ) && v >= 0 ) s_config.checkpointInterval = v;
     if( ini_sget( ini, "timeline", "targetFps", "%d", &v ) && v >= 1 && v < 10000 ) s_config.targetFps = v;
 
     ini_free( ini );
@@ -195,6 +197,8 @@ static bool SaveConfig()
 
     fprintf( f, "[core]\n" );
     fprintf( f, "threadedRendering = %i\n", (int)s_config.threadedRendering );
+    fprintf( f, "memoryLimit = %i\n", s_config.memoryLimit );
+    fprintf( f, "checkpointInterval = %i\n", s_config.checkpointInterval );
 
     fprintf( f, "\n[timeline]\n" );
     fprintf( f, "targetFps = %i\n", s_config.targetFps );
@@ -251,6 +255,21 @@ int main( int argc, char** argv )
             fprintf( stderr, "The file you are trying to open is from a legacy version.\n" );
             exit( 1 );
         }
+        catch( const tracy::DictionaryNotFound& e )
+        {
+            fprintf( stderr, "The file you are trying to open needs the dictionary %s.\n", e.path.c_str() );
+            exit( 1 );
+        }
+        catch( const tracy::PackNotFound& e )
+        {
+            fprintf( stderr, "The file you are trying to open needs the pack %s.\n", e.path.c_str() );
+            exit( 1 );
+        }
+        catch( const tracy::FileReadError& e )
+        {
+            fprintf( stderr, "The file you are trying to open cannot be mapped to memory.\n" );
+            exit( 1 );
+        }
         if( !initFileOpen )
         {
             fprintf( stderr, "Cannot open trace file: %s\n", argv[1] );
@@ -632,6 +651,24 @@ static void DrawContents()
                 int tmp = s_config.targetFps;
                 ImGui::SetNextItemWidth( 90 * dpiScale );
                 if( ImGui::InputInt( "##targetfps", &tmp ) ) { s_config.targetFps = std::clamp( tmp, 1, 9999 ); SaveConfig(); }
+
+                ImGui::Spacing();
+                ImGui::TextUnformatted( "Memory limit (MB)" );
+                ImGui::SameLine();
+                tmp = s_config.memoryLimit;
+                ImGui::SetNextItemWidth( 90 * dpiScale );
+                if( ImGui::InputInt( "##memorylimit", &tmp, 1024, 1024 ) ) { s_config.memoryLimit = std::max( tmp, 0 ); SaveConfig(); }
+                ImGui::SameLine();
+                tracy::DrawHelpMarker( "Memory budget for live captures, 0 disables it. When approached, optional data is dropped first, then the timeline stops growing, so that the data collected so far can still be saved." );
+
+                ImGui::Spacing();
+                ImGui::TextUnformatted( "Checkpoint interval (s)" );
+                ImGui::SameLine();
+                tmp = s_config.checkpointInterval;
+                ImGui::SetNextItemWidth( 90 * dpiScale );
+                if( ImGui::InputInt( "##checkpointinterval", &tmp, 10, 60 ) ) { s_config.checkpointInterval = std::max( tmp, 0 ); SaveConfig(); }
+                ImGui::SameLine();
+                tracy::DrawHelpMarker( "Live captures are journaled to the configuration directory and flushed to disk at this interval, 0 disables it. A journal left behind by a crash can be opened directly, or converted to a trace with the update utility." );
                 ImGui::PopStyleVar();
                 ImGui::TreePop();
             }
@@ -836,6 +873,16 @@ static void DrawContents()
                 {
                     badVer.state = tracy::BadVersionState::BadFile;
                 }
+                catch( const tracy::DictionaryNotFound& e )
+                {
+                    badVer.state = tracy::BadVersionState::DictionaryNotFound;
+                    badVer.msg = e.path;
+                }
+                catch( const tracy::PackNotFound& e )
+                {
+                    badVer.state = tracy::BadVersionState::PackNotFound;
+                    badVer.msg = e.path;
+                }
                 catch( const tracy::FileReadError& )
                 {
                     badVer.state = tracy::BadVersionState::ReadError;
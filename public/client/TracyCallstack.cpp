@@ -33,11 +33,23 @@
 #  include <dlfcn.h>
 #  include <cxxabi.h>
 #  include <stdlib.h>
+#  ifdef __linux
+#    include <dirent.h>
+#    include <fcntl.h>
+#    include <inttypes.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#  endif
 #elif TRACY_HAS_CALLSTACK == 5
 #  include <dlfcn.h>
 #  include <cxxabi.h>
 #endif
 
+#ifdef TRACY_HAS_FRAME_POINTER_CALLSTACK
+#  include <pthread.h>
+#endif
+
 #ifdef TRACY_DBGHELP_LOCK
 #  include "TracyProfiler.hpp"
 
@@ -241,6 +253,73 @@ bool ShouldResolveSymbolsOffline()
 }
 #endif // #ifdef TRACY_SYMBOL_OFFLINE_RESOLVE
 
+#ifdef TRACY_HAS_FRAME_POINTER_CALLSTACK
+TRACY_API bool s_framePointerCallstack = false;
+
+static void InitFramePointerCallstack()
+{
+    const char* fp = GetEnvVar( "TRACY_CALLSTACK_FRAME_POINTER" );
+    s_framePointerCallstack = fp && fp[0] == '1';
+    if( s_framePointerCallstack ) TracyDebug( "TRACY: using frame pointer callstacks\n" );
+}
+
+struct StackBounds
+{
+    uintptr_t lo;
+    uintptr_t hi;
+    bool init;
+};
+
+static thread_local StackBounds s_stackBounds = {};
+
+static const StackBounds& GetStackBounds()
+{
+    auto& sb = s_stackBounds;
+    if( !sb.init )
+    {
+        sb.init = true;
+        pthread_attr_t attr;
+        if( pthread_getattr_np( pthread_self(), &attr ) == 0 )
+        {
+            void* addr;
+            size_t size;
+            if( pthread_attr_getstack( &attr, &addr, &size ) == 0 )
+            {
+                sb.lo = (uintptr_t)addr;
+                sb.hi = (uintptr_t)addr + size;
+            }
+            pthread_attr_destroy( &attr );
+        }
+    }
+    return sb;
+}
+
+// Both x86-64 and AArch64 store the caller's frame pointer at [fp] and the return address
+// at [fp+8]. Walking starts from this function's own frame, so the first recorded entry is
+// the return address into the caller, same as with backtrace().
+TRACY_API tracy_no_inline size_t FramePointerCallstack( void** trace, size_t depth )
+{
+    const auto& sb = GetStackBounds();
+    if( sb.hi == 0 ) return 0;
+    auto fp = (uintptr_t)__builtin_frame_address( 0 );
+    size_t num = 0;
+    while( num < depth )
+    {
+        // Guard every read: the frame record must be aligned and lie entirely within the stack.
+        if( fp < sb.lo || fp > sb.hi - 2 * sizeof( uintptr_t ) || ( fp & ( sizeof( uintptr_t ) - 1 ) ) != 0 ) break;
+        const auto frame = (const uintptr_t*)fp;
+        const auto ret = frame[1];
+        if( ret == 0 ) break;
+        trace[num++] = (void*)ret;
+        const auto next = frame[0];
+        // Stack grows down, so each caller frame must be strictly above the current one.
+        if( next <= fp ) break;
+        fp = next;
+    }
+    return num;
+}
+#endif
+
 #if TRACY_HAS_CALLSTACK == 1
 
 enum { MaxCbTrace = 64 };
@@ -760,21 +839,170 @@ static FastVector<DebugInfo>* s_di_known;
 #endif
 
 #ifdef __linux
-struct KernelSymbol
+// Kernel symbols are kept in a compact index. Addresses are stored as 32-bit offsets from the lowest
+// symbol address, names are packed into a single string table, and module names are interned. The
+// index is built on first use and cached in a file keyed by the boot id and the loaded modules list,
+// so that subsequent captures can map it instead of parsing /proc/kallsyms again.
+struct KernelSymbolIndex
+{
+    char magic[8];
+    uint64_t key;
+    uint64_t base;
+    uint32_t symCount;
+    uint32_t modCount;
+    uint32_t strSize;
+    uint32_t padding;
+    // uint32_t addr[symCount];     sorted, relative to base
+    // uint32_t name[symCount];     string table offsets
+    // uint16_t mod[symCount];      0 for kernel, module index + 1 otherwise; padded to 4 bytes
+    // uint32_t modName[modCount];  string table offsets
+    // char str[strSize];
+};
+
+static const char KernelSymbolIndexMagic[8] = { 'T', 'r', 'a', 'c', 'y', 'K', 'S', '1' };
+
+static const KernelSymbolIndex* s_kernelSym = nullptr;
+static size_t s_kernelSymSize;
+static bool s_kernelSymMapped;
+static bool s_kernelSymInit = false;
+
+static size_t KernelSymbolIndexSize( uint32_t symCount, uint32_t modCount, uint32_t strSize )
+{
+    return sizeof( KernelSymbolIndex ) + size_t( symCount ) * 8 + ( ( size_t( symCount ) * 2 + 3 ) & ~size_t( 3 ) ) + size_t( modCount ) * 4 + strSize;
+}
+
+static uint64_t HashKernelFile( const char* fn, uint64_t hash )
+{
+    FILE* f = fopen( fn, "rb" );
+    if( !f ) return hash;
+    char buf[4096];
+    size_t sz;
+    while( ( sz = fread( buf, 1, sizeof( buf ), f ) ) != 0 )
+    {
+        for( size_t i=0; i<sz; i++ )
+        {
+            hash ^= uint8_t( buf[i] );
+            hash *= 0x100000001b3;
+        }
+    }
+    fclose( f );
+    return hash;
+}
+
+static uint64_t GetKernelSymbolIndexKey()
+{
+    uint64_t hash = 0xcbf29ce484222325;
+    hash = HashKernelFile( "/proc/sys/kernel/random/boot_id", hash );
+    hash = HashKernelFile( "/proc/sys/kernel/kptr_restrict", hash );
+    hash = HashKernelFile( "/proc/modules", hash );
+    return hash;
+}
+
+static bool GetKernelSymbolIndexPath( char* buf, size_t size, uint64_t key )
+{
+    if( GetEnvVar( "TRACY_NO_KERNEL_SYMBOL_CACHE" ) ) return false;
+    const char* dir = GetEnvVar( "TRACY_KERNEL_SYMBOL_CACHE" );
+    if( !dir ) dir = GetEnvVar( "TMPDIR" );
+    if( !dir ) dir = "/tmp";
+    const auto len = snprintf( buf, size, "%s/tracy-kallsyms-%u-%016" PRIx64 ".bin", dir, unsigned( geteuid() ), key );
+    return len > 0 && size_t( len ) < size;
+}
+
+static bool LoadKernelSymbolIndex( const char* path, uint64_t key )
+{
+    int fd = open( path, O_RDONLY | O_NOFOLLOW | O_CLOEXEC );
+    if( fd < 0 ) return false;
+    struct stat st;
+    if( fstat( fd, &st ) != 0 || !S_ISREG( st.st_mode ) || st.st_uid != geteuid() || size_t( st.st_size ) < sizeof( KernelSymbolIndex ) )
+    {
+        close( fd );
+        return false;
+    }
+    const auto size = size_t( st.st_size );
+    auto ptr = mmap( nullptr, size, PROT_READ, MAP_SHARED, fd, 0 );
+    close( fd );
+    if( ptr == MAP_FAILED ) return false;
+
+    auto idx = (const KernelSymbolIndex*)ptr;
+    if( memcmp( idx->magic, KernelSymbolIndexMagic, 8 ) != 0 || idx->key != key || idx->strSize == 0 ||
+        KernelSymbolIndexSize( idx->symCount, idx->modCount, idx->strSize ) != size ||
+        ((const char*)ptr)[size-1] != '\0' )
+    {
+        munmap( ptr, size );
+        return false;
+    }
+    s_kernelSym = idx;
+    s_kernelSymSize = size;
+    s_kernelSymMapped = true;
+    TracyDebug( "Mapped %" PRIu32 " kernel symbols from %s\n", idx->symCount, path );
+    return true;
+}
+
+// The index file name changes with every kernel or module update. Files of older states are never read
+// again, so they are removed when a new index is written.
+static void RemoveStaleKernelSymbolIndexes( const char* path )
+{
+    const auto slash = strrchr( path, '/' );
+    if( !slash ) return;
+    char dirPath[1024];
+    const auto dirLen = size_t( slash - path );
+    if( dirLen == 0 || dirLen >= sizeof( dirPath ) ) return;
+    memcpy( dirPath, path, dirLen );
+    dirPath[dirLen] = '\0';
+    const auto name = slash + 1;
+
+    char prefix[64];
+    const auto prefixLen = snprintf( prefix, sizeof( prefix ), "tracy-kallsyms-%u-", unsigned( geteuid() ) );
+    if( prefixLen <= 0 || size_t( prefixLen ) >= sizeof( prefix ) ) return;
+
+    auto dir = opendir( dirPath );
+    if( !dir ) return;
+    const auto dfd = dirfd( dir );
+    while( auto ent = readdir( dir ) )
+    {
+        const auto fn = ent->d_name;
+        const auto fnLen = strlen( fn );
+        if( fnLen < size_t( prefixLen ) + 4 || memcmp( fn, prefix, prefixLen ) != 0 || strcmp( fn + fnLen - 4, ".bin" ) != 0 ) continue;
+        if( strcmp( fn, name ) == 0 ) continue;
+        struct stat st;
+        if( fstatat( dfd, fn, &st, AT_SYMLINK_NOFOLLOW ) != 0 || !S_ISREG( st.st_mode ) || st.st_uid != geteuid() ) continue;
+        unlinkat( dfd, fn, 0 );
+    }
+    closedir( dir );
+}
+
+struct KernelSymbolTmp
 {
     uint64_t addr;
-    const char* name;
-    const char* mod;
+    uint32_t name;
+    uint16_t mod;
 };
 
-KernelSymbol* s_kernelSym = nullptr;
-size_t s_kernelSymCnt;
+static uint32_t AddKernelSymbolString( char*& str, size_t& strSize, size_t& strCapacity, const char* begin, const char* end )
+{
+    const auto len = size_t( end - begin );
+    if( strSize + len + 1 > strCapacity )
+    {
+        while( strSize + len + 1 > strCapacity ) strCapacity *= 2;
+        str = (char*)tracy_realloc( str, strCapacity );
+    }
+    const auto ret = uint32_t( strSize );
+    memcpy( str + strSize, begin, len );
+    str[strSize + len] = '\0';
+    strSize += len + 1;
+    return ret;
+}
 
-static void InitKernelSymbols()
+static void BuildKernelSymbolIndex( uint64_t key, const char* path )
 {
     FILE* f = fopen( "/proc/kallsyms", "rb" );
     if( !f ) return;
-    tracy::FastVector<KernelSymbol> tmpSym( 1024 );
+    tracy::FastVector<KernelSymbolTmp> tmpSym( 1024 );
+    tracy::FastVector<uint32_t> modNames( 64 );
+    size_t strSize = 0;
+    size_t strCapacity = 1024 * 1024;
+    auto str = (char*)tracy_malloc( strCapacity );
+    uint16_t lastMod = 0;
     size_t linelen = 16 * 1024;     // linelen must be big enough to prevent reallocs in getline()
     auto linebuf = (char*)tracy_malloc( linelen );
     ssize_t sz;
@@ -815,42 +1043,167 @@ static void InitKernelSymbols()
         const auto namestart = ptr;
         while( *ptr != '\t' && *ptr != '\n' ) ptr++;
         const auto nameend = ptr;
-        const char* modstart = nullptr;
-        const char* modend;
+        uint16_t mod = 0;
         if( *ptr == '\t' )
         {
             ptr += 2;
-            modstart = ptr;
+            const auto modstart = ptr;
             while( *ptr != ']' ) ptr++;
-            modend = ptr;
-        }
+            const auto modlen = size_t( ptr - modstart );
 
-        auto strname = (char*)tracy_malloc_fast( nameend - namestart + 1 );
-        memcpy( strname, namestart, nameend - namestart );
-        strname[nameend-namestart] = '\0';
-
-        char* strmod = nullptr;
-        if( modstart )
-        {
-            strmod = (char*)tracy_malloc_fast( modend - modstart + 1 );
-            memcpy( strmod, modstart, modend - modstart );
-            strmod[modend-modstart] = '\0';
+            // Symbols of a module are listed together, so checking the last one first is usually enough
+            const auto matches = [&] ( uint16_t m ) { return strlen( str + modNames[m-1] ) == modlen && memcmp( str + modNames[m-1], modstart, modlen ) == 0; };
+            if( lastMod != 0 && matches( lastMod ) )
+            {
+                mod = lastMod;
+            }
+            else
+            {
+                for( size_t i=0; i<modNames.size(); i++ )
+                {
+                    if( matches( uint16_t( i+1 ) ) )
+                    {
+                        mod = uint16_t( i+1 );
+                        break;
+                    }
+                }
+                if( mod == 0 && modNames.size() < std::numeric_limits<uint16_t>::max() )
+                {
+                    *modNames.push_next() = AddKernelSymbolString( str, strSize, strCapacity, modstart, ptr );
+                    mod = uint16_t( modNames.size() );
+                }
+                lastMod = mod;
+            }
         }
 
         auto sym = tmpSym.push_next();
         sym->addr = addr;
-        sym->name = strname;
-        sym->mod = strmod;
+        sym->name = AddKernelSymbolString( str, strSize, strCapacity, namestart, nameend );
+        sym->mod = mod;
     }
-    tracy_free_fast( linebuf );
+    tracy_free( linebuf );
     fclose( f );
-    if( tmpSym.empty() ) return;
+    if( tmpSym.empty() )
+    {
+        tracy_free( str );
+        return;
+    }
+
+    std::sort( tmpSym.begin(), tmpSym.end(), []( const KernelSymbolTmp& lhs, const KernelSymbolTmp& rhs ) { return lhs.addr < rhs.addr; } );
+    const auto base = tmpSym.begin()->addr;
+    auto symEnd = tmpSym.end();
+    if( ( symEnd-1 )->addr - base > std::numeric_limits<uint32_t>::max() )
+    {
+        symEnd = std::upper_bound( tmpSym.begin(), tmpSym.end(), base + std::numeric_limits<uint32_t>::max(), []( const uint64_t& lhs, const KernelSymbolTmp& rhs ) { return lhs < rhs.addr; } );
+        TracyDebug( "Kernel symbol address range exceeds 4 GB, dropping %zu symbols\n", size_t( tmpSym.end() - symEnd ) );
+    }
+    const auto symCount = uint32_t( symEnd - tmpSym.begin() );
+    const auto modCount = uint32_t( modNames.size() );
+    const auto size = KernelSymbolIndexSize( symCount, modCount, uint32_t( strSize ) );
+
+    auto buf = (char*)tracy_malloc( size );
+    memset( buf, 0, size );
+    auto idx = (KernelSymbolIndex*)buf;
+    memcpy( idx->magic, KernelSymbolIndexMagic, 8 );
+    idx->key = key;
+    idx->base = base;
+    idx->symCount = symCount;
+    idx->modCount = modCount;
+    idx->strSize = uint32_t( strSize );
+    auto addrPtr = (uint32_t*)( idx + 1 );
+    auto namePtr = addrPtr + symCount;
+    auto modPtr = (uint16_t*)( namePtr + symCount );
+    auto modNamePtr = (uint32_t*)( (char*)modPtr + ( ( size_t( symCount ) * 2 + 3 ) & ~size_t( 3 ) ) );
+    for( uint32_t i=0; i<symCount; i++ )
+    {
+        const auto& sym = tmpSym.begin()[i];
+        addrPtr[i] = uint32_t( sym.addr - base );
+        namePtr[i] = sym.name;
+        modPtr[i] = sym.mod;
+    }
+    if( modCount != 0 ) memcpy( modNamePtr, modNames.data(), modCount * sizeof( uint32_t ) );
+    memcpy( modNamePtr + modCount, str, strSize );
+    tracy_free( str );
 
-    std::sort( tmpSym.begin(), tmpSym.end(), []( const KernelSymbol& lhs, const KernelSymbol& rhs ) { return lhs.addr > rhs.addr; } );
-    s_kernelSymCnt = tmpSym.size();
-    s_kernelSym = (KernelSymbol*)tracy_malloc_fast( sizeof( KernelSymbol ) * s_kernelSymCnt );
-    memcpy( s_kernelSym, tmpSym.data(), sizeof( KernelSymbol ) * s_kernelSymCnt );
-    TracyDebug( "Loaded %zu kernel symbols\n", s_kernelSymCnt );
+    s_kernelSym = idx;
+    s_kernelSymSize = size;
+    s_kernelSymMapped = false;
+    TracyDebug( "Loaded %" PRIu32 " kernel symbols\n", symCount );
+
+    if( path )
+    {
+        char tmpPath[1024];
+        const auto len = snprintf( tmpPath, sizeof( tmpPath ), "%s.%i", path, int( getpid() ) );
+        if( len <= 0 || size_t( len ) >= sizeof( tmpPath ) ) return;
+        int fd = open( tmpPath, O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, 0600 );
+        if( fd < 0 ) return;
+        size_t done = 0;
+        while( done < size )
+        {
+            const auto wr = write( fd, buf + done, size - done );
+            if( wr <= 0 ) break;
+            done += wr;
+        }
+        close( fd );
+        if( done != size || rename( tmpPath, path ) != 0 )
+        {
+            unlink( tmpPath );
+            return;
+        }
+        RemoveStaleKernelSymbolIndexes( path );
+    }
+}
+
+static void InitKernelSymbols()
+{
+    const auto key = GetKernelSymbolIndexKey();
+    char path[1024];
+    const bool cache = GetKernelSymbolIndexPath( path, sizeof( path ), key );
+    if( cache && LoadKernelSymbolIndex( path, key ) ) return;
+    BuildKernelSymbolIndex( key, cache ? path : nullptr );
+}
+
+static void EndKernelSymbols()
+{
+    if( !s_kernelSym ) return;
+    if( s_kernelSymMapped )
+    {
+        munmap( (void*)s_kernelSym, s_kernelSymSize );
+    }
+    else
+    {
+        tracy_free( (void*)s_kernelSym );
+    }
+    s_kernelSym = nullptr;
+}
+
+static bool FindKernelSymbol( uint64_t ptr, uint64_t& symAddr, const char*& name, const char*& mod )
+{
+    if( !s_kernelSymInit )
+    {
+        s_kernelSymInit = true;
+        InitKernelSymbols();
+    }
+    auto idx = s_kernelSym;
+    if( !idx || ptr < idx->base ) return false;
+
+    auto addrPtr = (const uint32_t*)( idx + 1 );
+    auto namePtr = addrPtr + idx->symCount;
+    auto modPtr = (const uint16_t*)( namePtr + idx->symCount );
+    auto modNamePtr = (const uint32_t*)( (const char*)modPtr + ( ( size_t( idx->symCount ) * 2 + 3 ) & ~size_t( 3 ) ) );
+    auto str = (const char*)( modNamePtr + idx->modCount );
+
+    const auto offset = ptr - idx->base;
+    auto it = offset > std::numeric_limits<uint32_t>::max() ? addrPtr + idx->symCount : std::upper_bound( addrPtr, addrPtr + idx->symCount, uint32_t( offset ) );
+    if( it == addrPtr ) return false;
+    const auto i = size_t( it - addrPtr ) - 1;
+
+    const auto m = modPtr[i];
+    if( namePtr[i] >= idx->strSize || m > idx->modCount || ( m != 0 && modNamePtr[m-1] >= idx->strSize ) ) return false;
+    symAddr = idx->base + addrPtr[i];
+    name = str + namePtr[i];
+    mod = m == 0 ? nullptr : str + modNamePtr[m-1];
+    return true;
 }
 #endif
 
@@ -912,6 +1265,9 @@ char* NormalizePath( const char* path )
 
 void InitCallstackCritical()
 {
+#ifdef TRACY_HAS_FRAME_POINTER_CALLSTACK
+    InitFramePointerCallstack();
+#endif
 }
 
 void InitCallstack()
@@ -940,9 +1296,6 @@ void InitCallstack()
     ___tracy_init_demangle_buffer();
 #endif
 
-#ifdef __linux
-    InitKernelSymbols();
-#endif
 #ifdef TRACY_DEBUGINFOD
     s_debuginfod = debuginfod_begin();
     s_di_known = (FastVector<DebugInfo>*)tracy_malloc( sizeof( FastVector<DebugInfo> ) );
@@ -1025,6 +1378,9 @@ void EndCallstack()
 #ifndef TRACY_DEMANGLE
     ___tracy_free_demangle_buffer();
 #endif
+#ifdef __linux
+    EndKernelSymbols();
+#endif
 #ifdef TRACY_DEBUGINFOD
     ClearDebugInfoVector( *s_di_known );
     s_di_known->~FastVector<DebugInfo>();
@@ -1249,17 +1605,19 @@ CallstackEntryData DecodeCallstackPtr( uint64_t ptr )
         return { cb_data, uint8_t( cb_num ), imageName ? imageName : "[unknown]" };
     }
 #ifdef __linux
-    else if( s_kernelSym )
+    else
     {
-        auto it = std::lower_bound( s_kernelSym, s_kernelSym + s_kernelSymCnt, ptr, []( const KernelSymbol& lhs, const uint64_t& rhs ) { return lhs.addr > rhs; } );
-        if( it != s_kernelSym + s_kernelSymCnt )
+        uint64_t symAddr;
+        const char* name;
+        const char* mod;
+        if( FindKernelSymbol( ptr, symAddr, name, mod ) )
         {
-            cb_data[0].name = CopyStringFast( it->name );
+            cb_data[0].name = CopyStringFast( name );
             cb_data[0].file = CopyStringFast( "<kernel>" );
             cb_data[0].line = 0;
             cb_data[0].symLen = 0;
-            cb_data[0].symAddr = it->addr;
-            return { cb_data, 1, it->mod ? it->mod : "<kernel>" };
+            cb_data[0].symAddr = symAddr;
+            return { cb_data, 1, mod ? mod : "<kernel>" };
         }
     }
 #endif
@@ -30,6 +30,10 @@
 #    define TRACY_HAS_CALLSTACK 6
 #  endif
 
+#  if defined __linux && ( defined __x86_64__ || defined __aarch64__ ) && ( TRACY_HAS_CALLSTACK == 2 || TRACY_HAS_CALLSTACK == 3 )
+#    define TRACY_HAS_FRAME_POINTER_CALLSTACK
+#  endif
+
 #endif
 
 #endif
@@ -75,6 +75,15 @@ const uint8_t* GetBuildIdForImage( const char* image, size_t& size );
 debuginfod_client* GetDebuginfodClient();
 #endif
 
+#ifdef TRACY_HAS_FRAME_POINTER_CALLSTACK
+// Frame pointer walk, selected at runtime with TRACY_CALLSTACK_FRAME_POINTER=1. Only
+// usable if the whole program is compiled with -fno-omit-frame-pointer. Reads are
+// bounded to the current thread's stack, so a broken frame chain truncates the
+// callstack instead of crashing. Returns 0 if the walk could not be performed.
+TRACY_API extern bool s_framePointerCallstack;
+TRACY_API size_t FramePointerCallstack( void** trace, size_t depth );
+#endif
+
 #if TRACY_HAS_CALLSTACK == 1
 
 extern "C"
@@ -117,6 +126,19 @@ static tracy_force_inline void* Callstack( int depth )
     assert( depth >= 1 && depth < 63 );
 
     auto trace = (uintptr_t*)tracy_malloc( ( 1 + depth ) * sizeof( uintptr_t ) );
+
+#ifdef TRACY_HAS_FRAME_POINTER_CALLSTACK
+    if( s_framePointerCallstack )
+    {
+        const auto num = FramePointerCallstack( (void**)(trace+1), depth );
+        if( num != 0 )
+        {
+            *trace = num;
+            return trace;
+        }
+    }
+#endif
+
     BacktraceState state = { (void**)(trace+1), (void**)(trace+1+depth) };
     _Unwind_Backtrace( tracy_unwind_callback, &state );
 
@@ -133,6 +155,18 @@ static tracy_force_inline void* Callstack( int depth )
 
     auto trace = (uintptr_t*)tracy_malloc( ( 1 + (size_t)depth ) * sizeof( uintptr_t ) );
 
+#ifdef TRACY_HAS_FRAME_POINTER_CALLSTACK
+    if( s_framePointerCallstack )
+    {
+        const auto num = FramePointerCallstack( (void**)(trace+1), depth );
+        if( num != 0 )
+        {
+            *trace = num;
+            return trace;
+        }
+    }
+#endif
+
 #ifdef TRACY_LIBUNWIND_BACKTRACE
     size_t num =  unw_backtrace( (void**)(trace+1), depth );
 #else
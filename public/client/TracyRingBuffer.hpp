@@ -16,11 +16,13 @@ namespace tracy
 class RingBuffer
 {
 public:
-    RingBuffer( unsigned int size, int fd, int id, int cpu = -1 )
+    // The member of a sampling group, if any, is owned by the ring buffer of the group leader.
+    RingBuffer( unsigned int size, int fd, int id, int cpu = -1, int memberFd = -1 )
         : m_size( size )
         , m_id( id )
         , m_cpu( cpu )
         , m_fd( fd )
+        , m_memberFd( memberFd )
     {
         const auto pageSize = uint32_t( getpagesize() );
         assert( size >= pageSize );
@@ -32,6 +34,8 @@ public:
             TracyDebug( "mmap failed: errno %i (%s)\n", errno, strerror( errno ) );
             m_fd = 0;
             m_metadata = nullptr;
+            if( memberFd != -1 ) close( memberFd );
+            m_memberFd = -1;
             close( fd );
             return;
         }
@@ -44,6 +48,7 @@ public:
     ~RingBuffer()
     {
         if( m_metadata ) munmap( m_metadata, m_mapSize );
+        if( m_memberFd != -1 ) close( m_memberFd );
         if( m_fd ) close( m_fd );
     }
 
@@ -55,6 +60,7 @@ public:
         memcpy( (char*)&other, (char*)this, sizeof( RingBuffer ) );
         m_metadata = nullptr;
         m_fd = 0;
+        m_memberFd = -1;
     }
 
     RingBuffer& operator=( RingBuffer&& other )
@@ -62,6 +68,7 @@ public:
         memcpy( (char*)&other, (char*)this, sizeof( RingBuffer ) );
         m_metadata = nullptr;
         m_fd = 0;
+        m_memberFd = -1;
         return *this;
     }
 
@@ -136,6 +143,7 @@ private:
 
     size_t m_mapSize;
     int m_fd;
+    int m_memberFd;
 };
 
 }
@@ -596,6 +596,7 @@ void SysTraceGetExternalName( uint64_t thread, const char*& threadName, const ch
 #    include <sys/wait.h>
 #    include <fcntl.h>
 #    include <inttypes.h>
+#    include <algorithm>
 #    include <limits>
 #    include <poll.h>
 #    include <stdio.h>
@@ -628,6 +629,21 @@ static int s_ctxBufferIdx = 0;
 
 static RingBuffer* s_ring = nullptr;
 
+// Counter values seen in the previous grouped sample of a (ring buffer, thread) pair.
+// Inherited events count each thread separately, so deltas are only meaningful
+// within one thread. Collisions just restart the delta baseline.
+struct HwGroupState
+{
+    uint32_t tid;
+    uint32_t ring;
+    uint64_t enabled;
+    uint64_t running;
+    uint64_t value[2];
+};
+
+static const int HwGroupStateSize = 4 * 1024;
+static HwGroupState* s_hwGroupState = nullptr;
+
 static const int ThreadHashSize = 4 * 1024;
 static uint32_t s_threadHash[ThreadHashSize] = {};
 
@@ -667,6 +683,9 @@ enum TraceEventId
     EventCacheMiss,
     EventBranchRetired,
     EventBranchMiss,
+    EventCpuCyclesGroup,
+    EventCacheReferenceGroup,
+    EventBranchRetiredGroup,
     EventVsync,
     EventContextSwitch,
     EventWakeup,
@@ -716,6 +735,50 @@ static void ProbePreciseIp( perf_event_attr& pe, pid_t pid )
     TracyDebug( "  Probed precise_ip: %i\n", pe.precise_ip );
 }
 
+// Opens the leader as a sampling event and the member as a counting event in the
+// same group on each CPU. Every leader sample then carries the values of both
+// counters, together with the time the group was enabled and actually running.
+static bool SetupHwSampleGroup( perf_event_attr pe, unsigned long long leaderConfig, unsigned long long memberConfig, int id, pid_t pid )
+{
+    pe.config = leaderConfig;
+    pe.sample_type |= PERF_SAMPLE_TID | PERF_SAMPLE_READ;
+    pe.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    perf_event_attr member = pe;
+    member.config = memberConfig;
+    member.sample_type = 0;
+    member.sample_freq = 0;
+    member.freq = 0;
+    member.precise_ip = 0;
+    member.disabled = 0;
+
+    bool ok = false;
+    for( int i=0; i<s_numCpus; i++ )
+    {
+        const int fd = perf_event_open( &pe, pid, i, -1, PERF_FLAG_FD_CLOEXEC );
+        if( fd == -1 )
+        {
+            TracyDebug( "  Core %i leader failed: errno %i (%s)\n", i, errno, strerror( errno ) );
+            continue;
+        }
+        const int memberFd = perf_event_open( &member, pid, i, fd, PERF_FLAG_FD_CLOEXEC );
+        if( memberFd == -1 )
+        {
+            TracyDebug( "  Core %i member failed: errno %i (%s)\n", i, errno, strerror( errno ) );
+            close( fd );
+            continue;
+        }
+        new( s_ring+s_numBuffers ) RingBuffer( 64*1024, fd, id, -1, memberFd );
+        if( s_ring[s_numBuffers].IsValid() )
+        {
+            s_numBuffers++;
+            ok = true;
+            TracyDebug( "  Core %i ok (grouped)\n", i );
+        }
+    }
+    return ok;
+}
+
 static bool IsGenuineIntel()
 {
 #if defined __i386 || defined __x86_64__
@@ -798,6 +861,13 @@ bool SysTraceStart( int64_t& samplingPeriod )
     const bool noBranch = noBranchEnv && noBranchEnv[0] == '1';
 #endif
 
+#ifdef TRACY_SAMPLE_GROUPS
+    const bool sampleGroups = true;
+#else
+    const char* sampleGroupsEnv = GetEnvVar( "TRACY_SAMPLE_GROUPS" );
+    const bool sampleGroups = sampleGroupsEnv && sampleGroupsEnv[0] == '1';
+#endif
+
 #ifdef TRACY_NO_CONTEXT_SWITCH
     const bool noCtxSwitch = true;
 #else
@@ -828,6 +898,12 @@ bool SysTraceStart( int64_t& samplingPeriod )
     s_ring = (RingBuffer*)tracy_malloc( sizeof( RingBuffer ) * maxNumBuffers );
     s_numBuffers = 0;
 
+    if( sampleGroups && !( noRetirement && noCache && noBranch ) )
+    {
+        s_hwGroupState = (HwGroupState*)tracy_malloc( sizeof( HwGroupState ) * HwGroupStateSize );
+        memset( s_hwGroupState, 0, sizeof( HwGroupState ) * HwGroupStateSize );
+    }
+
     // software sampling
     perf_event_attr pe = {};
     pe.type = PERF_TYPE_SOFTWARE;
@@ -895,31 +971,34 @@ bool SysTraceStart( int64_t& samplingPeriod )
     {
         TracyDebug( "Setup sampling cycles + retirement\n" );
         ProbePreciseIp( pe, PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, currentPid );
-        for( int i=0; i<s_numCpus; i++ )
+        if( !sampleGroups || !SetupHwSampleGroup( pe, PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, EventCpuCyclesGroup, currentPid ) )
         {
-            const int fd = perf_event_open( &pe, currentPid, i, -1, PERF_FLAG_FD_CLOEXEC );
-            if( fd != -1 )
+            for( int i=0; i<s_numCpus; i++ )
             {
-                new( s_ring+s_numBuffers ) RingBuffer( 64*1024, fd, EventCpuCycles );
-                if( s_ring[s_numBuffers].IsValid() )
+                const int fd = perf_event_open( &pe, currentPid, i, -1, PERF_FLAG_FD_CLOEXEC );
+                if( fd != -1 )
                 {
-                    s_numBuffers++;
-                    TracyDebug( "  Core %i ok\n", i );
+                    new( s_ring+s_numBuffers ) RingBuffer( 64*1024, fd, EventCpuCycles );
+                    if( s_ring[s_numBuffers].IsValid() )
+                    {
+                        s_numBuffers++;
+                        TracyDebug( "  Core %i ok\n", i );
+                    }
                 }
             }
-        }
 
-        pe.config = PERF_COUNT_HW_INSTRUCTIONS;
-        for( int i=0; i<s_numCpus; i++ )
-        {
-            const int fd = perf_event_open( &pe, currentPid, i, -1, PERF_FLAG_FD_CLOEXEC );
-            if( fd != -1 )
+            pe.config = PERF_COUNT_HW_INSTRUCTIONS;
+            for( int i=0; i<s_numCpus; i++ )
             {
-                new( s_ring+s_numBuffers ) RingBuffer( 64*1024, fd, EventInstructionsRetired );
-                if( s_ring[s_numBuffers].IsValid() )
+                const int fd = perf_event_open( &pe, currentPid, i, -1, PERF_FLAG_FD_CLOEXEC );
+                if( fd != -1 )
                 {
-                    s_numBuffers++;
-                    TracyDebug( "  Core %i ok\n", i );
+                    new( s_ring+s_numBuffers ) RingBuffer( 64*1024, fd, EventInstructionsRetired );
+                    if( s_ring[s_numBuffers].IsValid() )
+                    {
+                        s_numBuffers++;
+                        TracyDebug( "  Core %i ok\n", i );
+                    }
                 }
             }
         }
@@ -935,31 +1014,34 @@ bool SysTraceStart( int64_t& samplingPeriod )
             pe.precise_ip = 0;
             TracyDebug( "  CPU is GenuineIntel, forcing precise_ip down to 0\n" );
         }
-        for( int i=0; i<s_numCpus; i++ )
+        if( !sampleGroups || !SetupHwSampleGroup( pe, PERF_COUNT_HW_CACHE_REFERENCES, PERF_COUNT_HW_CACHE_MISSES, EventCacheReferenceGroup, currentPid ) )
         {
-            const int fd = perf_event_open( &pe, currentPid, i, -1, PERF_FLAG_FD_CLOEXEC );
-            if( fd != -1 )
+            for( int i=0; i<s_numCpus; i++ )
             {
-                new( s_ring+s_numBuffers ) RingBuffer( 64*1024, fd, EventCacheReference );
-                if( s_ring[s_numBuffers].IsValid() )
+                const int fd = perf_event_open( &pe, currentPid, i, -1, PERF_FLAG_FD_CLOEXEC );
+                if( fd != -1 )
                 {
-                    s_numBuffers++;
-                    TracyDebug( "  Core %i ok\n", i );
+                    new( s_ring+s_numBuffers ) RingBuffer( 64*1024, fd, EventCacheReference );
+                    if( s_ring[s_numBuffers].IsValid() )
+                    {
+                        s_numBuffers++;
+                        TracyDebug( "  Core %i ok\n", i );
+                    }
                 }
             }
-        }
 
-        pe.config = PERF_COUNT_HW_CACHE_MISSES;
-        for( int i=0; i<s_numCpus; i++ )
-        {
-            const int fd = perf_event_open( &pe, currentPid, i, -1, PERF_FLAG_FD_CLOEXEC );
-            if( fd != -1 )
+            pe.config = PERF_COUNT_HW_CACHE_MISSES;
+            for( int i=0; i<s_numCpus; i++ )
             {
-                new( s_ring+s_numBuffers ) RingBuffer( 64*1024, fd, EventCacheMiss );
-                if( s_ring[s_numBuffers].IsValid() )
+                const int fd = perf_event_open( &pe, currentPid, i, -1, PERF_FLAG_FD_CLOEXEC );
+                if( fd != -1 )
                 {
-                    s_numBuffers++;
-                    TracyDebug( "  Core %i ok\n", i );
+                    new( s_ring+s_numBuffers ) RingBuffer( 64*1024, fd, EventCacheMiss );
+                    if( s_ring[s_numBuffers].IsValid() )
+                    {
+                        s_numBuffers++;
+                        TracyDebug( "  Core %i ok\n", i );
+                    }
                 }
             }
         }
@@ -970,31 +1052,34 @@ bool SysTraceStart( int64_t& samplingPeriod )
     {
         TracyDebug( "Setup sampling CPU branch retirements + misses\n" );
         ProbePreciseIp( pe, PERF_COUNT_HW_BRANCH_INSTRUCTIONS, PERF_COUNT_HW_BRANCH_MISSES, currentPid );
-        for( int i=0; i<s_numCpus; i++ )
+        if( !sampleGroups || !SetupHwSampleGroup( pe, PERF_COUNT_HW_BRANCH_INSTRUCTIONS, PERF_COUNT_HW_BRANCH_MISSES, EventBranchRetiredGroup, currentPid ) )
         {
-            const int fd = perf_event_open( &pe, currentPid, i, -1, PERF_FLAG_FD_CLOEXEC );
-            if( fd != -1 )
+            for( int i=0; i<s_numCpus; i++ )
             {
-                new( s_ring+s_numBuffers ) RingBuffer( 64*1024, fd, EventBranchRetired );
-                if( s_ring[s_numBuffers].IsValid() )
+                const int fd = perf_event_open( &pe, currentPid, i, -1, PERF_FLAG_FD_CLOEXEC );
+                if( fd != -1 )
                 {
-                    s_numBuffers++;
-                    TracyDebug( "  Core %i ok\n", i );
+                    new( s_ring+s_numBuffers ) RingBuffer( 64*1024, fd, EventBranchRetired );
+                    if( s_ring[s_numBuffers].IsValid() )
+                    {
+                        s_numBuffers++;
+                        TracyDebug( "  Core %i ok\n", i );
+                    }
                 }
             }
-        }
 
-        pe.config = PERF_COUNT_HW_BRANCH_MISSES;
-        for( int i=0; i<s_numCpus; i++ )
-        {
-            const int fd = perf_event_open( &pe, currentPid, i, -1, PERF_FLAG_FD_CLOEXEC );
-            if( fd != -1 )
+            pe.config = PERF_COUNT_HW_BRANCH_MISSES;
+            for( int i=0; i<s_numCpus; i++ )
             {
-                new( s_ring+s_numBuffers ) RingBuffer( 64*1024, fd, EventBranchMiss );
-                if( s_ring[s_numBuffers].IsValid() )
+                const int fd = perf_event_open( &pe, currentPid, i, -1, PERF_FLAG_FD_CLOEXEC );
+                if( fd != -1 )
                 {
-                    s_numBuffers++;
-                    TracyDebug( "  Core %i ok\n", i );
+                    new( s_ring+s_numBuffers ) RingBuffer( 64*1024, fd, EventBranchMiss );
+                    if( s_ring[s_numBuffers].IsValid() )
+                    {
+                        s_numBuffers++;
+                        TracyDebug( "  Core %i ok\n", i );
+                    }
                 }
             }
         }
@@ -1231,6 +1316,86 @@ void SysTraceWorker( void* ptr )
                     pos += hdr.size;
                 }
             }
+            else if( id == EventCpuCyclesGroup || id == EventCacheReferenceGroup || id == EventBranchRetiredGroup )
+            {
+                HwSampleGroupType group;
+                switch( id )
+                {
+                case EventCpuCyclesGroup:
+                    group = HwSampleGroupType::Retirement;
+                    break;
+                case EventCacheReferenceGroup:
+                    group = HwSampleGroupType::Cache;
+                    break;
+                default:
+                    group = HwSampleGroupType::Branch;
+                    break;
+                }
+
+                while( pos < end )
+                {
+                    perf_event_header hdr;
+                    ring.Read( &hdr, pos, sizeof( perf_event_header ) );
+                    if( hdr.type == PERF_RECORD_SAMPLE )
+                    {
+                        auto offset = pos + sizeof( perf_event_header );
+
+                        // Layout:
+                        //   u64 ip
+                        //   u32 pid, tid
+                        //   u64 time
+                        //   u64 nr
+                        //   u64 time_enabled
+                        //   u64 time_running
+                        //   u64 value[nr]
+
+                        uint64_t ip, t0, nr;
+                        uint32_t tid;
+                        uint64_t data[4];
+                        ring.Read( &ip, offset, sizeof( uint64_t ) );
+                        offset += sizeof( uint64_t ) + sizeof( uint32_t );
+                        ring.Read( &tid, offset, sizeof( uint32_t ) );
+                        offset += sizeof( uint32_t );
+                        ring.Read( &t0, offset, sizeof( uint64_t ) );
+                        offset += sizeof( uint64_t );
+                        ring.Read( &nr, offset, sizeof( uint64_t ) );
+                        offset += sizeof( uint64_t );
+
+                        if( nr == 2 )
+                        {
+                            ring.Read( data, offset, sizeof( data ) );
+
+                            auto& state = s_hwGroupState[( tid * 31 + i ) & ( HwGroupStateSize - 1 )];
+                            if( state.tid == tid && state.ring == uint32_t( i ) && data[1] > state.running && data[2] >= state.value[0] && data[3] >= state.value[1] )
+                            {
+                                // While the group is multiplexed out nothing is counted, so
+                                // extrapolate the counts over the whole enabled time.
+                                const auto scale = double( data[0] - state.enabled ) / double( data[1] - state.running );
+                                const auto leader = std::min<double>( double( data[2] - state.value[0] ) * scale, std::numeric_limits<uint32_t>::max() );
+                                const auto member = std::min<double>( double( data[3] - state.value[1] ) * scale, std::numeric_limits<uint32_t>::max() );
+
+#if defined TRACY_HW_TIMER && ( defined __i386 || defined _M_IX86 || defined __x86_64__ || defined _M_X64 )
+                                t0 = ring.ConvertTimeToTsc( t0 );
+#endif
+                                TracyLfqPrepare( QueueType::HwSampleGroup );
+                                MemWrite( &item->hwSampleGroup.ip, ip );
+                                MemWrite( &item->hwSampleGroup.time, t0 );
+                                MemWrite( &item->hwSampleGroup.group, group );
+                                MemWrite( &item->hwSampleGroup.leader, uint32_t( leader ) );
+                                MemWrite( &item->hwSampleGroup.member, uint32_t( member ) );
+                                TracyLfqCommit;
+                            }
+                            state.tid = tid;
+                            state.ring = uint32_t( i );
+                            state.enabled = data[0];
+                            state.running = data[1];
+                            state.value[0] = data[2];
+                            state.value[1] = data[3];
+                        }
+                    }
+                    pos += hdr.size;
+                }
+            }
             else
             {
                 while( pos < end )
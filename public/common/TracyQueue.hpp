@@ -99,6 +99,7 @@ enum class QueueType : uint8_t
     HwSampleCacheMiss,
     HwSampleBranchRetired,
     HwSampleBranchMiss,
+    HwSampleGroup,
     PlotConfig,
     ParamSetup,
     AckServerQueryNoop,
@@ -124,6 +125,125 @@ enum class QueueType : uint8_t
     NUM_TYPES
 };
 
+// Event type names, for diagnostic output. Must follow the order of QueueType.
+static constexpr const char* QueueTypeName[] = {
+    "ZoneText",
+    "ZoneName",
+    "Message",
+    "MessageColor",
+    "MessageCallstack",
+    "MessageColorCallstack",
+    "MessageAppInfo",
+    "ZoneBeginAllocSrcLoc",
+    "ZoneBeginAllocSrcLocCallstack",
+    "CallstackSerial",
+    "Callstack",
+    "CallstackAlloc",
+    "CallstackSample",
+    "CallstackSampleContextSwitch",
+    "FrameImage",
+    "ZoneBegin",
+    "ZoneBeginCallstack",
+    "ZoneEnd",
+    "LockWait",
+    "LockObtain",
+    "LockRelease",
+    "LockSharedWait",
+    "LockSharedObtain",
+    "LockSharedRelease",
+    "LockName",
+    "MemAlloc",
+    "MemAllocNamed",
+    "MemFree",
+    "MemFreeNamed",
+    "MemAllocCallstack",
+    "MemAllocCallstackNamed",
+    "MemFreeCallstack",
+    "MemFreeCallstackNamed",
+    "GpuZoneBegin",
+    "GpuZoneBeginCallstack",
+    "GpuZoneBeginAllocSrcLoc",
+    "GpuZoneBeginAllocSrcLocCallstack",
+    "GpuZoneEnd",
+    "GpuZoneBeginSerial",
+    "GpuZoneBeginCallstackSerial",
+    "GpuZoneBeginAllocSrcLocSerial",
+    "GpuZoneBeginAllocSrcLocCallstackSerial",
+    "GpuZoneEndSerial",
+    "PlotDataInt",
+    "PlotDataFloat",
+    "PlotDataDouble",
+    "ContextSwitch",
+    "ThreadWakeup",
+    "GpuTime",
+    "GpuContextName",
+    "CallstackFrameSize",
+    "SymbolInformation",
+    "ExternalNameMetadata",
+    "SymbolCodeMetadata",
+    "SourceCodeMetadata",
+    "FiberEnter",
+    "FiberLeave",
+    "Terminate",
+    "KeepAlive",
+    "ThreadContext",
+    "GpuCalibration",
+    "GpuTimeSync",
+    "Crash",
+    "CrashReport",
+    "ZoneValidation",
+    "ZoneColor",
+    "ZoneValue",
+    "FrameMarkMsg",
+    "FrameMarkMsgStart",
+    "FrameMarkMsgEnd",
+    "FrameVsync",
+    "SourceLocation",
+    "LockAnnounce",
+    "LockTerminate",
+    "LockMark",
+    "MessageLiteral",
+    "MessageLiteralColor",
+    "MessageLiteralCallstack",
+    "MessageLiteralColorCallstack",
+    "GpuNewContext",
+    "CallstackFrame",
+    "SysTimeReport",
+    "SysPowerReport",
+    "TidToPid",
+    "HwSampleCpuCycle",
+    "HwSampleInstructionRetired",
+    "HwSampleCacheReference",
+    "HwSampleCacheMiss",
+    "HwSampleBranchRetired",
+    "HwSampleBranchMiss",
+    "HwSampleGroup",
+    "PlotConfig",
+    "ParamSetup",
+    "AckServerQueryNoop",
+    "AckSourceCodeNotAvailable",
+    "AckSymbolCodeNotAvailable",
+    "CpuTopology",
+    "SingleStringData",
+    "SecondStringData",
+    "MemNamePayload",
+    "StringData",
+    "ThreadName",
+    "PlotName",
+    "SourceLocationPayload",
+    "CallstackPayload",
+    "CallstackAllocPayload",
+    "FrameName",
+    "FrameImageData",
+    "ExternalName",
+    "ExternalThreadName",
+    "SymbolCode",
+    "SourceCode",
+    "FiberName",
+};
+
+static_assert( sizeof( QueueTypeName ) / sizeof( *QueueTypeName ) == (uint8_t)QueueType::NUM_TYPES, "QueueTypeName mismatch" );
+
 #pragma pack( push, 1 )
 
 struct QueueThreadContext
@@ -608,6 +728,24 @@ struct QueueHwSample
     int64_t time;
 };
 
+enum class HwSampleGroupType : uint8_t
+{
+    Retirement,     // cpu cycles + instructions retired
+    Cache,          // cache references + misses
+    Branch          // branches retired + mispredicted
+};
+
+// Event counts are deltas since the previous sample in the group,
+// already scaled by time_enabled / time_running.
+struct QueueHwSampleGroup
+{
+    uint64_t ip;
+    int64_t time;
+    HwSampleGroupType group;
+    uint32_t leader;
+    uint32_t member;
+};
+
 enum class PlotFormatType : uint8_t
 {
     Number,
@@ -752,6 +890,7 @@ struct QueueItem
         QueueThreadWakeup threadWakeup;
         QueueTidToPid tidToPid;
         QueueHwSample hwSample;
+        QueueHwSampleGroup hwSampleGroup;
         QueuePlotConfig plotConfig;
         QueueParamSetup paramSetup;
         QueueCpuTopology cpuTopology;
@@ -860,6 +999,7 @@ static constexpr size_t QueueDataSize[] = {
     sizeof( QueueHeader ) + sizeof( QueueHwSample ),        // cache miss
     sizeof( QueueHeader ) + sizeof( QueueHwSample ),        // branch retired
     sizeof( QueueHeader ) + sizeof( QueueHwSample ),        // branch miss
+    sizeof( QueueHeader ) + sizeof( QueueHwSampleGroup ),
     sizeof( QueueHeader ) + sizeof( QueuePlotConfig ),
     sizeof( QueueHeader ) + sizeof( QueueParamSetup ),
     sizeof( QueueHeader ),                                  // server query acknowledgement
@@ -0,0 +1,159 @@
+#ifdef _WIN32
+#  include <windows.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+#include "../../server/TracyFileRead.hpp"
+#include "../../server/TracyMemory.hpp"
+#include "../../server/TracyPrint.hpp"
+#include "../../server/TracyWorker.hpp"
+#include "../../getopt/getopt.h"
+
+void Usage()
+{
+    printf( "Usage: replay [-n count] [-p] stream.tracy\n\n" );
+    printf( "  -n count: number of times the stream is replayed (1 by default)\n" );
+    printf( "  -p: measure the time spent in handlers of each event type (slows down the replay)\n" );
+    printf( "\n  Replays an event stream recorded with capture -r through the server and reports the ingestion speed.\n" );
+
+    exit( 1 );
+}
+
+int main( int argc, char** argv )
+{
+#ifdef _WIN32
+    if( !AttachConsole( ATTACH_PARENT_PROCESS ) )
+    {
+        AllocConsole();
+        SetConsoleMode( GetStdHandle( STD_OUTPUT_HANDLE ), 0x07 );
+    }
+#endif
+
+    int count = 1;
+    bool profile = false;
+
+    int c;
+    while( ( c = getopt( argc, argv, "n:p" ) ) != -1 )
+    {
+        switch( c )
+        {
+        case 'n':
+            count = atoi( optarg );
+            break;
+        case 'p':
+            profile = true;
+            break;
+        default:
+            Usage();
+            break;
+        }
+    }
+
+    if( argc != optind + 1 || count < 1 ) Usage();
+
+    const char* input = argv[optind];
+
+    try
+    {
+        int64_t best = std::numeric_limits<int64_t>::max();
+        int64_t last = 0;
+        tracy::Worker::ReplayProfile prof;
+        for( int i=0; i<count; i++ )
+        {
+            auto f = std::unique_ptr<tracy::FileRead>( tracy::FileRead::Open( input ) );
+            if( !f )
+            {
+                fprintf( stderr, "Cannot open input file!\n" );
+                exit( 1 );
+            }
+
+            const auto t0 = std::chrono::high_resolution_clock::now();
+            if( profile ) prof = tracy::Worker::ReplayProfile();
+            tracy::Worker worker( *f, tracy::EventType::All, false, false, profile ? &prof : nullptr );
+            const auto t1 = std::chrono::high_resolution_clock::now();
+
+            if( worker.GetEventCount() == 0 )
+            {
+                fprintf( stderr, "%s is not an event stream.\n", input );
+                exit( 1 );
+            }
+
+            const auto t = std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count();
+            if( best > t ) best = t;
+            last = t;
+            // Without profiling the peak is not tracked, but trace data only grows during a replay.
+            const auto memory = profile ? prof.peakMemory : tracy::memUsage;
+            printf( "Run %i: %s events, %s zones in %s, %s events/s, %s memory\n", i+1,
+                tracy::RealToString( worker.GetEventCount() ), tracy::RealToString( worker.GetZoneCount() ), tracy::TimeToString( t ),
+                tracy::RealToString( uint64_t( worker.GetEventCount() * 1000000000. / t ) ), tracy::MemSizeToString( memory ) );
+            fflush( stdout );
+        }
+        if( count > 1 ) printf( "Best: %s\n", tracy::TimeToString( best ) );
+
+        if( profile )
+        {
+            std::vector<int> types;
+            for( int i=0; i<(int)tracy::QueueType::NUM_TYPES; i++ )
+            {
+                if( prof.count[i] != 0 ) types.push_back( i );
+            }
+            std::sort( types.begin(), types.end(), [&prof]( const auto& l, const auto& r ) { return prof.time[l] > prof.time[r]; } );
+            const auto total = std::accumulate( prof.time, prof.time + (int)tracy::QueueType::NUM_TYPES, int64_t( 0 ) );
+
+            printf( "\nEvent handlers took %s, %.2f%% of the last replay.\n", tracy::TimeToString( total ), 100. * total / last );
+            printf( "\n%-40s %14s %12s %10s %7s\n", "Event type", "Count", "Time", "Per event", "Share" );
+            for( auto& type : types )
+            {
+                printf( "%-40s %14s %12s %10s %6.2f%%\n", tracy::QueueTypeName[type], tracy::RealToString( prof.count[type] ),
+                    tracy::TimeToString( prof.time[type] ), tracy::TimeToString( prof.time[type] / int64_t( prof.count[type] ) ),
+                    100. * prof.time[type] / total );
+            }
+        }
+    }
+    catch( const tracy::UnsupportedVersion& e )
+    {
+        fprintf( stderr, "The file you are trying to open is from the future version.\n" );
+        exit( 1 );
+    }
+    catch( const tracy::NotTracyDump& e )
+    {
+        fprintf( stderr, "The file you are trying to open is not a tracy dump.\n" );
+        exit( 1 );
+    }
+    catch( const tracy::DictionaryNotFound& e )
+    {
+        fprintf( stderr, "The file you are trying to open needs the dictionary %s.\n", e.path.c_str() );
+        exit( 1 );
+    }
+    catch( const tracy::PackNotFound& e )
+    {
+        fprintf( stderr, "The file you are trying to open needs the pack %s.\n", e.path.c_str() );
+        exit( 1 );
+    }
+    catch( const tracy::FileReadError& e )
+    {
+        fprintf( stderr, "The file you are trying to open cannot be mapped to memory.\n" );
+        exit( 1 );
+    }
+    catch( const tracy::LegacyVersion& e )
+    {
+        fprintf( stderr, "The file you are trying to open is from a legacy version.\n" );
+        exit( 1 );
+    }
+    catch( const tracy::LoadFailure& e )
+    {
+        fprintf( stderr, "Failed to load the file: %s\n", e.msg.c_str() );
+        exit( 1 );
+    }
+
+    return 0;
+}
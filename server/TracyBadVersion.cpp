@@ -34,6 +34,12 @@ void BadVersionImpl( BadVersionState& badVer, ImFont* big )
     case BadVersionState::LoadFailure:
         ImGui::OpenPopup( "Trace load failure" );
         break;
+    case BadVersionState::DictionaryNotFound:
+        ImGui::OpenPopup( "Dictionary not found" );
+        break;
+    case BadVersionState::PackNotFound:
+        ImGui::OpenPopup( "Pack not found" );
+        break;
     default:
         assert( false );
         break;
@@ -117,6 +123,38 @@ void BadVersionImpl( BadVersionState& badVer, ImFont* big )
         }
         ImGui::EndPopup();
     }
+    if( ImGui::BeginPopupModal( "Dictionary not found", nullptr, ImGuiWindowFlags_AlwaysAutoResize ) )
+    {
+        ImGui::PushFont( big );
+        TextCentered( ICON_FA_BOOK );
+        ImGui::PopFont();
+        ImGui::TextUnformatted( "The file you are trying to open was compressed with a shared dictionary,\nwhich has to be placed in the same directory. The expected dictionary is:" );
+        ImGui::Spacing();
+        ImGui::TextUnformatted( badVer.msg.c_str() );
+        ImGui::Separator();
+        if( ImGui::Button( "OK" ) )
+        {
+            ImGui::CloseCurrentPopup();
+            badVer.state = BadVersionState::Ok;
+        }
+        ImGui::EndPopup();
+    }
+    if( ImGui::BeginPopupModal( "Pack not found", nullptr, ImGuiWindowFlags_AlwaysAutoResize ) )
+    {
+        ImGui::PushFont( big );
+        TextCentered( ICON_FA_BOX_ARCHIVE );
+        ImGui::PopFont();
+        ImGui::TextUnformatted( "The data of the file you are trying to open is stored in a pack, which has to\nbe placed in the same directory. The pack below is missing or doesn't match the file:" );
+        ImGui::Spacing();
+        ImGui::TextUnformatted( badVer.msg.c_str() );
+        ImGui::Separator();
+        if( ImGui::Button( "OK" ) )
+        {
+            ImGui::CloseCurrentPopup();
+            badVer.state = BadVersionState::Ok;
+        }
+        ImGui::EndPopup();
+    }
 }
 
 }
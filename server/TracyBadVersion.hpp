@@ -19,7 +19,9 @@ struct BadVersionState
         ReadError,
         UnsupportedVersion,
         LegacyVersion,
-        LoadFailure
+        LoadFailure,
+        DictionaryNotFound,
+        PackNotFound
     };
 
     State state = Ok;
@@ -8,6 +8,8 @@ struct Config
 {
     bool threadedRendering = true;
     int targetFps = 60;
+    int memoryLimit = 0;
+    int checkpointInterval = 0;
 };
 
 }
@@ -277,6 +277,19 @@ struct SampleDataRange
 enum { SampleDataRangeSize = sizeof( SampleDataRange ) };
 
 
+// Event counts gathered from grouped hardware samples. Counts are already
+// scaled for counter multiplexing. Only the group leader's sample times are
+// stored in HwSampleData, so the leader vector tells when counts occurred.
+struct HwSampleCounters
+{
+    uint64_t cycles;
+    uint64_t retired;
+    uint64_t cacheRef;
+    uint64_t cacheMiss;
+    uint64_t branchRetired;
+    uint64_t branchMiss;
+};
+
 struct HwSampleData
 {
     SortedVector<Int48, Int48Sort> cycles;
@@ -285,6 +298,7 @@ struct HwSampleData
     SortedVector<Int48, Int48Sort> cacheMiss;
     SortedVector<Int48, Int48Sort> branchRetired;
     SortedVector<Int48, Int48Sort> branchMiss;
+    HwSampleCounters counters;
 
     bool is_sorted() const
     {
@@ -513,7 +527,7 @@ struct CallstackFrameTree
     CallstackFrameTree( CallstackFrameId id ) : frame( id ), count( 0 ) {}
 
     CallstackFrameId frame;
-    uint32_t count;
+    uint64_t count;
     unordered_flat_map<uint64_t, CallstackFrameTree> children;
 };
 
@@ -825,6 +839,14 @@ struct CpuThreadData
 
 enum { CpuThreadDataSize = sizeof( CpuThreadData ) };
 
+struct ThreadWaitTime
+{
+    uint64_t processed = 0;
+    int64_t total = 0;
+    unordered_flat_map<uint32_t, uint64_t> stacks;
+    bool pending = false;
+};
+
 
 struct Parameter
 {
@@ -1,16 +1,77 @@
 #ifndef __TRACYFILEHEADER_HPP__
 #define __TRACYFILEHEADER_HPP__
 
+#include <inttypes.h>
+#include <stddef.h>
 #include <stdint.h>
+#include <stdio.h>
+#include <string>
 
 #include "../public/common/TracyForceInline.hpp"
 
+#define XXH_INLINE_ALL
+#include "tracy_xxhash.h"
+
 namespace tracy
 {
 
+// Legacy containers, holding a single compression stream of 64 KB blocks.
 static const char Lz4Header[4]  = { 't', 'l', 'Z', 4 };
 static const char ZstdHeader[4] = { 't', 'Z', 's', 't' };
 
+// Block container. The header is followed by one FileCompression byte and then by independently compressed
+// blocks of FileBlockSize bytes, each preceded by its compressed size. Only the last block may be shorter.
+// With ZstdDict compression the FileCompression byte is followed by the hash of the dictionary used by the blocks.
+// Archive files hold no blocks, see PackHeader.
+static const char BlockHeader[3] = { 't', 'B', 'k' };
+
+enum class FileCompression : uint8_t
+{
+    Lz4,
+    Zstd,
+    ZstdDict,
+    Archive
+};
+
+// Zstd dictionaries are not stored in the files using them. They are kept in the same directory as the files,
+// named after the hash of their contents, so that a single dictionary serves any number of files.
+static inline uint64_t GetDictionaryHash( const void* dict, size_t size )
+{
+    return XXH3_64bits( dict, size );
+}
+
+static inline std::string GetDictionaryFileName( uint64_t hash )
+{
+    char buf[32];
+    snprintf( buf, sizeof( buf ), "%016" PRIx64 ".zdict", hash );
+    return buf;
+}
+
+// Directory part of a file path, including the trailing separator.
+static inline std::string GetDirectory( const char* fn )
+{
+    const std::string path = fn;
+    const auto pos = path.find_last_of( "/\\" );
+    return pos == std::string::npos ? std::string() : path.substr( 0, pos+1 );
+}
+
+enum { FileBlockSize = 1024 * 1024 };
+
+// Archive pack, shared by any number of archive files in the same directory. The header is followed by records,
+// each holding a Zstd compressed chunk of trace data, which is stored once no matter how many traces contain it.
+// An archive file refers to its pack by name, stored as a uint16_t length and the name characters, followed by
+// the uint64_t number of chunks, and the XXH128 hash and the pack offset of the record of each chunk.
+static const char PackHeader[4] = { 't', 'P', 'c', 'k' };
+
+struct PackRecord
+{
+    XXH128_hash_t hash;
+    uint32_t size;
+    uint32_t compressedSize;
+};
+
+enum { PackChunkMaxSize = 64 * 1024 };
+
 static constexpr tracy_force_inline int FileVersion( uint8_t h5, uint8_t h6, uint8_t h7 )
 {
     return ( h5 << 16 ) | ( h6 << 8 ) | h7;
@@ -2,14 +2,18 @@
 #define __TRACYFILEREAD_HPP__
 
 #include <assert.h>
-#include <atomic>
 #include <algorithm>
+#include <condition_variable>
+#include <limits>
+#include <memory>
+#include <mutex>
 #include <stdexcept>
 #include <stdio.h>
 #include <string.h>
 #include <string>
 #include <thread>
 #include <utility>
+#include <vector>
 
 #include <sys/stat.h>
 
@@ -22,7 +26,6 @@
 
 #include "TracyFileHeader.hpp"
 #include "TracyMmap.hpp"
-#include "../public/common/TracyYield.hpp"
 #include "../public/common/tracy_lz4.hpp"
 #include "../public/common/TracyForceInline.hpp"
 #include "../zstd/zstd.h"
@@ -32,6 +35,18 @@ namespace tracy
 
 struct NotTracyDump : public std::exception {};
 struct FileReadError : public std::exception {};
+// The dictionary used to compress the file is missing from the file's directory.
+struct DictionaryNotFound : public FileReadError
+{
+    DictionaryNotFound( const std::string& path ) : path( path ) {}
+    std::string path;
+};
+// The pack holding the data of an archive file is missing from the file's directory, or it doesn't match the file.
+struct PackNotFound : public FileReadError
+{
+    PackNotFound( const std::string& path ) : path( path ) {}
+    std::string path;
+};
 
 class FileRead
 {
@@ -44,12 +59,7 @@ public:
 
     ~FileRead()
     {
-        m_exit.store( true, std::memory_order_relaxed );
-        m_decThread.join();
-
-        if( m_data ) munmap( m_data, m_dataSize );
-        if( m_stream ) LZ4_freeStreamDecode( m_stream );
-        if( m_streamZstd ) ZSTD_freeDStream( m_streamZstd );
+        Close();
     }
 
     tracy_force_inline void Read( void* ptr, size_t size )
@@ -328,27 +338,133 @@ public:
 
     const std::string& GetFilename() const { return m_filename; }
 
+    // Block container files can be positioned freely. Legacy files can only be skipped forward.
+    bool IsSeekable() const { return !m_legacy; }
+    uint64_t GetPosition() const { return m_current * BufSize + m_offset; }
+
+    // Size of the uncompressed data. Only available for seekable files.
+    uint64_t GetSize()
+    {
+        assert( IsSeekable() );
+        if( m_archive ) return m_chunks.back().pos + m_chunks.back().size;
+        if( m_blockOffset.empty() ) return 0;
+        auto tmp = std::unique_ptr<char[]>( new char[BufSize] );
+        auto zstd = CreateZstdContext();
+        const auto last = ReadBlock( m_blockOffset.size() - 1, tmp.get(), zstd );
+        if( zstd ) ZSTD_freeDCtx( zstd );
+        if( last == BlockError ) throw FileReadError();
+        return ( m_blockOffset.size() - 1 ) * BufSize + last;
+    }
+
+    void Seek( uint64_t pos )
+    {
+        const auto block = pos / BufSize;
+        if( block == m_current )
+        {
+            m_offset = pos - block * BufSize;
+            return;
+        }
+        if( m_legacy )
+        {
+            assert( pos > GetPosition() );
+            SkipBig( pos - GetPosition() );
+            return;
+        }
+
+        std::unique_lock<std::mutex> lock( m_lock );
+        // Blocks which are being decompressed may use the ring slots needed at the new position.
+        m_seeking = true;
+        m_readyCv.wait( lock, [this] { return m_inFlight == 0; } );
+        m_seeking = false;
+        if( block < m_current || block >= m_nextBlock )
+        {
+            // Read-ahead is restarted at the new position.
+            std::fill( m_ringBlock.begin(), m_ringBlock.end(), std::numeric_limits<size_t>::max() );
+            m_nextBlock = block;
+        }
+        m_current = block;
+        m_freeCv.notify_all();
+        m_readyCv.wait( lock, [this] { return m_ringBlock[m_current % m_ringSize] == m_current || m_current >= m_blockCount; } );
+        if( m_current < m_blockCount && m_ringFailed[m_current % m_ringSize] ) throw FileReadError();
+        m_buf = m_ring.get() + ( m_current % m_ringSize ) * BufSize;
+        m_offset = pos - block * BufSize;
+    }
+
 private:
     FileRead( FILE* f, const char* fn )
         : m_stream( nullptr )
         , m_streamZstd( nullptr )
+        , m_dict( nullptr )
         , m_data( nullptr )
-        , m_buf( m_bufData[1] )
-        , m_second( m_bufData[0] )
         , m_offset( 0 )
-        , m_lastBlock( 0 )
-        , m_signalSwitch( false )
-        , m_signalAvailable( false )
+        , m_legacy( true )
+        , m_zstd( false )
+        , m_archive( false )
+        , m_blockCount( std::numeric_limits<size_t>::max() )
+        , m_current( 0 )
+        , m_nextBlock( 0 )
+        , m_inFlight( 0 )
+        , m_seeking( false )
         , m_exit( false )
         , m_filename( fn )
     {
+        std::string dataFile = fn;
         char hdr[4];
         if( fread( hdr, 1, sizeof( hdr ), f ) != sizeof( hdr ) )
         {
             fclose( f );
             throw NotTracyDump();
         }
-        if( memcmp( hdr, Lz4Header, sizeof( hdr ) ) == 0 )
+        if( memcmp( hdr, BlockHeader, sizeof( BlockHeader ) ) == 0 && hdr[3] == (char)FileCompression::Lz4 )
+        {
+            m_legacy = false;
+        }
+        else if( memcmp( hdr, BlockHeader, sizeof( BlockHeader ) ) == 0 && hdr[3] == (char)FileCompression::Zstd )
+        {
+            m_legacy = false;
+            m_zstd = true;
+        }
+        else if( memcmp( hdr, BlockHeader, sizeof( BlockHeader ) ) == 0 && hdr[3] == (char)FileCompression::ZstdDict )
+        {
+            m_legacy = false;
+            m_zstd = true;
+            uint64_t hash;
+            if( fread( &hash, 1, sizeof( hash ), f ) != sizeof( hash ) )
+            {
+                fclose( f );
+                throw NotTracyDump();
+            }
+            const auto path = GetDirectory( fn ) + GetDictionaryFileName( hash );
+            m_dict = LoadDictionary( path.c_str(), hash );
+            if( !m_dict )
+            {
+                fclose( f );
+                throw DictionaryNotFound( path );
+            }
+        }
+        else if( memcmp( hdr, BlockHeader, sizeof( BlockHeader ) ) == 0 && hdr[3] == (char)FileCompression::Archive )
+        {
+            // The data of the file is in the pack, which is mapped instead of the file.
+            m_legacy = false;
+            m_zstd = true;
+            m_archive = true;
+            std::string pack;
+            if( !ReadArchiveIndex( f, pack ) )
+            {
+                fclose( f );
+                throw NotTracyDump();
+            }
+            fclose( f );
+            dataFile = GetDirectory( fn ) + pack;
+            f = fopen( dataFile.c_str(), "rb" );
+            if( !f ) throw PackNotFound( dataFile );
+            if( fread( hdr, 1, sizeof( hdr ), f ) != sizeof( hdr ) || memcmp( hdr, PackHeader, sizeof( hdr ) ) != 0 )
+            {
+                fclose( f );
+                throw PackNotFound( dataFile );
+            }
+        }
+        else if( memcmp( hdr, Lz4Header, sizeof( hdr ) ) == 0 )
         {
             m_stream = LZ4_createStreamDecode();
         }
@@ -363,7 +479,7 @@ private:
         }
 
         struct stat64 buf;
-        if( stat64( fn, &buf ) == 0 )
+        if( stat64( dataFile.c_str(), &buf ) == 0 )
         {
             m_dataSize = buf.st_size;
         }
@@ -379,136 +495,364 @@ private:
         {
             throw FileReadError();
         }
-        m_dataOffset = sizeof( hdr );
+        m_dataOffset = sizeof( hdr ) + ( m_dict ? sizeof( uint64_t ) : 0 );
+
+        // Blocks of the block container can be decompressed in any order, by any number of threads. Their
+        // positions are collected up front from the compressed sizes. Legacy files are a single compression
+        // stream, which has to be decoded sequentially.
+        int threads = 1;
+        if( m_archive )
+        {
+            if( !MapArchiveChunks() )
+            {
+                munmap( m_data, m_dataSize );
+                throw PackNotFound( dataFile );
+            }
+            m_blockCount = ( m_chunks.back().pos + m_chunks.back().size + BufSize - 1 ) / BufSize;
+            threads = std::max( 1, std::min<int>( std::thread::hardware_concurrency(), 8 ) );
+        }
+        else if( !m_legacy )
+        {
+            auto offset = m_dataOffset;
+            while( offset + sizeof( uint32_t ) <= m_dataSize )
+            {
+                uint32_t sz;
+                memcpy( &sz, m_data + offset, sizeof( sz ) );
+                if( offset + sizeof( sz ) + sz > m_dataSize ) break;
+                m_blockOffset.push_back( offset );
+                offset += sizeof( sz ) + sz;
+            }
+            m_blockCount = m_blockOffset.size();
+            threads = std::max( 1, std::min<int>( std::thread::hardware_concurrency(), 8 ) );
+        }
+
+        m_ringSize = std::max( 4, threads * 2 );
+        m_ring.reset( new char[m_ringSize * BufSize] );
+        m_ringBlock.resize( m_ringSize, std::numeric_limits<size_t>::max() );
+        m_ringFailed.resize( m_ringSize, false );
+        m_buf = m_ring.get();
+
+        for( int i=0; i<threads; i++ )
+        {
+            m_decThreads.emplace_back( [this] { DecompressThread(); } );
+        }
+
+        std::unique_lock<std::mutex> lock( m_lock );
+        m_readyCv.wait( lock, [this] { return m_ringBlock[0] == 0 || m_blockCount == 0; } );
+        if( m_blockCount != 0 && m_ringFailed[0] )
+        {
+            lock.unlock();
+            Close();
+            throw FileReadError();
+        }
+    }
+
+    void Close()
+    {
+        {
+            std::lock_guard<std::mutex> lock( m_lock );
+            m_exit = true;
+        }
+        m_freeCv.notify_all();
+        for( auto& thread : m_decThreads ) thread.join();
+        m_decThreads.clear();
 
-        ReadBlock( ReadBlockSize() );
-        std::swap( m_buf, m_second );
-        m_decThread = std::thread( [this] { Worker(); } );
+        if( m_data ) munmap( m_data, m_dataSize );
+        if( m_stream ) LZ4_freeStreamDecode( m_stream );
+        if( m_streamZstd ) ZSTD_freeDStream( m_streamZstd );
+        if( m_dict ) ZSTD_freeDDict( m_dict );
+        m_data = nullptr;
+        m_stream = nullptr;
+        m_streamZstd = nullptr;
+        m_dict = nullptr;
     }
 
-    tracy_force_inline uint32_t ReadBlockSize()
+    bool ReadArchiveIndex( FILE* f, std::string& pack )
     {
-        uint32_t sz;
-        memcpy( &sz, m_data + m_dataOffset, sizeof( sz ) );
-        m_dataOffset += sizeof( sz );
-        return sz;
+        const auto pos = ftell( f );
+        fseek( f, 0, SEEK_END );
+        const uint64_t size = ftell( f );
+        fseek( f, pos, SEEK_SET );
+
+        uint16_t len;
+        if( fread( &len, 1, sizeof( len ), f ) != sizeof( len ) ) return false;
+        pack.resize( len );
+        if( fread( &pack[0], 1, len, f ) != len ) return false;
+        uint64_t cnt;
+        if( fread( &cnt, 1, sizeof( cnt ), f ) != sizeof( cnt ) ) return false;
+        // Even an empty trace has a header, so an archive without chunks is broken.
+        if( cnt == 0 || cnt > size / ( sizeof( XXH128_hash_t ) + sizeof( uint64_t ) ) ) return false;
+        m_chunks.reserve( cnt );
+        for( uint64_t i=0; i<cnt; i++ )
+        {
+            ArchiveChunk chunk;
+            if( fread( &chunk.hash, 1, sizeof( chunk.hash ), f ) != sizeof( chunk.hash ) ) return false;
+            if( fread( &chunk.offset, 1, sizeof( chunk.offset ), f ) != sizeof( chunk.offset ) ) return false;
+            m_chunks.push_back( chunk );
+        }
+        return true;
     }
 
-    void Worker()
+    // Checks that the records referred to by the file are in the pack, and places the chunks in the data.
+    bool MapArchiveChunks()
     {
-        uint32_t blockSz = ReadBlockSize();
+        uint64_t pos = 0;
+        for( auto& chunk : m_chunks )
+        {
+            PackRecord rec;
+            if( chunk.offset < sizeof( PackHeader ) || chunk.offset + sizeof( rec ) > m_dataSize ) return false;
+            memcpy( &rec, m_data + chunk.offset, sizeof( rec ) );
+            if( !XXH128_isEqual( rec.hash, chunk.hash ) || rec.size > PackChunkMaxSize ) return false;
+            if( chunk.offset + sizeof( rec ) + rec.compressedSize > m_dataSize ) return false;
+            chunk.pos = pos;
+            chunk.size = rec.size;
+            pos += rec.size;
+        }
+        return true;
+    }
+
+    static ZSTD_DDict* LoadDictionary( const char* path, uint64_t hash )
+    {
+        auto f = fopen( path, "rb" );
+        if( !f ) return nullptr;
+        fseek( f, 0, SEEK_END );
+        const auto sz = ftell( f );
+        fseek( f, 0, SEEK_SET );
+        std::vector<char> dict( sz );
+        const auto ok = fread( dict.data(), 1, sz, f ) == (size_t)sz;
+        fclose( f );
+        if( !ok || GetDictionaryHash( dict.data(), sz ) != hash ) return nullptr;
+        return ZSTD_createDDict( dict.data(), sz );
+    }
+
+    ZSTD_DCtx* CreateZstdContext() const
+    {
+        if( !m_zstd ) return nullptr;
+        auto zstd = ZSTD_createDCtx();
+        if( m_dict ) ZSTD_DCtx_refDDict( zstd, m_dict );
+        return zstd;
+    }
+
+    void DecompressThread()
+    {
+        auto zstd = CreateZstdContext();
+
+        std::unique_lock<std::mutex> lock( m_lock );
         for(;;)
         {
-            ReadBlock( blockSz );
-            if( m_lastBlock == BufSize ) blockSz = ReadBlockSize();
-            for(;;)
+            // The slot of a block is free once the block which used it before has been read.
+            m_freeCv.wait( lock, [this] { return m_exit || ( !m_seeking && m_nextBlock < m_blockCount && m_nextBlock < m_current + m_ringSize ); } );
+            if( m_exit ) break;
+            const auto block = m_nextBlock++;
+            m_inFlight++;
+            lock.unlock();
+            auto dst = m_ring.get() + ( block % m_ringSize ) * BufSize;
+            bool end = false;
+            bool failed = false;
+            if( m_legacy )
             {
-                if( m_exit.load( std::memory_order_relaxed ) == true ) return;
-                if( m_signalSwitch.load( std::memory_order_relaxed ) == true ) break;
-                YieldThread();
+                failed = ReadLegacyBlock( dst, end ) == BlockError;
             }
-            m_signalSwitch.store( false, std::memory_order_relaxed );
-            std::swap( m_buf, m_second );
-            m_offset = 0;
-            m_signalAvailable.store( true, std::memory_order_release );
-            if( m_lastBlock != BufSize ) return;
+            else
+            {
+                // Only the last block may be shorter.
+                const auto size = ReadBlock( block, dst, zstd );
+                failed = size == BlockError || ( size != BufSize && block != m_blockCount - 1 );
+            }
+            lock.lock();
+            if( end ) m_blockCount = block + 1;
+            m_inFlight--;
+            m_ringBlock[block % m_ringSize] = block;
+            m_ringFailed[block % m_ringSize] = failed;
+            m_readyCv.notify_one();
         }
+
+        if( zstd ) ZSTD_freeDCtx( zstd );
     }
 
-    tracy_force_inline void ReadSmall( void* ptr, size_t size )
+    // Returns the decompressed size, or BlockError if the block is corrupted.
+    size_t ReadBlock( size_t block, char* dst, ZSTD_DCtx* zstd )
     {
-        memcpy( ptr, m_buf + m_offset, size );
-        m_offset += size;
+        if( m_archive ) return ReadArchiveBlock( block, dst, zstd );
+
+        uint32_t sz;
+        const auto offset = m_blockOffset[block];
+        memcpy( &sz, m_data + offset, sizeof( sz ) );
+        auto src = m_data + offset + sizeof( sz );
+        if( zstd )
+        {
+            const auto ret = ZSTD_decompressDCtx( zstd, dst, BufSize, src, sz );
+            return ZSTD_isError( ret ) ? BlockError : ret;
+        }
+        else
+        {
+            const auto ret = LZ4_decompress_safe( src, dst, sz, BufSize );
+            return ret < 0 ? BlockError : (size_t)ret;
+        }
     }
 
-    void ReadBig( void* ptr, size_t size )
+    // Chunk boundaries are not aligned to blocks. Chunks crossing the block boundaries are decompressed in full,
+    // once for each of the blocks. The contents of each chunk are checked against its hash.
+    size_t ReadArchiveBlock( size_t block, char* dst, ZSTD_DCtx* zstd )
     {
-        assert( size > 0 );
-        auto dst = (char*)ptr;
-        do
-        {
-            size_t sz;
-            if( m_offset == BufSize )
+        const auto start = uint64_t( block ) * BufSize;
+        const auto end = std::min<uint64_t>( start + BufSize, m_chunks.back().pos + m_chunks.back().size );
+        auto it = std::upper_bound( m_chunks.begin(), m_chunks.end(), start, []( uint64_t pos, const ArchiveChunk& chunk ) { return pos < chunk.pos; } ) - 1;
+        std::unique_ptr<char[]> tmp;
+        for( ; it != m_chunks.end() && it->pos < end; ++it )
+        {
+            PackRecord rec;
+            memcpy( &rec, m_data + it->offset, sizeof( rec ) );
+            auto src = m_data + it->offset + sizeof( rec );
+            if( it->pos >= start && it->pos + it->size <= end )
             {
-                sz = std::min<size_t>( size, BufSize );
-
-                m_signalSwitch.store( true, std::memory_order_relaxed );
-                while( m_signalAvailable.load( std::memory_order_acquire ) == false ) { YieldThread(); }
-                m_signalAvailable.store( false, std::memory_order_relaxed );
-                assert( m_offset == 0 );
-
-                memcpy( dst, m_buf, sz );
-                m_offset = sz;
+                auto ptr = dst + ( it->pos - start );
+                const auto ret = ZSTD_decompressDCtx( zstd, ptr, it->size, src, rec.compressedSize );
+                if( ZSTD_isError( ret ) || ret != it->size || !XXH128_isEqual( XXH3_128bits( ptr, ret ), it->hash ) ) return BlockError;
             }
             else
             {
-                sz = std::min( size, BufSize - m_offset );
-                memcpy( dst, m_buf + m_offset, sz );
-                m_offset += sz;
+                if( !tmp ) tmp.reset( new char[PackChunkMaxSize] );
+                const auto ret = ZSTD_decompressDCtx( zstd, tmp.get(), PackChunkMaxSize, src, rec.compressedSize );
+                if( ZSTD_isError( ret ) || ret != it->size || !XXH128_isEqual( XXH3_128bits( tmp.get(), ret ), it->hash ) ) return BlockError;
+                const auto from = std::max( it->pos, start );
+                const auto to = std::min( it->pos + it->size, end );
+                memcpy( dst + ( from - start ), tmp.get() + ( from - it->pos ), to - from );
             }
-
-            dst += sz;
-            size -= sz;
         }
-        while( size > 0 );
+        return end - start;
     }
 
-    void SkipBig( size_t size )
+    // Legacy blocks are decoded one after another into the buffer. The compression stream only refers to the
+    // previous block, which is still in place, either just before, or at the end of the previous ring slot.
+    // Returns the decoded size, or BlockError if the stream is corrupted. Sets end when nothing follows.
+    size_t ReadLegacyBlock( char* dst, bool& end )
     {
-        while( size > 0 )
-        {
-            if( m_offset == BufSize )
+        end = true;
+        size_t size = 0;
+        while( size < BufSize && m_dataOffset < m_dataSize )
+        {
+            uint32_t sz;
+            if( m_dataSize - m_dataOffset < sizeof( sz ) ) return BlockError;
+            memcpy( &sz, m_data + m_dataOffset, sizeof( sz ) );
+            m_dataOffset += sizeof( sz );
+            if( sz > m_dataSize - m_dataOffset ) return BlockError;
+            size_t decoded;
+            if( m_stream )
             {
-                m_signalSwitch.store( true, std::memory_order_relaxed );
-                while( m_signalAvailable.load( std::memory_order_acquire ) == false ) { YieldThread(); }
-                m_signalAvailable.store( false, std::memory_order_relaxed );
+                const auto ret = LZ4_decompress_safe_continue( m_stream, m_data + m_dataOffset, dst + size, sz, LegacyBlockSize );
+                if( ret < 0 ) return BlockError;
+                decoded = (size_t)ret;
             }
+            else
+            {
+                ZSTD_outBuffer out = { dst + size, LegacyBlockSize, 0 };
+                ZSTD_inBuffer in = { m_data + m_dataOffset, sz, 0 };
+                const auto ret = ZSTD_decompressStream( m_streamZstd, &out, &in );
+                if( ZSTD_isError( ret ) ) return BlockError;
+                decoded = out.pos;
+            }
+            m_dataOffset += sz;
+            size += decoded;
+            if( decoded != LegacyBlockSize ) return size;
+        }
+        end = m_dataOffset == m_dataSize;
+        return size;
+    }
 
+    void NextBuffer()
+    {
+        std::unique_lock<std::mutex> lock( m_lock );
+        m_current++;
+        m_freeCv.notify_all();
+        m_readyCv.wait( lock, [this] { return m_ringBlock[m_current % m_ringSize] == m_current || m_current >= m_blockCount; } );
+        assert( m_current < m_blockCount );
+        if( m_ringFailed[m_current % m_ringSize] ) throw FileReadError();
+        m_buf = m_ring.get() + ( m_current % m_ringSize ) * BufSize;
+        m_offset = 0;
+    }
+
+    tracy_force_inline void ReadSmall( void* ptr, size_t size )
+    {
+        memcpy( ptr, m_buf + m_offset, size );
+        m_offset += size;
+    }
+
+    void ReadBig( void* ptr, size_t size )
+    {
+        assert( size > 0 );
+        auto dst = (char*)ptr;
+        do
+        {
+            if( m_offset == BufSize ) NextBuffer();
             const auto sz = std::min( size, BufSize - m_offset );
+            memcpy( dst, m_buf + m_offset, sz );
             m_offset += sz;
+            dst += sz;
             size -= sz;
         }
+        while( size > 0 );
     }
 
-    void ReadBlock( uint32_t sz )
+    void SkipBig( size_t size )
     {
-        if( m_stream )
+        if( !m_legacy )
         {
-            m_lastBlock = (size_t)LZ4_decompress_safe_continue( m_stream, m_data + m_dataOffset, m_second, sz, BufSize );
-            m_dataOffset += sz;
+            Seek( GetPosition() + size );
+            return;
         }
-        else
+        while( size > 0 )
         {
-            ZSTD_outBuffer out = { m_second, BufSize, 0 };
-            ZSTD_inBuffer in = { m_data + m_dataOffset, sz, 0 };
-            m_dataOffset += sz;
-            const auto ret = ZSTD_decompressStream( m_streamZstd, &out, &in );
-            assert( ret > 0 );
-            m_lastBlock = out.pos;
+            if( m_offset == BufSize ) NextBuffer();
+            const auto sz = std::min( size, BufSize - m_offset );
+            m_offset += sz;
+            size -= sz;
         }
     }
 
-    enum { BufSize = 64 * 1024 };
-    enum { LZ4Size = std::max( LZ4_COMPRESSBOUND( BufSize ), ZSTD_COMPRESSBOUND( BufSize ) ) };
+    enum { BufSize = FileBlockSize };
+    enum : size_t { BlockError = std::numeric_limits<size_t>::max() };
+    enum { LegacyBlockSize = 64 * 1024 };
 
     LZ4_streamDecode_t* m_stream;
     ZSTD_DStream* m_streamZstd;
+    ZSTD_DDict* m_dict;
     char* m_data;
     uint64_t m_dataSize;
     uint64_t m_dataOffset;
     char* m_buf;
-    char* m_second;
     size_t m_offset;
-    size_t m_lastBlock;
+    bool m_legacy;
+    bool m_zstd;
+    bool m_archive;
 
-    alignas(64) std::atomic<bool> m_signalSwitch;
-    alignas(64) std::atomic<bool> m_signalAvailable;
-    alignas(64) std::atomic<bool> m_exit;
-
-    std::thread m_decThread;
+    struct ArchiveChunk
+    {
+        XXH128_hash_t hash;
+        uint64_t offset;    // of the record in the pack
+        uint64_t pos;       // in the uncompressed data
+        uint32_t size;
+    };
+
+    std::vector<uint64_t> m_blockOffset;
+    std::vector<ArchiveChunk> m_chunks;
+    std::unique_ptr<char[]> m_ring;
+    size_t m_ringSize;
+    std::vector<size_t> m_ringBlock;    // block held by each ring slot
+    std::vector<bool> m_ringFailed;     // block in the slot couldn't be decompressed
+
+    std::mutex m_lock;
+    std::condition_variable m_readyCv;
+    std::condition_variable m_freeCv;
+    size_t m_blockCount;
+    size_t m_current;
+    size_t m_nextBlock;
+    size_t m_inFlight;
+    bool m_seeking;
+    bool m_exit;
+    std::vector<std::thread> m_decThreads;
 
     std::string m_filename;
-    char m_bufData[2][BufSize];
 };
 
 }
@@ -2,14 +2,20 @@
 #define __TRACYFILEWRITE_HPP__
 
 #ifdef _MSC_VER
-#  pragma warning( disable: 4267 )  // conversion from don't care to whatever, possible loss of data 
+#  pragma warning( disable: 4267 )  // conversion from don't care to whatever, possible loss of data
 #endif
 
 #include <algorithm>
 #include <assert.h>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <thread>
 #include <utility>
+#include <vector>
 
 #include "TracyFileHeader.hpp"
 #include "../public/common/tracy_lz4.hpp"
@@ -31,30 +37,48 @@ public:
         Zstd
     };
 
-    static FileWrite* Open( const char* fn, Compression comp = Compression::Fast, int level = 1 )
+    // Blocks are compressed by a pool of threads, or by the writing thread if threads is 0. A negative value
+    // selects the thread count based on the number of available cores. The pool and the block buffers are only
+    // set up once the file grows past the first block, so files which are written slowly, or not at all, should
+    // use no threads, or a single one. Zstd compression may use a dictionary, which then has to be available to
+    // read the file, see GetDictionaryFileName().
+    static FileWrite* Open( const char* fn, Compression comp = Compression::Fast, int level = 1, int threads = -1, const void* dict = nullptr, size_t dictSize = 0 )
     {
+        assert( !dict || comp == Compression::Zstd );
         auto f = fopen( fn, "wb" );
-        return f ? new FileWrite( f, comp, level ) : nullptr;
+        return f ? new FileWrite( f, comp, level, threads, dict, dictSize ) : nullptr;
     }
 
     ~FileWrite()
     {
-        if( m_offset > 0 ) WriteLz4Block();
+        Finish();
+
+        {
+            std::lock_guard<std::mutex> lock( m_lock );
+            m_exit = true;
+        }
+        m_queueCv.notify_all();
+        for( auto& thread : m_threads ) thread.join();
+
         fclose( m_file );
 
-        if( m_stream ) LZ4_freeStream( m_stream );
-        if( m_streamHC ) LZ4_freeStreamHC( m_streamHC );
-        if( m_streamZstd ) ZSTD_freeCStream( m_streamZstd );
+        for( auto& ctx : m_ctx )
+        {
+            free( ctx.lz4 );
+            if( ctx.zstd ) ZSTD_freeCCtx( ctx.zstd );
+        }
+        if( m_dict ) ZSTD_freeCDict( m_dict );
     }
 
     void Finish()
     {
-        if( m_offset > 0 ) WriteLz4Block();
+        if( m_offset > 0 ) SubmitBlock();
+        while( m_written != m_submitted ) WriteBlock();
     }
 
     tracy_force_inline void Write( const void* ptr, size_t size )
     {
-        if( m_offset + size <= BufSize )
+        if( m_offset + size <= FileBlockSize )
         {
             WriteSmall( ptr, size );
         }
@@ -64,49 +88,112 @@ public:
         }
     }
 
+    // Waits until all the data is stored in the file. Only the last block of a file may be partially filled, so
+    // the block which is being filled must be completed first, see GetBlockSpace().
+    void Sync()
+    {
+        if( m_offset == FileBlockSize ) SubmitBlock();
+        assert( m_offset == 0 );
+        while( m_written != m_submitted ) WriteBlock();
+        fflush( m_file );
+    }
+
+    uint64_t GetPosition() const { return m_position + m_offset; }
+    size_t GetBlockSpace() const { return FileBlockSize - m_offset; }
     std::pair<size_t, size_t> GetCompressionStatistics() const { return std::make_pair( m_srcBytes, m_dstBytes ); }
 
 private:
-    FileWrite( FILE* f, Compression comp, int level )
-        : m_stream( nullptr )
-        , m_streamHC( nullptr )
-        , m_streamZstd( nullptr )
+    struct Block
+    {
+        std::unique_ptr<char[]> src;
+        std::unique_ptr<char[]> dst;
+        uint32_t srcSize;
+        uint32_t dstSize;
+        bool done;
+    };
+
+    struct Context
+    {
+        void* lz4;
+        ZSTD_CCtx* zstd;
+    };
+
+    FileWrite( FILE* f, Compression comp, int level, int threads, const void* dict, size_t dictSize )
+        : m_comp( comp )
+        , m_level( level )
+        , m_dict( dict ? ZSTD_createCDict( dict, dictSize, level ) : nullptr )
         , m_file( f )
-        , m_buf( m_bufData[0] )
-        , m_second( m_bufData[1] )
         , m_offset( 0 )
+        , m_position( 0 )
+        , m_submitted( 0 )
+        , m_queued( 0 )
+        , m_written( 0 )
+        , m_exit( false )
         , m_srcBytes( 0 )
         , m_dstBytes( 0 )
     {
-        switch( comp )
+        if( threads < 0 )
+        {
+            // Beyond this the writing thread, which serializes the trace data, can't keep the pool busy.
+            const auto cores = (int)std::thread::hardware_concurrency();
+            threads = cores > 1 ? std::min( cores, 16 ) : 0;
+        }
+
+        m_poolSize = threads;
+
+        // The first block is compressed by the writing thread, unless it's followed by more data.
+        m_blocks.resize( 1 );
+        m_blocks[0].src.reset( new char[FileBlockSize] );
+        m_buf = m_blocks[0].src.get();
+        m_ctx.resize( 1 );
+        InitContext( m_ctx[0] );
+
+        fwrite( BlockHeader, 1, sizeof( BlockHeader ), m_file );
+        const auto type = comp != Compression::Zstd ? FileCompression::Lz4 : ( dict ? FileCompression::ZstdDict : FileCompression::Zstd );
+        fwrite( &type, 1, sizeof( type ), m_file );
+        if( dict )
+        {
+            const auto hash = GetDictionaryHash( dict, dictSize );
+            fwrite( &hash, 1, sizeof( hash ), m_file );
+        }
+    }
+
+    void InitContext( Context& ctx )
+    {
+        ctx.lz4 = nullptr;
+        ctx.zstd = nullptr;
+        switch( m_comp )
         {
         case Compression::Fast:
-            m_stream = LZ4_createStream();
+            ctx.lz4 = malloc( LZ4_sizeofState() );
             break;
         case Compression::Slow:
-            m_streamHC = LZ4_createStreamHC();
-            break;
         case Compression::Extreme:
-            m_streamHC = LZ4_createStreamHC();
-            LZ4_resetStreamHC( m_streamHC, LZ4HC_CLEVEL_MAX );
+            ctx.lz4 = malloc( LZ4_sizeofStateHC() );
             break;
         case Compression::Zstd:
-            m_streamZstd = ZSTD_createCStream();
-            ZSTD_CCtx_setParameter( m_streamZstd, ZSTD_c_compressionLevel, level );
-            ZSTD_CCtx_setParameter( m_streamZstd, ZSTD_c_contentSizeFlag, 0 );
+            ctx.zstd = ZSTD_createCCtx();
+            ZSTD_CCtx_setParameter( ctx.zstd, ZSTD_c_compressionLevel, m_level );
+            if( m_dict ) ZSTD_CCtx_refCDict( ctx.zstd, m_dict );
             break;
         default:
             assert( false );
             break;
         }
+    }
 
-        if( comp == Compression::Zstd )
-        {
-            fwrite( ZstdHeader, 1, sizeof( ZstdHeader ), m_file );
-        }
-        else
+    // Each compression thread needs a block to work on, and the writing thread needs some slack to fill the next
+    // blocks while the finished ones wait to be written out in order.
+    void StartPool()
+    {
+        assert( m_submitted == 0 );
+        m_blocks.resize( m_poolSize * 2 );
+        for( size_t i=1; i<m_blocks.size(); i++ ) m_blocks[i].src.reset( new char[FileBlockSize] );
+        m_ctx.resize( m_poolSize );
+        for( size_t i=1; i<m_ctx.size(); i++ ) InitContext( m_ctx[i] );
+        for( int i=0; i<m_poolSize; i++ )
         {
-            fwrite( Lz4Header, 1, sizeof( Lz4Header ), m_file );
+            m_threads.emplace_back( [this, i] { CompressThread( m_ctx[i] ); } );
         }
     }
 
@@ -121,60 +208,140 @@ private:
         auto src = (const char*)ptr;
         while( size > 0 )
         {
-            const auto sz = std::min( size, BufSize - m_offset );
+            const auto sz = std::min<size_t>( size, FileBlockSize - m_offset );
             memcpy( m_buf + m_offset, src, sz );
             m_offset += sz;
             src += sz;
             size -= sz;
 
-            if( m_offset == BufSize )
+            if( m_offset == FileBlockSize )
             {
-                WriteLz4Block();
+                SubmitBlock();
             }
         }
     }
 
-    void WriteLz4Block()
+    void Compress( Context& ctx, Block& block )
     {
-        char lz4[LZ4Size];
-        uint32_t sz;
-        if( m_stream )
+        switch( m_comp )
         {
-            sz = LZ4_compress_fast_continue( m_stream, m_buf, lz4, m_offset, LZ4Size, 1 );
+        case Compression::Fast:
+            block.dstSize = LZ4_compress_fast_extState( ctx.lz4, block.src.get(), block.dst.get(), block.srcSize, CompressedSize, 1 );
+            break;
+        case Compression::Slow:
+            block.dstSize = LZ4_compress_HC_extStateHC( ctx.lz4, block.src.get(), block.dst.get(), block.srcSize, CompressedSize, LZ4HC_CLEVEL_DEFAULT );
+            break;
+        case Compression::Extreme:
+            block.dstSize = LZ4_compress_HC_extStateHC( ctx.lz4, block.src.get(), block.dst.get(), block.srcSize, CompressedSize, LZ4HC_CLEVEL_MAX );
+            break;
+        case Compression::Zstd:
+        {
+            const auto ret = ZSTD_compress2( ctx.zstd, block.dst.get(), CompressedSize, block.src.get(), block.srcSize );
+            assert( !ZSTD_isError( ret ) );
+            block.dstSize = ret;
+            break;
+        }
+        default:
+            assert( false );
+            break;
         }
-        else if( m_streamZstd )
+    }
+
+    void CompressThread( Context& ctx )
+    {
+        std::unique_lock<std::mutex> lock( m_lock );
+        for(;;)
+        {
+            m_queueCv.wait( lock, [this] { return m_exit || m_queued != m_submitted; } );
+            if( m_queued == m_submitted ) return;
+            auto& block = m_blocks[m_queued++ % m_blocks.size()];
+            lock.unlock();
+            Compress( ctx, block );
+            lock.lock();
+            block.done = true;
+            m_doneCv.notify_all();
+        }
+    }
+
+    void SubmitBlock()
+    {
+        if( m_submitted == 0 && m_poolSize > 0 && m_offset == FileBlockSize ) StartPool();
+
+        auto& block = m_blocks[m_submitted % m_blocks.size()];
+        if( !block.dst ) block.dst.reset( new char[CompressedSize] );
+        block.srcSize = m_offset;
+        block.done = false;
+        m_position += m_offset;
+        if( m_threads.empty() )
         {
-            ZSTD_outBuffer out = { lz4, LZ4Size, 0 };
-            ZSTD_inBuffer in = { m_buf, m_offset, 0 };
-            const auto ret = ZSTD_compressStream2( m_streamZstd, &out, &in, ZSTD_e_flush );
-            assert( ret == 0 );
-            sz = out.pos;
+            Compress( m_ctx[0], block );
+            block.done = true;
+            m_submitted++;
         }
         else
         {
-            sz = LZ4_compress_HC_continue( m_streamHC, m_buf, lz4, m_offset, LZ4Size );
+            {
+                std::lock_guard<std::mutex> lock( m_lock );
+                m_submitted++;
+            }
+            m_queueCv.notify_one();
         }
 
-        m_srcBytes += m_offset;
-        m_dstBytes += sz;
+        // Blocks are written out in order, as soon as they are compressed, or when their buffer is needed again.
+        while( m_written != m_submitted && ( m_submitted - m_written == m_blocks.size() || IsDone( m_blocks[m_written % m_blocks.size()] ) ) )
+        {
+            WriteBlock();
+        }
 
-        fwrite( &sz, 1, sizeof( sz ), m_file );
-        fwrite( lz4, 1, sz, m_file );
+        m_buf = m_blocks[m_submitted % m_blocks.size()].src.get();
         m_offset = 0;
-        std::swap( m_buf, m_second );
     }
 
-    enum { BufSize = 64 * 1024 };
-    enum { LZ4Size = std::max( LZ4_COMPRESSBOUND( BufSize ), ZSTD_COMPRESSBOUND( BufSize ) ) };
+    bool IsDone( const Block& block )
+    {
+        std::lock_guard<std::mutex> lock( m_lock );
+        return block.done;
+    }
 
-    LZ4_stream_t* m_stream;
-    LZ4_streamHC_t* m_streamHC;
-    ZSTD_CStream* m_streamZstd;
+    void WriteBlock()
+    {
+        auto& block = m_blocks[m_written % m_blocks.size()];
+        if( !m_threads.empty() )
+        {
+            std::unique_lock<std::mutex> lock( m_lock );
+            m_doneCv.wait( lock, [&block] { return block.done; } );
+        }
+
+        m_srcBytes += block.srcSize;
+        m_dstBytes += block.dstSize;
+
+        fwrite( &block.dstSize, 1, sizeof( block.dstSize ), m_file );
+        fwrite( block.dst.get(), 1, block.dstSize, m_file );
+        m_written++;
+    }
+
+    enum { CompressedSize = std::max( LZ4_COMPRESSBOUND( FileBlockSize ), ZSTD_COMPRESSBOUND( FileBlockSize ) ) };
+
+    Compression m_comp;
+    int m_level;
+    ZSTD_CDict* m_dict;
+    int m_poolSize;
     FILE* m_file;
-    char m_bufData[2][BufSize];
     char* m_buf;
-    char* m_second;
     size_t m_offset;
+    uint64_t m_position;
+
+    std::vector<Block> m_blocks;
+    std::vector<Context> m_ctx;
+    std::vector<std::thread> m_threads;
+    std::mutex m_lock;
+    std::condition_variable m_queueCv;
+    std::condition_variable m_doneCv;
+    size_t m_submitted;
+    size_t m_queued;
+    size_t m_written;
+    bool m_exit;
+
     size_t m_srcBytes;
     size_t m_dstBytes;
 };
@@ -8,6 +8,10 @@ namespace tracy
 
 extern size_t memUsage;
 
+// Allocations of the trace data are counted here. Tasks which build trace data next to the worker
+// thread point it to a counter of their own, which the worker adds to memUsage once they are done.
+inline thread_local size_t* memUsageCounter = &memUsage;
+
 }
 
 #endif
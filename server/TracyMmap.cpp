@@ -18,6 +18,14 @@ void* mmap( void* addr, size_t length, int prot, int flags, int fd, off_t offset
             CloseHandle( hnd );
         }
         break;
+    case PROT_READ | PROT_WRITE:
+        if( flags != MAP_PRIVATE ) break;
+        if( hnd = CreateFileMapping( HANDLE( _get_osfhandle( fd ) ), nullptr, PAGE_WRITECOPY, 0, 0, nullptr ) )
+        {
+            map = MapViewOfFile( hnd, FILE_MAP_COPY, 0, 0, length );
+            CloseHandle( hnd );
+        }
+        break;
     case PROT_WRITE:
         if( hnd = CreateFileMapping( HANDLE( _get_osfhandle( fd ) ), nullptr, PAGE_READWRITE, 0, 0, nullptr ) )
         {
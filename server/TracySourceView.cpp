@@ -111,6 +111,68 @@ static size_t CountHwSamples( const SortedVector<Int48, Int48Sort>& vec, const R
     return std::distance( it, end );
 }
 
+// Grouped samples carry scaled event counts. Samples of the group leader tell
+// when the counts were collected, so a time range gets the matching share of them.
+static uint64_t CountHwEvents( const SortedVector<Int48, Int48Sort>& leader, uint64_t count, const Range& range )
+{
+    if( !range.active ) return count;
+    const auto sz = leader.size();
+    if( sz == 0 ) return 0;
+    return uint64_t( double( count ) * CountHwSamples( leader, range ) / sz );
+}
+
+static HwSampleCounters GetHwSampleCounts( HwSampleData& hw, const Range& range )
+{
+    HwSampleCounters ret;
+    if( range.active ) hw.sort();
+    if( hw.counters.cycles != 0 )
+    {
+        ret.cycles = CountHwEvents( hw.cycles, hw.counters.cycles, range );
+        ret.retired = CountHwEvents( hw.cycles, hw.counters.retired, range );
+    }
+    else if( range.active )
+    {
+        ret.cycles = CountHwSamples( hw.cycles, range );
+        ret.retired = CountHwSamples( hw.retired, range );
+    }
+    else
+    {
+        ret.cycles = hw.cycles.size();
+        ret.retired = hw.retired.size();
+    }
+    if( hw.counters.cacheRef != 0 )
+    {
+        ret.cacheRef = CountHwEvents( hw.cacheRef, hw.counters.cacheRef, range );
+        ret.cacheMiss = CountHwEvents( hw.cacheRef, hw.counters.cacheMiss, range );
+    }
+    else if( range.active )
+    {
+        ret.cacheRef = CountHwSamples( hw.cacheRef, range );
+        ret.cacheMiss = CountHwSamples( hw.cacheMiss, range );
+    }
+    else
+    {
+        ret.cacheRef = hw.cacheRef.size();
+        ret.cacheMiss = hw.cacheMiss.size();
+    }
+    if( hw.counters.branchRetired != 0 )
+    {
+        ret.branchRetired = CountHwEvents( hw.branchRetired, hw.counters.branchRetired, range );
+        ret.branchMiss = CountHwEvents( hw.branchRetired, hw.counters.branchMiss, range );
+    }
+    else if( range.active )
+    {
+        ret.branchRetired = CountHwSamples( hw.branchRetired, range );
+        ret.branchMiss = CountHwSamples( hw.branchMiss, range );
+    }
+    else
+    {
+        ret.branchRetired = hw.branchRetired.size();
+        ret.branchMiss = hw.branchMiss.size();
+    }
+    return ret;
+}
+
 static void PrintHwSampleTooltip( size_t cycles, size_t retired, size_t cacheRef, size_t cacheMiss, size_t branchRetired, size_t branchMiss, bool hideFirstSeparator )
 {
     if( cycles || retired )
@@ -3194,26 +3256,13 @@ void SourceView::RenderLine( const Tokenizer::Line& line, int lineNum, const Add
                         if( hw )
                         {
                             hasHwData = true;
-                            auto& statRange = view->m_statRange;
-                            if( statRange.active )
-                            {
-                                hw->sort();
-                                cycles += CountHwSamples( hw->cycles, statRange );
-                                retired += CountHwSamples( hw->retired, statRange );
-                                cacheRef += CountHwSamples( hw->cacheRef, statRange );
-                                cacheMiss += CountHwSamples( hw->cacheMiss, statRange );
-                                branchRetired += CountHwSamples( hw->branchRetired, statRange );
-                                branchMiss += CountHwSamples( hw->branchMiss, statRange );
-                            }
-                            else
-                            {
-                                cycles += hw->cycles.size();
-                                retired += hw->retired.size();
-                                cacheRef += hw->cacheRef.size();
-                                cacheMiss += hw->cacheMiss.size();
-                                branchRetired += hw->branchRetired.size();
-                                branchMiss += hw->branchMiss.size();
-                            }
+                            const auto hwCnt = GetHwSampleCounts( *hw, view->m_statRange );
+                            cycles += hwCnt.cycles;
+                            retired += hwCnt.retired;
+                            cacheRef += hwCnt.cacheRef;
+                            cacheMiss += hwCnt.cacheMiss;
+                            branchRetired += hwCnt.branchRetired;
+                            branchMiss += hwCnt.branchMiss;
                         }
                     }
                 }
@@ -3506,25 +3555,13 @@ void SourceView::RenderAsmLine( AsmLine& line, const AddrStat& ipcnt, const Addr
     size_t cycles = 0, retired = 0, cacheRef = 0, cacheMiss = 0, branchRetired = 0, branchMiss = 0;
     if( hw && ( !m_calcInlineStats || worker.GetInlineSymbolForAddress( line.addr ) == m_symAddr ) )
     {
-        if( view.m_statRange.active )
-        {
-            hw->sort();
-            cycles = CountHwSamples( hw->cycles, view.m_statRange );
-            retired = CountHwSamples( hw->retired, view.m_statRange );
-            cacheRef = CountHwSamples( hw->cacheRef, view.m_statRange );
-            cacheMiss = CountHwSamples( hw->cacheMiss, view.m_statRange );
-            branchRetired = CountHwSamples( hw->branchRetired, view.m_statRange );
-            branchMiss = CountHwSamples( hw->branchMiss, view.m_statRange );
-        }
-        else
-        {
-            cycles = hw->cycles.size();
-            retired = hw->retired.size();
-            cacheRef = hw->cacheRef.size();
-            cacheMiss = hw->cacheMiss.size();
-            branchRetired = hw->branchRetired.size();
-            branchMiss = hw->branchMiss.size();
-        }
+        const auto hwCnt = GetHwSampleCounts( *hw, view.m_statRange );
+        cycles = hwCnt.cycles;
+        retired = hwCnt.retired;
+        cacheRef = hwCnt.cacheRef;
+        cacheMiss = hwCnt.cacheMiss;
+        branchRetired = hwCnt.branchRetired;
+        branchMiss = hwCnt.branchMiss;
     }
 
     const auto ts = ImGui::CalcTextSize( " " );
@@ -4868,36 +4905,19 @@ void SourceView::GatherIpHwStats( AddrStatData& as, Worker& worker, const View&
         if( m_calcInlineStats && worker.GetInlineSymbolForAddress( addr ) != m_symAddr ) continue;
         const auto hw = worker.GetHwSampleData( addr );
         if( !hw ) continue;
+        const auto hwCnt = GetHwSampleCounts( *hw, view.m_statRange );
         uint64_t stat;
-        if( view.m_statRange.active )
-        {
-            switch( cost )
-            {
-            case CostType::Cycles:          stat = CountHwSamples( hw->cycles, view.m_statRange ); break;
-            case CostType::Retirements:     stat = CountHwSamples( hw->retired, view.m_statRange ); break;
-            case CostType::BranchesTaken:   stat = CountHwSamples( hw->branchRetired, view.m_statRange ); break;
-            case CostType::BranchMiss:      stat = CountHwSamples( hw->branchMiss, view.m_statRange ); break;
-            case CostType::SlowBranches:    stat = sqrt( CountHwSamples( hw->branchMiss, view.m_statRange ) * CountHwSamples( hw->branchRetired, view.m_statRange ) ); break;
-            case CostType::CacheAccess:     stat = CountHwSamples( hw->cacheRef, view.m_statRange ); break;
-            case CostType::CacheMiss:       stat = CountHwSamples( hw->cacheMiss, view.m_statRange ); break;
-            case CostType::SlowCache:       stat = sqrt( CountHwSamples( hw->cacheMiss, view.m_statRange ) * CountHwSamples( hw->cacheRef, view.m_statRange ) ); break;
-            default: assert( false ); return;
-            }
-        }
-        else
-        {
-            switch( cost )
-            {
-            case CostType::Cycles:          stat = hw->cycles.size(); break;
-            case CostType::Retirements:     stat = hw->retired.size(); break;
-            case CostType::BranchesTaken:   stat = hw->branchRetired.size(); break;
-            case CostType::BranchMiss:      stat = hw->branchMiss.size(); break;
-            case CostType::SlowBranches:    stat = sqrt( hw->branchMiss.size() *  hw->branchRetired.size() ); break;
-            case CostType::CacheAccess:     stat = hw->cacheRef.size(); break;
-            case CostType::CacheMiss:       stat = hw->cacheMiss.size(); break;
-            case CostType::SlowCache:       stat = sqrt( hw->cacheMiss.size() * hw->cacheRef.size() ); break;
-            default: assert( false ); return;
-            }
+        switch( cost )
+        {
+        case CostType::Cycles:          stat = hwCnt.cycles; break;
+        case CostType::Retirements:     stat = hwCnt.retired; break;
+        case CostType::BranchesTaken:   stat = hwCnt.branchRetired; break;
+        case CostType::BranchMiss:      stat = hwCnt.branchMiss; break;
+        case CostType::SlowBranches:    stat = sqrt( double( hwCnt.branchMiss ) * hwCnt.branchRetired ); break;
+        case CostType::CacheAccess:     stat = hwCnt.cacheRef; break;
+        case CostType::CacheMiss:       stat = hwCnt.cacheMiss; break;
+        case CostType::SlowCache:       stat = sqrt( double( hwCnt.cacheMiss ) * hwCnt.cacheRef ); break;
+        default: assert( false ); return;
         }
         assert( as.ipCountAsm.find( addr ) == as.ipCountAsm.end() );
         as.ipCountAsm.emplace( addr, AddrStat { stat, 0 } );
@@ -4949,31 +4969,17 @@ void SourceView::CountHwStats( AddrStatData& as, Worker& worker, const View& vie
         if( m_calcInlineStats && worker.GetInlineSymbolForAddress( addr ) != m_symAddr ) continue;
         const auto hw = worker.GetHwSampleData( addr );
         if( !hw ) continue;
+        const auto hwCnt = GetHwSampleCounts( *hw, view.m_statRange );
         uint64_t branch, cache;
-        if( view.m_statRange.active )
+        if( hasBranchRetirement )
         {
-            if( hasBranchRetirement )
-            {
-                branch = sqrt( CountHwSamples( hw->branchMiss, view.m_statRange ) * CountHwSamples( hw->branchRetired, view.m_statRange ) );
-            }
-            else
-            {
-                branch = CountHwSamples( hw->branchMiss, view.m_statRange );
-            }
-            cache = sqrt( CountHwSamples( hw->cacheMiss, view.m_statRange ) * CountHwSamples( hw->cacheRef, view.m_statRange ) );
+            branch = sqrt( double( hwCnt.branchMiss ) * hwCnt.branchRetired );
         }
         else
         {
-            if( hasBranchRetirement )
-            {
-                branch = sqrt( hw->branchMiss.size() *  hw->branchRetired.size() );
-            }
-            else
-            {
-                branch = hw->branchMiss.size();
-            }
-            cache = sqrt( hw->cacheMiss.size() * hw->cacheRef.size() );
+            branch = hwCnt.branchMiss;
         }
+        cache = sqrt( double( hwCnt.cacheMiss ) * hwCnt.cacheRef );
         assert( as.hwCountAsm.find( addr ) == as.hwCountAsm.end() );
         as.hwCountAsm.emplace( addr, AddrStat { branch, cache } );
         if( as.hwMaxAsm.local < branch ) as.hwMaxAsm.local = branch;
@@ -47,7 +47,7 @@ public:
         , m_capacity( 0 )
         , m_magic( 0 )
     {
-        memUsage += sizeof( T );
+        *memUsageCounter += sizeof( T );
         new(m_ptr) T( value );
     }
 
@@ -55,7 +55,7 @@ public:
     {
         if( m_capacity != MaxCapacity() && m_ptr )
         {
-            memUsage -= Capacity() * sizeof( T );
+            *memUsageCounter -= Capacity() * sizeof( T );
             free( m_ptr );
         }
     }
@@ -65,7 +65,7 @@ public:
     {
         if( m_capacity != MaxCapacity() && m_ptr )
         {
-            memUsage -= Capacity() * sizeof( T );
+            *memUsageCounter -= Capacity() * sizeof( T );
             free( m_ptr );
         }
         memcpy( (char*)this, &src, sizeof( Vector<T> ) );
@@ -254,7 +254,7 @@ public:
         cap |= cap >> 8;
         cap |= cap >> 16;
         cap = TracyCountBits( cap );
-        memUsage += ( ( 1 << cap ) - Capacity() ) * sizeof( T );
+        *memUsageCounter += ( ( 1 << cap ) - Capacity() ) * sizeof( T );
         m_capacity = cap;
         Realloc();
     }
@@ -275,6 +275,15 @@ public:
         m_ptr = (T*)slab.AllocBig( sizeof( T ) * sz );
     }
 
+    // The vector doesn't own the memory, which may be, for example, memory mapped from a file.
+    tracy_force_inline void set_external( T* ptr, uint32_t sz )
+    {
+        assert( !m_ptr );
+        m_capacity = MaxCapacity();
+        m_size = sz;
+        m_ptr = ptr;
+    }
+
     tracy_force_inline void clear()
     {
         assert( m_capacity != MaxCapacity() );
@@ -291,13 +300,13 @@ private:
 
         if( m_ptr == nullptr )
         {
-            memUsage += sizeof( T );
+            *memUsageCounter += sizeof( T );
             m_ptr = (T*)malloc( sizeof( T ) );
             m_capacity = 0;
         }
         else
         {
-            memUsage += Capacity() * sizeof( T );
+            *memUsageCounter += Capacity() * sizeof( T );
             m_capacity++;
             Realloc();
         }
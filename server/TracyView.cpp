@@ -10,6 +10,7 @@
 #include <inttypes.h>
 #include <math.h>
 #include <mutex>
+#include <time.h>
 
 #include "imgui.h"
 
@@ -18,6 +19,7 @@
 #include "TracyImGui.hpp"
 #include "TracyPrint.hpp"
 #include "TracySourceView.hpp"
+#include "TracyStorage.hpp"
 #include "TracyTexture.hpp"
 #include "TracyView.hpp"
 #include "../public/common/TracyStackFrames.hpp"
@@ -44,8 +46,18 @@ namespace tracy
 
 double s_time = 0;
 
+static std::string JournalPath()
+{
+    char buf[64];
+    const auto t = time( nullptr );
+    strftime( buf, sizeof( buf ), "checkpoint-%Y%m%d-%H%M%S.tracy", localtime( &t ) );
+    return GetSavePath( buf );
+}
+
 View::View( void(*cbMainThread)(const std::function<void()>&, bool), const char* addr, uint16_t port, ImFont* fixedWidth, ImFont* smallFont, ImFont* bigFont, SetTitleCallback stcb, SetScaleCallback sscb, AttentionCallback acb, const Config& config )
-    : m_worker( addr, port )
+    : m_journalFile { config.checkpointInterval > 0 ? JournalPath() : std::string() }
+    , m_journal( m_journalFile.path.empty() ? nullptr : FileWrite::Open( m_journalFile.path.c_str(), FileWrite::Compression::Fast, 1, 1 ) )
+    , m_worker( addr, port, Worker::DefaultNetBufferDepth, m_journal.get(), nullptr, m_journal != nullptr )
     , m_staticView( false )
     , m_viewMode( ViewMode::LastFrames )
     , m_viewModeHeuristicTry( true )
@@ -68,6 +80,9 @@ View::View( void(*cbMainThread)(const std::function<void()>&, bool), const char*
     InitTextEditor();
 
     m_vd.frameTarget = config.targetFps;
+    m_worker.SetMemoryLimit( uint64_t( config.memoryLimit ) * 1024 * 1024 );
+    if( m_journal ) m_worker.SetCheckpointInterval( config.checkpointInterval );
+    else m_journalFile.path.clear();
 }
 
 View::View( void(*cbMainThread)(const std::function<void()>&, bool), FileRead& f, ImFont* fixedWidth, ImFont* smallFont, ImFont* bigFont, SetTitleCallback stcb, SetScaleCallback sscb, AttentionCallback acb, const Config& config )
@@ -115,6 +130,9 @@ View::~View()
 
     if( m_compare.loadThread.joinable() ) m_compare.loadThread.join();
     if( m_saveThread.joinable() ) m_saveThread.join();
+    StopLockContention();
+
+    m_journalFile.keep = !m_traceSaved && m_worker.GetCrashEvent().thread != 0;
 
     if( m_frameTexture ) FreeTexture( m_frameTexture, m_cbMainThread );
     if( m_playback.texture ) FreeTexture( m_playback.texture, m_cbMainThread );
@@ -796,7 +814,7 @@ bool View::DrawImpl()
             ImGui::EndPopup();
         }
     }
-    std::lock_guard<std::mutex> lock( m_worker.GetDataLock() );
+    std::lock_guard<Worker::DataLock> lock( m_worker.GetDataLock() );
     m_worker.DoPostponedWork();
     if( !m_worker.IsDataStatic() )
     {
@@ -894,6 +912,10 @@ bool View::DrawImpl()
         {
             m_showWaitStacks = true;
         }
+        if( ButtonDisablable( ICON_FA_LOCK " Lock contention", m_worker.GetLockMap().empty() ) )
+        {
+            m_showLockContention = true;
+        }
         ImGui::EndPopup();
     }
     if( m_sscb )
@@ -1089,6 +1111,7 @@ bool View::DrawImpl()
     if( m_sampleParents.symAddr != 0 ) DrawSampleParents();
     if( m_showRanges ) DrawRanges();
     if( m_showWaitStacks ) DrawWaitStacks();
+    if( m_showLockContention ) DrawLockContention();
 
     if( m_setRangePopup.active )
     {
@@ -1123,6 +1146,12 @@ bool View::DrawImpl()
             m_memInfo.range.min = s;
             m_memInfo.range.max = e;
         }
+        if( ImGui::Selectable( ICON_FA_LOCK " Limit lock contention range" ) )
+        {
+            m_lockContentionRange.active = true;
+            m_lockContentionRange.min = s;
+            m_lockContentionRange.max = e;
+        }
         ImGui::Separator();
         if( ImGui::Selectable( ICON_FA_NOTE_STICKY " Add annotation" ) )
         {
@@ -1361,9 +1390,10 @@ bool View::Save( const char* fn, FileWrite::Compression comp, int zlevel, bool b
     m_userData.StateShouldBePreserved();
     m_saveThreadState.store( SaveThreadState::Saving, std::memory_order_relaxed );
     m_saveThread = std::thread( [this, f{std::move( f )}, buildDict] {
-        std::lock_guard<std::mutex> lock( m_worker.GetDataLock() );
+        std::lock_guard<Worker::DataLock> lock( m_worker.GetDataLock() );
         m_worker.Write( *f, buildDict );
         f->Finish();
+        m_traceSaved = true;
         const auto stats = f->GetCompressionStatistics();
         m_srcFileBytes.store( stats.first, std::memory_order_relaxed );
         m_dstFileBytes.store( stats.second, std::memory_order_relaxed );
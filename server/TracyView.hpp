@@ -156,6 +156,7 @@ public:
     bool m_showRanges = false;
     Range m_statRange;
     Range m_waitStackRange;
+    Range m_lockContentionRange;
 
 private:
     enum class ShortcutAction : uint8_t
@@ -267,6 +268,10 @@ private:
     void DrawRangeEntry( Range& range, const char* label, uint32_t color, const char* popupLabel, int id );
     void DrawSourceTooltip( const char* filename, uint32_t line, int before = 3, int after = 3, bool separateTooltip = true );
     void DrawWaitStacks();
+    void DrawLockContention();
+    void DrawLockHistogram( const char* id, const uint64_t* hist, uint32_t color );
+    void StartLockContention();
+    void StopLockContention();
 
     void ListMemData( std::vector<const MemEvent*>& vec, const std::function<void(const MemEvent*)>& DrawAddress, int64_t startTime = -1, uint64_t pool = 0 );
 
@@ -278,7 +283,7 @@ private:
 
     unordered_flat_map<uint64_t, CallstackFrameTree> GetCallstackFrameTreeBottomUp( const unordered_flat_map<uint32_t, uint64_t>& stacks, bool group ) const;
     unordered_flat_map<uint64_t, CallstackFrameTree> GetCallstackFrameTreeTopDown( const unordered_flat_map<uint32_t, uint64_t>& stacks, bool group ) const;
-    void DrawFrameTreeLevel( const unordered_flat_map<uint64_t, CallstackFrameTree>& tree, int& idx );
+    void DrawFrameTreeLevel( const unordered_flat_map<uint64_t, CallstackFrameTree>& tree, int& idx, bool time = false );
 
     unordered_flat_map<uint64_t, CallstackFrameTree> GetParentsCallstackFrameTreeBottomUp( const unordered_flat_map<uint32_t, uint32_t>& stacks, bool group ) const;
     unordered_flat_map<uint64_t, CallstackFrameTree> GetParentsCallstackFrameTreeTopDown( const unordered_flat_map<uint32_t, uint32_t>& stacks, bool group ) const;
@@ -415,6 +420,20 @@ private:
     static const char* DecodeContextSwitchReason( uint8_t reason );
     static const char* DecodeContextSwitchReasonCode( uint8_t reason );
 
+    // The journal is only needed to recover the session after the profiler crashed, or when the trace of a
+    // crashed program wasn't saved. It's removed once the worker and the journal writer are destroyed.
+    struct JournalFile
+    {
+        ~JournalFile() { if( !keep && !path.empty() ) remove( path.c_str() ); }
+
+        std::string path;
+        bool keep = true;
+    };
+
+    // Declared before the worker, which writes to the journal until it is destroyed.
+    JournalFile m_journalFile;
+    std::unique_ptr<FileWrite> m_journal;
+
     Worker m_worker;
     std::string m_filename, m_filenameStaging;
     bool m_staticView;
@@ -484,6 +503,7 @@ private:
     bool m_showCpuDataWindow = false;
     bool m_showAnnotationList = false;
     bool m_showWaitStacks = false;
+    bool m_showLockContention = false;
 
     AccumulationMode m_statAccumulationMode = AccumulationMode::SelfOnly;
     bool m_statSampleTime = true;
@@ -509,6 +529,7 @@ private:
     int m_waitStackMode = 0;
     bool m_groupWaitStackBottomUp = true;
     bool m_groupWaitStackTopDown = true;
+    bool m_waitStackTime = false;
 
     ShortcutAction m_shortcut = ShortcutAction::None;
     ShortenName m_shortenName = ShortenName::NoSpaceAndNormalize;
@@ -523,6 +544,20 @@ private:
     BuzzAnim<uint32_t> m_statBuzzAnim;
 
     Vector<const ZoneEvent*> m_zoneInfoStack;
+
+    // Wait stack breakdown of the zone in the zone info window. New samples are added as they come, and
+    // samples without a known wait time are retried only when the thread's context switch data grows.
+    struct
+    {
+        const ZoneEvent* zone = nullptr;
+        int64_t end;
+        size_t next;
+        size_t ctxSize;
+        int64_t total;
+        Vector<size_t> unresolved;
+        unordered_flat_map<uint32_t, int64_t> waits;
+        Vector<std::pair<uint32_t, int64_t>> sorted;
+    } m_zoneWaitCache;
     Vector<const GpuEvent*> m_gpuInfoStack;
 
     SourceContents m_srcHintCache;
@@ -564,6 +599,7 @@ private:
 
     std::atomic<SaveThreadState> m_saveThreadState { SaveThreadState::Inert };
     std::thread m_saveThread;
+    bool m_traceSaved = false;
     std::atomic<size_t> m_srcFileBytes { 0 };
     std::atomic<size_t> m_dstFileBytes { 0 };
 
@@ -791,6 +827,41 @@ private:
         }
     } m_compare;
 
+    struct LockContentionSite
+    {
+        uint64_t count = 0;
+        int64_t time = 0;
+    };
+
+    struct LockContentionData
+    {
+        uint32_t id;
+        uint64_t waitCount = 0;
+        int64_t waitTime = 0;
+        int64_t waitMax = 0;
+        uint64_t holdCount = 0;
+        int64_t holdTime = 0;
+        int64_t holdMax = 0;
+        uint64_t waitHist[64] = {};
+        uint64_t holdHist[64] = {};
+        unordered_flat_map<uint32_t, LockContentionSite> callstacks;
+        unordered_flat_map<int16_t, LockContentionSite> srclocs;
+        unordered_flat_map<uint16_t, LockContentionSite> edges;     // owner thread index << 8 | waiter thread index
+    };
+
+    struct {
+        std::thread thread;
+        std::atomic<bool> done { false };
+        std::atomic<bool> abort { false };
+        std::vector<LockContentionData> data;
+        bool valid = false;
+        bool rangeActive = false;
+        int64_t rangeMin = 0;
+        int64_t rangeMax = 0;
+        size_t lockCount = 0;
+        uint32_t selected = InvalidId;
+    } m_lockContention;
+
     struct {
         bool show = false;
         char pattern[1024] = {};
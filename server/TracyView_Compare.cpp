@@ -228,6 +228,16 @@ void View::DrawCompare()
                 {
                     m_compare.badVer.state = BadVersionState::BadFile;
                 }
+                catch( const tracy::DictionaryNotFound& e )
+                {
+                    m_compare.badVer.state = BadVersionState::DictionaryNotFound;
+                    m_compare.badVer.msg = e.path;
+                }
+                catch( const tracy::PackNotFound& e )
+                {
+                    m_compare.badVer.state = BadVersionState::PackNotFound;
+                    m_compare.badVer.msg = e.path;
+                }
                 catch( const tracy::FileReadError& )
                 {
                     m_compare.badVer.state = BadVersionState::ReadError;
@@ -1,3 +1,5 @@
+#include <time.h>
+
 #include "TracyFileselector.hpp"
 #include "TracyImGui.hpp"
 #include "TracyPrint.hpp"
@@ -47,6 +49,23 @@ bool View::DrawConnection()
         sendQueue = m_worker.GetSendQueueSize();
         TextFocused( "Query backlog:", RealToString( sendQueue ) );
     }
+    if( !m_journalFile.path.empty() )
+    {
+        TextDisabledUnformatted( "Journal:" );
+        ImGui::SameLine();
+        ImGui::TextUnformatted( m_journalFile.path.c_str() );
+        const auto checkpoint = m_worker.GetCheckpointTime();
+        if( checkpoint == 0 )
+        {
+            TextFocused( "Last checkpoint:", "none" );
+        }
+        else
+        {
+            TextFocused( "Last checkpoint:", TimeToString( ( time( nullptr ) - checkpoint ) * 1000000000ll ) );
+            ImGui::SameLine();
+            TextDisabledUnformatted( "ago" );
+        }
+    }
 
     if( !m_sendQueueWarning.enabled )
     {
@@ -80,7 +99,7 @@ bool View::DrawConnection()
     ImGui::GetWindowDrawList()->AddCircleFilled( wpos + ImVec2( 1 + cs * 0.5, 3 + ty * 1.75 ), cs * 0.5, isConnected ? 0xFF2222CC : 0xFF444444, 10 );
 
     {
-        std::lock_guard<std::mutex> lock( m_worker.GetDataLock() );
+        std::lock_guard<Worker::DataLock> lock( m_worker.GetDataLock() );
         ImGui::SameLine();
         TextFocused( "+", RealToString( m_worker.GetSendInFlight() ) );
         const auto sz = m_worker.GetFrameCount( *m_frames );
@@ -144,7 +163,7 @@ bool View::DrawConnection()
 
     ImGui::SameLine( 0, 2 * ty );
     const char* stopStr = ICON_FA_PLUG " Stop";
-    std::lock_guard<std::mutex> lock( m_worker.GetDataLock() );
+    std::lock_guard<Worker::DataLock> lock( m_worker.GetDataLock() );
     if( !m_disconnectIssued && m_worker.IsConnected() )
     {
         if( ImGui::Button( stopStr ) )
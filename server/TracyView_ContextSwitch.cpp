@@ -361,11 +361,33 @@ void View::DrawWaitStacks()
     ImGui::TextWrapped( "Rebuild without the TRACY_NO_STATISTICS macro to enable wait stacks." );
 #else
     uint64_t totalCount = 0;
+    uint64_t totalTime = 0;
     unordered_flat_map<uint32_t, uint64_t> stacks;
     for( auto& t : m_threadOrder )
     {
         if( WaitStackThread( t->id ) )
         {
+            if( m_waitStackTime && !m_waitStackRange.active )
+            {
+                totalCount += t->ctxSwitchSamples.size();
+                auto wt = m_worker.GetThreadWaitTime( t->id );
+                if( !wt ) continue;
+                totalTime += wt->total;
+                for( auto& v : wt->stacks )
+                {
+                    auto cit = stacks.find( v.first );
+                    if( cit == stacks.end() )
+                    {
+                        stacks.emplace( v.first, v.second );
+                    }
+                    else
+                    {
+                        cit->second += v.second;
+                    }
+                }
+                continue;
+            }
+
             auto it = t->ctxSwitchSamples.begin();
             auto end = t->ctxSwitchSamples.end();
             if( m_waitStackRange.active )
@@ -376,15 +398,27 @@ void View::DrawWaitStacks()
             totalCount += std::distance( it, end );
             while( it != end )
             {
+                uint64_t val = 1;
+                if( m_waitStackTime )
+                {
+                    const auto wait = m_worker.GetContextSwitchSampleWaitTime( t->id, it->time.Val() );
+                    if( wait < 0 )
+                    {
+                        ++it;
+                        continue;
+                    }
+                    val = std::min( wait, m_waitStackRange.max - it->time.Val() );
+                    totalTime += val;
+                }
                 auto cs = it->callstack.Val();
                 auto cit = stacks.find( cs );
                 if( cit == stacks.end() )
                 {
-                    stacks.emplace( cs, 1 );
+                    stacks.emplace( cs, val );
                 }
                 else
                 {
-                    cit->second++;
+                    cit->second += val;
                 }
                 ++it;
             }
@@ -413,6 +447,13 @@ void View::DrawWaitStacks()
     ImGui::Spacing();
     ImGui::SameLine();
     TextFocused( "Selected:", RealToString( totalCount ) );
+    if( m_waitStackTime )
+    {
+        ImGui::SameLine();
+        ImGui::Spacing();
+        ImGui::SameLine();
+        TextFocused( "Wait time:", TimeToString( totalTime ) );
+    }
     ImGui::SameLine();
     ImGui::Spacing();
     ImGui::SameLine();
@@ -420,6 +461,11 @@ void View::DrawWaitStacks()
     ImGui::SameLine();
     ImGui::Spacing();
     ImGui::SameLine();
+    if( ImGui::Checkbox( ICON_FA_STOPWATCH " Show time", &m_waitStackTime ) ) m_waitStack = 0;
+    TooltipIfHovered( "Weight wait stacks by the off-CPU time following each context switch, instead of the number of context switches." );
+    ImGui::SameLine();
+    ImGui::Spacing();
+    ImGui::SameLine();
     if( ImGui::Checkbox( "Limit range", &m_waitStackRange.active ) )
     {
         if( m_waitStackRange.active && m_waitStackRange.min == 0 && m_waitStackRange.max == 0 )
@@ -535,10 +581,17 @@ void View::DrawWaitStacks()
             data.reserve( stacks.size() );
             for( auto it = stacks.begin(); it != stacks.end(); ++it ) data.push_back( it );
             pdqsort_branchless( data.begin(), data.end(), []( const auto& l, const auto& r ) { return l->second > r->second; } );
-            TextFocused( "Counts:", RealToString( data[m_waitStack]->second ) );
+            if( m_waitStackTime )
+            {
+                TextFocused( "Wait time:", TimeToString( data[m_waitStack]->second ) );
+            }
+            else
+            {
+                TextFocused( "Counts:", RealToString( data[m_waitStack]->second ) );
+            }
             ImGui::SameLine();
             char buf[64];
-            PrintStringPercent( buf, 100. * data[m_waitStack]->second / totalCount );
+            PrintStringPercent( buf, 100. * data[m_waitStack]->second / ( m_waitStackTime ? std::max<uint64_t>( totalTime, 1 ) : totalCount ) );
             TextDisabledUnformatted( buf );
             ImGui::Separator();
             DrawCallstackTable( data[m_waitStack]->first, false );
@@ -551,7 +604,7 @@ void View::DrawWaitStacks()
             if( !tree.empty() )
             {
                 int idx = 0;
-                DrawFrameTreeLevel( tree, idx );
+                DrawFrameTreeLevel( tree, idx, m_waitStackTime );
             }
             else
             {
@@ -566,7 +619,7 @@ void View::DrawWaitStacks()
             if( !tree.empty() )
             {
                 int idx = 0;
-                DrawFrameTreeLevel( tree, idx );
+                DrawFrameTreeLevel( tree, idx, m_waitStackTime );
             }
             else
             {
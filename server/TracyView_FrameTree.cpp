@@ -583,7 +583,7 @@ void View::DrawFrameTreeLevel( const unordered_flat_map<uint64_t, MemCallstackFr
     }
 }
 
-void View::DrawFrameTreeLevel( const unordered_flat_map<uint64_t, CallstackFrameTree>& tree, int& idx )
+void View::DrawFrameTreeLevel( const unordered_flat_map<uint64_t, CallstackFrameTree>& tree, int& idx, bool time )
 {
     std::vector<unordered_flat_map<uint64_t, CallstackFrameTree>::const_iterator> sorted;
     sorted.reserve( tree.size() );
@@ -700,27 +700,27 @@ void View::DrawFrameTreeLevel( const unordered_flat_map<uint64_t, CallstackFrame
             ImGui::SameLine();
             if( v.children.empty() )
             {
-                ImGui::TextColored( ImVec4( 0.2, 0.8, 0.8, 1.0 ), "(%s)", RealToString( v.count ) );
+                ImGui::TextColored( ImVec4( 0.2, 0.8, 0.8, 1.0 ), "(%s)", time ? TimeToString( v.count ) : RealToString( v.count ) );
                 TooltipIfHovered( "Cost in this node" );
             }
             else
             {
-                uint32_t childCost = 0;
+                uint64_t childCost = 0;
                 for( auto& c : v.children ) childCost += c.second.count;
                 const auto r = v.count - childCost;
                 if( r != 0 )
                 {
-                    ImGui::TextColored( ImVec4( 0.2, 0.8, 0.8, 1.0 ), "(%s)", RealToString( r ) );
+                    ImGui::TextColored( ImVec4( 0.2, 0.8, 0.8, 1.0 ), "(%s)", time ? TimeToString( r ) : RealToString( r ) );
                     TooltipIfHovered( "Cost only in this node" );
                     ImGui::SameLine();
                 }
-                ImGui::TextColored( ImVec4( 0.8, 0.8, 0.2, 1.0 ), "(%s)", RealToString( v.count ) );
+                ImGui::TextColored( ImVec4( 0.8, 0.8, 0.2, 1.0 ), "(%s)", time ? TimeToString( v.count ) : RealToString( v.count ) );
                 TooltipIfHovered( "Cost in this node and children" );
             }
 
             if( expand )
             {
-                DrawFrameTreeLevel( v.children, idx );
+                DrawFrameTreeLevel( v.children, idx, time );
                 ImGui::TreePop();
             }
         }
@@ -849,7 +849,7 @@ void View::DrawParentsFrameTreeLevel( const unordered_flat_map<uint64_t, Callsta
             }
             else
             {
-                uint32_t childCost = 0;
+                uint64_t childCost = 0;
                 for( auto& c : v.children ) childCost += c.second.count;
                 const auto r = v.count - childCost;
                 if( r != 0 )
@@ -5,6 +5,7 @@
 #include "TracyImGui.hpp"
 #include "TracyLockHelpers.hpp"
 #include "TracyMouse.hpp"
+#include "TracyPopcnt.hpp"
 #include "TracyPrint.hpp"
 #include "TracyTimelineContext.hpp"
 #include "TracyTimelineDraw.hpp"
@@ -13,6 +14,8 @@
 namespace tracy
 {
 
+extern double s_time;
+
 constexpr float MinVisSize = 3;
 
 void View::DrawLockHeader( uint32_t id, const LockMap& lockmap, const SourceLocation& srcloc, bool hover, ImDrawList* draw, const ImVec2& wpos, float w, float ty, float offset, uint8_t tid )
@@ -657,4 +660,421 @@ void View::DrawLockInfoWindow()
     if( !visible ) m_lockInfoWindow = InvalidId;
 }
 
+
+static tracy_force_inline int LockHistogramBin( int64_t time )
+{
+    return time <= 0 ? 0 : int( 64 - TracyLzcnt( uint64_t( time ) ) ) - 1;
+}
+
+template<typename M, typename K>
+static tracy_force_inline void AddLockContentionSite( M& map, K key, int64_t time )
+{
+    auto& site = map[key];
+    site.count++;
+    site.time += time;
+}
+
+void View::StartLockContention()
+{
+    StopLockContention();
+
+    m_lockContention.valid = true;
+    m_lockContention.rangeActive = m_lockContentionRange.active;
+    m_lockContention.rangeMin = m_lockContentionRange.min;
+    m_lockContention.rangeMax = m_lockContentionRange.max;
+    m_lockContention.lockCount = m_worker.GetLockMap().size();
+    m_lockContention.data.clear();
+    m_lockContention.done.store( false, std::memory_order_relaxed );
+
+    // Lock maps are slab allocated and never move, the list of them has to be taken here, under the data lock held by the UI.
+    std::vector<std::pair<uint32_t, const LockMap*>> locks;
+    locks.reserve( m_worker.GetLockMap().size() );
+    for( auto& v : m_worker.GetLockMap() )
+    {
+        if( v.second->valid ) locks.emplace_back( v.first, v.second );
+    }
+
+    const auto t0 = m_lockContention.rangeActive ? m_lockContention.rangeMin : std::numeric_limits<int64_t>::min();
+    const auto t1 = m_lockContention.rangeActive ? m_lockContention.rangeMax : std::numeric_limits<int64_t>::max();
+    m_lockContention.thread = std::thread( [this, locks = std::move( locks ), t0, t1] {
+        std::vector<LockContentionData> result;
+        result.reserve( locks.size() );
+        for( auto& lock : locks )
+        {
+            // The UI thread holds the data lock while drawing, and may wait for this thread to finish.
+            std::unique_lock<Worker::DataLock> guard( m_worker.GetDataLock(), std::defer_lock );
+            while( !guard.try_lock() )
+            {
+                if( m_lockContention.abort.load( std::memory_order_relaxed ) ) return;
+                std::this_thread::yield();
+            }
+
+            const auto& lockmap = *lock.second;
+            auto& data = result.emplace_back();
+            data.id = lock.first;
+
+            int64_t waitStart[MaxLockThreads];
+            int64_t holdStart[MaxLockThreads];
+            uint32_t holdDepth[MaxLockThreads] = {};
+            uint8_t waitOwner[MaxLockThreads];
+            int16_t waitSrcloc[MaxLockThreads];
+            for( int i=0; i<MaxLockThreads; i++ ) waitStart[i] = -1;
+
+            const auto& tl = lockmap.timeline;
+            auto it = std::lower_bound( tl.begin(), tl.end(), t0, [] ( const auto& l, const auto& r ) { return l.ptr->Time() < r; } );
+            const auto end = std::upper_bound( it, tl.end(), t1, [] ( const auto& l, const auto& r ) { return l < r.ptr->Time(); } );
+            while( it != end )
+            {
+                const auto& ev = *it->ptr;
+                const auto thread = ev.thread;
+                const auto time = ev.Time();
+                switch( ev.type )
+                {
+                case LockEvent::Type::Wait:
+                case LockEvent::Type::WaitShared:
+                    waitStart[thread] = time;
+                    waitSrcloc[thread] = ev.SrcLoc();
+                    waitOwner[thread] = it->lockCount != 0 ? it->lockingThread : thread;
+                    break;
+                case LockEvent::Type::Obtain:
+                case LockEvent::Type::ObtainShared:
+                    if( waitStart[thread] >= 0 )
+                    {
+                        const auto wait = time - waitStart[thread];
+                        waitStart[thread] = -1;
+                        data.waitCount++;
+                        data.waitTime += wait;
+                        data.waitMax = std::max( data.waitMax, wait );
+                        data.waitHist[LockHistogramBin( wait )]++;
+                        AddLockContentionSite( data.srclocs, waitSrcloc[thread], wait );
+                        if( waitOwner[thread] != thread )
+                        {
+                            AddLockContentionSite( data.edges, uint16_t( ( waitOwner[thread] << 8 ) | thread ), wait );
+                            const auto zone = FindZoneAtTime( lockmap.threadList[thread], time );
+                            if( zone && m_worker.HasZoneExtra( *zone ) && m_worker.GetZoneExtra( *zone ).callstack.Val() != 0 )
+                            {
+                                AddLockContentionSite( data.callstacks, m_worker.GetZoneExtra( *zone ).callstack.Val(), wait );
+                            }
+                        }
+                    }
+                    if( holdDepth[thread]++ == 0 ) holdStart[thread] = time;
+                    break;
+                case LockEvent::Type::Release:
+                case LockEvent::Type::ReleaseShared:
+                    if( holdDepth[thread] != 0 && --holdDepth[thread] == 0 )
+                    {
+                        const auto hold = time - holdStart[thread];
+                        data.holdCount++;
+                        data.holdTime += hold;
+                        data.holdMax = std::max( data.holdMax, hold );
+                        data.holdHist[LockHistogramBin( hold )]++;
+                    }
+                    break;
+                default:
+                    assert( false );
+                    break;
+                }
+                ++it;
+            }
+        }
+        pdqsort_branchless( result.begin(), result.end(), []( const auto& l, const auto& r ) { return l.waitTime > r.waitTime; } );
+        m_lockContention.data = std::move( result );
+        m_lockContention.done.store( true, std::memory_order_release );
+    } );
+}
+
+void View::StopLockContention()
+{
+    if( m_lockContention.thread.joinable() )
+    {
+        m_lockContention.abort.store( true, std::memory_order_relaxed );
+        m_lockContention.thread.join();
+        m_lockContention.abort.store( false, std::memory_order_relaxed );
+    }
+}
+
+void View::DrawLockHistogram( const char* id, const uint64_t* hist, uint32_t color )
+{
+    int first = 0;
+    while( first < 64 && hist[first] == 0 ) first++;
+    if( first == 64 ) return;
+    int last = 63;
+    while( hist[last] == 0 ) last--;
+    uint64_t maxVal = 0;
+    for( int i=first; i<=last; i++ ) maxVal = std::max( maxVal, hist[i] );
+
+    const auto scale = GetScale();
+    const auto ty = ImGui::GetTextLineHeight();
+    const auto barWidth = round( 12 * scale );
+    const auto height = round( ty * 4 );
+    const auto num = last - first + 1;
+    const auto wpos = ImGui::GetCursorScreenPos();
+    ImGui::InvisibleButton( id, ImVec2( barWidth * num, height ) );
+    const auto hover = ImGui::IsItemHovered();
+    auto draw = ImGui::GetWindowDrawList();
+    draw->AddRectFilled( wpos, wpos + ImVec2( barWidth * num, height ), 0x22FFFFFF );
+    for( int i=0; i<num; i++ )
+    {
+        const auto val = hist[first+i];
+        if( val == 0 ) continue;
+        const auto h = std::max( 1., round( ( height - 2 ) * log( double( val ) + 1 ) / log( double( maxVal ) + 1 ) ) );
+        draw->AddRectFilled( wpos + ImVec2( barWidth * i + 1, height - h ), wpos + ImVec2( barWidth * ( i+1 ) - 1, height ), color );
+    }
+    if( hover )
+    {
+        const auto bin = std::min<int>( num - 1, int( ( ImGui::GetIO().MousePos.x - wpos.x ) / barWidth ) );
+        const auto b = first + bin;
+        ImGui::BeginTooltip();
+        TextDisabledUnformatted( "Time range:" );
+        ImGui::SameLine();
+        if( b == 0 )
+        {
+            ImGui::TextUnformatted( "< 2 ns" );
+        }
+        else
+        {
+            ImGui::Text( "%s - %s", TimeToString( int64_t( 1 ) << b ), TimeToString( int64_t( 1 ) << ( b+1 ) ) );
+        }
+        TextFocused( "Count:", RealToString( hist[b] ) );
+        ImGui::EndTooltip();
+    }
+    ImGui::SameLine();
+    ImGui::BeginGroup();
+    TextDisabledUnformatted( first == 0 ? "0 ns" : TimeToString( int64_t( 1 ) << first ) );
+    ImGui::Dummy( ImVec2( 0, height - ty * 2 - ImGui::GetStyle().ItemSpacing.y * 2 ) );
+    TextDisabledUnformatted( TimeToString( int64_t( 1 ) << ( last+1 ) ) );
+    ImGui::EndGroup();
+}
+
+void View::DrawLockContention()
+{
+    const auto scale = GetScale();
+    ImGui::SetNextWindowSize( ImVec2( 1000 * scale, 800 * scale ), ImGuiCond_FirstUseEver );
+    ImGui::Begin( "Lock contention", &m_showLockContention );
+    if( ImGui::GetCurrentWindowRead()->SkipItems ) { ImGui::End(); return; }
+
+    if( !m_lockContention.valid ||
+        m_lockContention.rangeActive != m_lockContentionRange.active ||
+        ( m_lockContentionRange.active && ( m_lockContention.rangeMin != m_lockContentionRange.min || m_lockContention.rangeMax != m_lockContentionRange.max ) && !m_lockContentionRange.modMin && !m_lockContentionRange.modMax ) )
+    {
+        StartLockContention();
+    }
+
+    ImGui::PushStyleVar( ImGuiStyleVar_FramePadding, ImVec2( 2, 2 ) );
+    if( ImGui::Button( ICON_FA_ARROWS_ROTATE " Refresh" ) ) StartLockContention();
+    if( m_lockContention.lockCount != m_worker.GetLockMap().size() || m_worker.IsConnected() )
+    {
+        ImGui::SameLine();
+        TextDisabledUnformatted( "(data may be outdated)" );
+    }
+    ImGui::SameLine();
+    ImGui::Spacing();
+    ImGui::SameLine();
+    if( ImGui::Checkbox( "Limit range", &m_lockContentionRange.active ) )
+    {
+        if( m_lockContentionRange.active && m_lockContentionRange.min == 0 && m_lockContentionRange.max == 0 )
+        {
+            m_lockContentionRange.min = m_vd.zvStart;
+            m_lockContentionRange.max = m_vd.zvEnd;
+        }
+    }
+    if( m_lockContentionRange.active )
+    {
+        ImGui::SameLine();
+        TextColoredUnformatted( 0xFF00FFFF, ICON_FA_TRIANGLE_EXCLAMATION );
+        ImGui::SameLine();
+        ToggleButton( ICON_FA_RULER " Limits", m_showRanges );
+    }
+    ImGui::PopStyleVar();
+    ImGui::Separator();
+
+    if( !m_lockContention.done.load( std::memory_order_acquire ) )
+    {
+        ImGui::TextUnformatted( "Please wait, computing data..." );
+        DrawWaitingDots( s_time );
+        ImGui::End();
+        return;
+    }
+
+    const auto& data = m_lockContention.data;
+    if( data.empty() )
+    {
+        ImGui::TextUnformatted( "No locks to display." );
+        ImGui::End();
+        return;
+    }
+
+    const auto& lockMap = m_worker.GetLockMap();
+    auto GetLockName = [this, &lockMap] ( uint32_t id ) {
+        auto& lock = *lockMap.find( id )->second;
+        return lock.customName.Active() ? m_worker.GetString( lock.customName ) : m_worker.GetString( m_worker.GetSourceLocation( lock.srcloc ).function );
+    };
+
+    const LockContentionData* selected = nullptr;
+    ImGui::BeginChild( "##lockList", ImVec2( 0, std::min<float>( ImGui::GetTextLineHeightWithSpacing() * ( data.size() + 2 ), ImGui::GetContentRegionAvail().y * 0.4f ) ) );
+    if( ImGui::BeginTable( "##lockContention", 7, ImGuiTableFlags_Resizable | ImGuiTableFlags_ScrollY | ImGuiTableFlags_BordersInnerV | ImGuiTableFlags_Hideable | ImGuiTableFlags_Reorderable ) )
+    {
+        ImGui::TableSetupScrollFreeze( 0, 1 );
+        ImGui::TableSetupColumn( "Lock", ImGuiTableColumnFlags_NoHide );
+        ImGui::TableSetupColumn( "Wait time", ImGuiTableColumnFlags_WidthFixed );
+        ImGui::TableSetupColumn( "Waits", ImGuiTableColumnFlags_WidthFixed );
+        ImGui::TableSetupColumn( "Max wait", ImGuiTableColumnFlags_WidthFixed );
+        ImGui::TableSetupColumn( "Hold time", ImGuiTableColumnFlags_WidthFixed );
+        ImGui::TableSetupColumn( "Holds", ImGuiTableColumnFlags_WidthFixed );
+        ImGui::TableSetupColumn( "Max hold", ImGuiTableColumnFlags_WidthFixed );
+        ImGui::TableHeadersRow();
+
+        for( auto& v : data )
+        {
+            if( v.id == m_lockContention.selected ) selected = &v;
+            ImGui::PushID( v.id );
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            if( ImGui::Selectable( GetLockName( v.id ), v.id == m_lockContention.selected, ImGuiSelectableFlags_SpanAllColumns ) )
+            {
+                m_lockContention.selected = v.id;
+            }
+            ImGui::SameLine();
+            ImGui::TextDisabled( "#%" PRIu32, v.id );
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted( TimeToString( v.waitTime ) );
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted( RealToString( v.waitCount ) );
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted( TimeToString( v.waitMax ) );
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted( TimeToString( v.holdTime ) );
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted( RealToString( v.holdCount ) );
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted( TimeToString( v.holdMax ) );
+            ImGui::PopID();
+        }
+        ImGui::EndTable();
+    }
+    ImGui::EndChild();
+    ImGui::Separator();
+
+    if( !selected )
+    {
+        TextDisabledUnformatted( "Select a lock to see the details." );
+        ImGui::End();
+        return;
+    }
+
+    ImGui::BeginChild( "##lockDetails" );
+    ImGui::PushFont( m_bigFont );
+    ImGui::TextUnformatted( GetLockName( selected->id ) );
+    ImGui::PopFont();
+    ImGui::SameLine();
+    if( ImGui::SmallButton( ICON_FA_LOCK " Lock info" ) ) m_lockInfoWindow = selected->id;
+
+    TextFocused( "Wait time:", TimeToString( selected->waitTime ) );
+    if( selected->waitCount != 0 )
+    {
+        ImGui::SameLine();
+        ImGui::TextDisabled( "(mean %s)", TimeToString( selected->waitTime / int64_t( selected->waitCount ) ) );
+    }
+    DrawLockHistogram( "##waitHist", selected->waitHist, 0xFF4444DD );
+    TextFocused( "Hold time:", TimeToString( selected->holdTime ) );
+    if( selected->holdCount != 0 )
+    {
+        ImGui::SameLine();
+        ImGui::TextDisabled( "(mean %s)", TimeToString( selected->holdTime / int64_t( selected->holdCount ) ) );
+    }
+    DrawLockHistogram( "##holdHist", selected->holdHist, 0xFF44DD44 );
+    ImGui::Separator();
+
+    const auto& lock = *lockMap.find( selected->id )->second;
+    const auto expandEdges = ImGui::TreeNodeEx( "Owner " ICON_FA_RIGHT_LONG " waiter", ImGuiTreeNodeFlags_DefaultOpen );
+    ImGui::SameLine();
+    ImGui::TextDisabled( "(%zu)", selected->edges.size() );
+    if( expandEdges )
+    {
+        Vector<decltype(selected->edges.begin())> edges;
+        edges.reserve( selected->edges.size() );
+        for( auto it = selected->edges.begin(); it != selected->edges.end(); ++it ) edges.push_back( it );
+        pdqsort_branchless( edges.begin(), edges.end(), []( const auto& l, const auto& r ) { return l->second.time > r->second.time; } );
+        for( auto& e : edges )
+        {
+            const auto owner = lock.threadList[e->first >> 8];
+            const auto waiter = lock.threadList[e->first & 0xFF];
+            SmallColorBox( GetThreadColor( owner, 0 ) );
+            ImGui::SameLine();
+            ImGui::TextUnformatted( m_worker.GetThreadName( owner ) );
+            ImGui::SameLine();
+            TextDisabledUnformatted( ICON_FA_RIGHT_LONG );
+            ImGui::SameLine();
+            SmallColorBox( GetThreadColor( waiter, 0 ) );
+            ImGui::SameLine();
+            ImGui::TextUnformatted( m_worker.GetThreadName( waiter ) );
+            ImGui::SameLine();
+            ImGui::TextDisabled( "%s (%s waits)", TimeToString( e->second.time ), RealToString( e->second.count ) );
+        }
+        ImGui::TreePop();
+    }
+
+    const auto expandCallstacks = ImGui::TreeNodeEx( "Contending call stacks", ImGuiTreeNodeFlags_DefaultOpen );
+    ImGui::SameLine();
+    ImGui::TextDisabled( "(%zu)", selected->callstacks.size() );
+    if( expandCallstacks )
+    {
+        if( selected->callstacks.empty() )
+        {
+            TextDisabledUnformatted( "Call stacks are taken from zones enclosing the contended lock operations. Use zones with call stack capture to collect them." );
+        }
+        else
+        {
+            Vector<decltype(selected->callstacks.begin())> callstacks;
+            callstacks.reserve( selected->callstacks.size() );
+            for( auto it = selected->callstacks.begin(); it != selected->callstacks.end(); ++it ) callstacks.push_back( it );
+            pdqsort_branchless( callstacks.begin(), callstacks.end(), []( const auto& l, const auto& r ) { return l->second.time > r->second.time; } );
+            int idx = 0;
+            for( auto& c : callstacks )
+            {
+                SmallCallstackButton( ICON_FA_ALIGN_JUSTIFY, c->first, idx );
+                ImGui::SameLine();
+                ImGui::TextUnformatted( TimeToString( c->second.time ) );
+                ImGui::SameLine();
+                ImGui::TextDisabled( "(%s waits)", RealToString( c->second.count ) );
+                ImGui::SameLine();
+                DrawCallstackCalls( c->first, 4 );
+            }
+        }
+        ImGui::TreePop();
+    }
+
+    const auto expandSrclocs = ImGui::TreeNode( "Contending locations" );
+    ImGui::SameLine();
+    ImGui::TextDisabled( "(%zu)", selected->srclocs.size() );
+    if( expandSrclocs )
+    {
+        Vector<decltype(selected->srclocs.begin())> srclocs;
+        srclocs.reserve( selected->srclocs.size() );
+        for( auto it = selected->srclocs.begin(); it != selected->srclocs.end(); ++it ) srclocs.push_back( it );
+        pdqsort_branchless( srclocs.begin(), srclocs.end(), []( const auto& l, const auto& r ) { return l->second.time > r->second.time; } );
+        for( auto& v : srclocs )
+        {
+            const auto& srcloc = m_worker.GetSourceLocation( v->first );
+            const auto fileName = m_worker.GetString( srcloc.file );
+            ImGui::TextUnformatted( TimeToString( v->second.time ) );
+            ImGui::SameLine();
+            ImGui::TextDisabled( "(%s waits)", RealToString( v->second.count ) );
+            ImGui::SameLine();
+            ImGui::TextUnformatted( LocationToString( fileName, srcloc.line ) );
+            if( ImGui::IsItemHovered() )
+            {
+                DrawSourceTooltip( fileName, srcloc.line );
+                if( ImGui::IsItemClicked( 1 ) && SourceFileValid( fileName, m_worker.GetCaptureTime(), *this, m_worker ) )
+                {
+                    ViewSource( fileName, srcloc.line );
+                }
+            }
+        }
+        ImGui::TreePop();
+    }
+    ImGui::EndChild();
+    ImGui::End();
+}
+
 }
@@ -248,6 +248,7 @@ void View::DrawTimeline()
     m_findZone.range.StartFrame();
     m_statRange.StartFrame();
     m_waitStackRange.StartFrame();
+    m_lockContentionRange.StartFrame();
     m_memInfo.range.StartFrame();
     m_yDelta = 0;
     m_nextLockHighlight = { -1 };
@@ -277,6 +278,7 @@ void View::DrawTimeline()
         HandleRange( m_findZone.range, timespan, ImGui::GetCursorScreenPos(), w );
         HandleRange( m_statRange, timespan, ImGui::GetCursorScreenPos(), w );
         HandleRange( m_waitStackRange, timespan, ImGui::GetCursorScreenPos(), w );
+        HandleRange( m_lockContentionRange, timespan, ImGui::GetCursorScreenPos(), w );
         HandleRange( m_memInfo.range, timespan, ImGui::GetCursorScreenPos(), w );
         for( auto& v : m_annotations )
         {
@@ -488,6 +490,15 @@ void View::DrawTimeline()
         DrawLine( draw, ImVec2( dpos.x + px1, linepos.y + 0.5f ), ImVec2( dpos.x + px1, linepos.y + lineh + 0.5f ), m_waitStackRange.hiMax ? 0x99EEB588 : 0x33EEB588, m_waitStackRange.hiMax ? 2 : 1 );
     }
 
+    if( m_lockContentionRange.active && ( m_showLockContention || m_showRanges ) )
+    {
+        const auto px0 = ( m_lockContentionRange.min - m_vd.zvStart ) * pxns;
+        const auto px1 = std::max( px0 + std::max( 1.0, pxns * 0.5 ), ( m_lockContentionRange.max - m_vd.zvStart ) * pxns );
+        DrawStripedRect( draw, wpos, px0, linepos.y, px1, linepos.y + lineh, 10 * scale, 0x22D5A3EE, true, false );
+        DrawLine( draw, ImVec2( dpos.x + px0, linepos.y + 0.5f ), ImVec2( dpos.x + px0, linepos.y + lineh + 0.5f ), m_lockContentionRange.hiMin ? 0x99D5A3EE : 0x33D5A3EE, m_lockContentionRange.hiMin ? 2 : 1 );
+        DrawLine( draw, ImVec2( dpos.x + px1, linepos.y + 0.5f ), ImVec2( dpos.x + px1, linepos.y + lineh + 0.5f ), m_lockContentionRange.hiMax ? 0x99D5A3EE : 0x33D5A3EE, m_lockContentionRange.hiMax ? 2 : 1 );
+    }
+
     if( m_memInfo.range.active && ( m_memInfo.show || m_showRanges ) )
     {
         const auto px0 = ( m_memInfo.range.min - m_vd.zvStart ) * pxns;
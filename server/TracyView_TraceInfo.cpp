@@ -131,6 +131,7 @@ void View::DrawInfo()
         {
             ImGui::BeginTooltip();
             TextFocused( "Unique addresses:", RealToString( m_worker.GetHwSampleCountAddress() ) );
+            if( m_worker.HasHwSampleCounters() ) TextDisabledUnformatted( "Counter groups with multiplexing scaling" );
             ImGui::EndTooltip();
         }
         TextFocused( "Frame images:", RealToString( ficnt ) );
@@ -687,6 +688,79 @@ void View::DrawInfo()
         ImGui::TreePop();
     }
 
+#ifndef TRACY_NO_STATISTICS
+    if( m_worker.AreCallstackSamplesReady() && m_worker.GetKernelSampleCount() != 0 && ImGui::TreeNode( "Kernel samples" ) )
+    {
+        const auto kernel = m_worker.GetKernelSampleCount();
+        const auto user = m_worker.GetUserSampleCount();
+        char buf[64];
+        TextFocused( "Kernel samples:", RealToString( kernel ) );
+        ImGui::SameLine();
+        PrintStringPercent( buf, 100. * kernel / ( kernel + user ) );
+        TextDisabledUnformatted( buf );
+        TextFocused( "User samples:", RealToString( user ) );
+        ImGui::SameLine();
+        PrintStringPercent( buf, 100. * user / ( kernel + user ) );
+        TextDisabledUnformatted( buf );
+
+        const auto& entries = m_worker.GetKernelEntryStats();
+        Vector<decltype(entries.begin())> data;
+        data.reserve( entries.size() );
+        for( auto it = entries.begin(); it != entries.end(); ++it ) data.push_back( it );
+        pdqsort_branchless( data.begin(), data.end(), []( const auto& l, const auto& r ) { return l->second > r->second; } );
+
+        TextDisabledUnformatted( "Kernel samples by the user space function that entered the kernel:" );
+        if( ImGui::BeginTable( "##kernelentry", 3, ImGuiTableFlags_Resizable | ImGuiTableFlags_ScrollY | ImGuiTableFlags_BordersInnerV, ImVec2( 0, ImGui::GetTextLineHeightWithSpacing() * std::min<int64_t>( 1+data.size(), 15 ) ) ) )
+        {
+            ImGui::TableSetupScrollFreeze( 0, 1 );
+            ImGui::TableSetupColumn( "Function" );
+            ImGui::TableSetupColumn( "Image" );
+            ImGui::TableSetupColumn( "Samples", ImGuiTableColumnFlags_WidthFixed );
+            ImGui::TableHeadersRow();
+
+            const auto& symMap = m_worker.GetSymbolMap();
+            ImGuiListClipper clipper;
+            clipper.Begin( data.size() );
+            while( clipper.Step() )
+            {
+                for( auto i=clipper.DisplayStart; i<clipper.DisplayEnd; i++ )
+                {
+                    const auto symAddr = data[i]->first;
+                    ImGui::TableNextRow();
+                    ImGui::TableNextColumn();
+                    if( symAddr == 0 )
+                    {
+                        TextDisabledUnformatted( "[kernel thread]" );
+                        ImGui::TableNextColumn();
+                    }
+                    else
+                    {
+                        auto sit = symMap.find( symAddr );
+                        if( sit != symMap.end() )
+                        {
+                            ImGui::TextUnformatted( m_worker.GetString( sit->second.name ) );
+                            ImGui::TableNextColumn();
+                            ImGui::TextUnformatted( m_worker.GetString( sit->second.imageName ) );
+                        }
+                        else
+                        {
+                            ImGui::TextDisabled( "[unknown] 0x%" PRIx64, symAddr );
+                            ImGui::TableNextColumn();
+                        }
+                    }
+                    ImGui::TableNextColumn();
+                    ImGui::TextUnformatted( RealToString( data[i]->second ) );
+                    ImGui::SameLine();
+                    PrintStringPercent( buf, 100. * data[i]->second / kernel );
+                    TextDisabledUnformatted( buf );
+                }
+            }
+            ImGui::EndTable();
+        }
+        ImGui::TreePop();
+    }
+#endif
+
     auto& topology = m_worker.GetCpuTopology();
     if( !topology.empty() )
     {
@@ -714,6 +714,118 @@ void View::DrawZoneInfoWindow()
                         }
                         ImGui::TreePop();
                     }
+#ifndef TRACY_NO_STATISTICS
+                    const auto& samples = threadData->ctxSwitchSamples;
+                    const auto sit = std::lower_bound( samples.begin(), samples.end(), ev.Start(), [] ( const auto& l, const auto& r ) { return l.time.Val() < r; } );
+                    const auto send = std::lower_bound( sit, samples.end(), end, [] ( const auto& l, const auto& r ) { return l.time.Val() < r; } );
+                    if( sit != send )
+                    {
+                        const auto expand = ImGui::TreeNode( "Time waiting" );
+                        ImGui::SameLine();
+                        ImGui::TextDisabled( "(%s wait stacks)", RealToString( std::distance( sit, send ) ) );
+                        if( expand )
+                        {
+                            auto& wc = m_zoneWaitCache;
+                            const auto ctxSize = ctx ? ctx->v.size() : 0;
+                            if( wc.zone != &ev || wc.end != end )
+                            {
+                                wc.zone = &ev;
+                                wc.end = end;
+                                wc.next = std::distance( samples.begin(), sit );
+                                wc.ctxSize = ctxSize;
+                                wc.total = 0;
+                                wc.unresolved.clear();
+                                wc.waits.clear();
+                                wc.sorted.clear();
+                            }
+                            bool changed = false;
+                            auto AddSample = [this, &wc, &samples, &changed, tid, end] ( size_t idx ) {
+                                const auto t = samples[idx].time.Val();
+                                auto wait = m_worker.GetContextSwitchSampleWaitTime( tid, t );
+                                if( wait < 0 ) return false;
+                                wait = std::min( wait, end - t );
+                                wc.total += wait;
+                                auto wit = wc.waits.find( samples[idx].callstack.Val() );
+                                if( wit == wc.waits.end() )
+                                {
+                                    wc.waits.emplace( samples[idx].callstack.Val(), wait );
+                                }
+                                else
+                                {
+                                    wit->second += wait;
+                                }
+                                changed = true;
+                                return true;
+                            };
+                            if( wc.ctxSize != ctxSize )
+                            {
+                                wc.ctxSize = ctxSize;
+                                size_t keep = 0;
+                                for( auto idx : wc.unresolved )
+                                {
+                                    if( !AddSample( idx ) ) wc.unresolved[keep++] = idx;
+                                }
+                                wc.unresolved.erase( wc.unresolved.begin() + keep, wc.unresolved.end() );
+                            }
+                            const auto last = size_t( std::distance( samples.begin(), send ) );
+                            while( wc.next < last )
+                            {
+                                if( !AddSample( wc.next ) ) wc.unresolved.push_back( wc.next );
+                                wc.next++;
+                            }
+                            if( changed )
+                            {
+                                wc.sorted.clear();
+                                wc.sorted.reserve( wc.waits.size() );
+                                for( auto& v : wc.waits ) wc.sorted.push_back( std::make_pair( v.first, v.second ) );
+                                pdqsort_branchless( wc.sorted.begin(), wc.sorted.end(), []( const auto& l, const auto& r ) { return l.second > r.second; } );
+                            }
+                            const auto waitTotal = wc.total;
+                            const auto& data = wc.sorted;
+
+                            TextFocused( "Time waiting:", TimeToString( waitTotal ) );
+                            if( ztime != 0 )
+                            {
+                                char buf[64];
+                                PrintStringPercent( buf, 100.f * waitTotal / ztime );
+                                ImGui::SameLine();
+                                TextDisabledUnformatted( buf );
+                            }
+                            if( ImGui::BeginTable( "##waitstacks", 3, ImGuiTableFlags_Resizable | ImGuiTableFlags_ScrollY | ImGuiTableFlags_BordersInnerV, ImVec2( 0, ImGui::GetTextLineHeightWithSpacing() * std::min<int64_t>( 1+data.size(), 15 ) ) ) )
+                            {
+                                ImGui::TableSetupScrollFreeze( 0, 1 );
+                                ImGui::TableSetupColumn( "Time", ImGuiTableColumnFlags_WidthFixed );
+                                ImGui::TableSetupColumn( "Share", ImGuiTableColumnFlags_WidthFixed );
+                                ImGui::TableSetupColumn( "Wait stack" );
+                                ImGui::TableHeadersRow();
+
+                                int idx = 0;
+                                ImGuiListClipper clipper;
+                                clipper.Begin( data.size() );
+                                while( clipper.Step() )
+                                {
+                                    for( auto i=clipper.DisplayStart; i<clipper.DisplayEnd; i++ )
+                                    {
+                                        const auto cs = data[i].first;
+                                        ImGui::TableNextRow();
+                                        ImGui::TableNextColumn();
+                                        ImGui::TextUnformatted( TimeToString( data[i].second ) );
+                                        ImGui::TableNextColumn();
+                                        char buf[64];
+                                        PrintStringPercent( buf, waitTotal == 0 ? 0.f : 100.f * data[i].second / waitTotal );
+                                        TextDisabledUnformatted( buf );
+                                        ImGui::TableNextColumn();
+                                        SmallCallstackButton( ICON_FA_ALIGN_JUSTIFY, cs, idx );
+                                        ImGui::SameLine();
+                                        DrawCallstackCalls( cs, 4 );
+                                    }
+                                }
+                                ImGui::EndTable();
+                            }
+                            ImGui::TreePop();
+                        }
+                    }
+#endif
                 }
             }
         }
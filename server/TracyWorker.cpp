@@ -12,6 +12,7 @@
 
 #include <cctype>
 #include <chrono>
+#include <deque>
 #include <math.h>
 #include <string.h>
 
@@ -60,6 +61,241 @@ static bool SourceFileValid( const char* fn, uint64_t olderThan )
 
 static const uint8_t FileHeader[8] { 't', 'r', 'a', 'c', 'y', Version::Major, Version::Minor, Version::Patch };
 enum { FileHeaderMagic = 5 };
+// Sections which can be excluded from loading by the event mask. The positions of these sections are stored in a
+// section index at the end of the file, so that a seekable file can be positioned past them without decompressing
+// their data, and so that they can be dropped from a file without parsing the rest of it.
+enum class FileSection
+{
+    Locks,
+    Plots,
+    Memory,
+    FrameImages,
+    ContextSwitches,
+    ContextSwitchesPerCpu,
+    SymbolCode,
+    SourceCache,
+    NUM_SECTIONS
+};
+
+// The section index is stored as a section count followed by the section end positions and, since 0.10.5, the
+// section start positions. It is terminated with the position at which it starts.
+static bool ReadSectionIndex( FileRead& f, uint64_t* sectionEnd, uint64_t* sectionStart = nullptr )
+{
+    const auto pos = f.GetPosition();
+    f.Seek( f.GetSize() - sizeof( uint64_t ) );
+    uint64_t indexPos;
+    f.Read( indexPos );
+    f.Seek( indexPos );
+    uint32_t cnt;
+    f.Read( cnt );
+    const auto valid = cnt == (uint32_t)FileSection::NUM_SECTIONS;
+    if( valid )
+    {
+        f.Read( sectionEnd, cnt * sizeof( uint64_t ) );
+        if( sectionStart ) f.Read( sectionStart, cnt * sizeof( uint64_t ) );
+    }
+    f.Seek( pos );
+    return valid;
+}
+
+// The analysis cache consists of the header, the timeline entries (thread timelines, zone children, GPU thread
+// timelines and GPU zone children) and the page aligned zone and GPU zone arrays. Events reference their
+// children by index, so the arrays can be used in place, wherever they are mapped.
+static const uint8_t AnalysisCacheMagic[4] { 't', 'Z', 'c', 1 };
+enum { AnalysisCacheAlign = 4096 };
+
+struct AnalysisCacheHeader
+{
+    uint8_t magic[4];
+    uint32_t zoneEventSize;
+    uint32_t gpuEventSize;
+    uint32_t padding;
+    uint64_t traceSize;
+    int64_t traceTime;
+    uint64_t traceHash;
+    uint64_t threads;
+    uint64_t zoneChildren;
+    uint64_t gpuThreads;
+    uint64_t gpuChildren;
+    uint64_t zoneData;
+    uint64_t zoneCount;
+    uint64_t gpuData;
+    uint64_t gpuCount;
+};
+
+struct AnalysisCacheEntry
+{
+    uint64_t offset;    // index of the first event in the event array
+    uint64_t size;
+    uint64_t end;       // trace position past the timeline, thread timelines only
+};
+
+// The modification time has a coarse resolution, so the end of the file, which changes with every save, is hashed
+// as well.
+static bool GetFileFingerprint( const char* fn, uint64_t& size, int64_t& time, uint64_t& hash )
+{
+    struct stat64 buf;
+    if( stat64( fn, &buf ) != 0 ) return false;
+    size = buf.st_size;
+    time = buf.st_mtime;
+
+    FILE* f = fopen( fn, "rb" );
+    if( !f ) return false;
+    char tail[4096];
+    const auto tsz = std::min<uint64_t>( size, sizeof( tail ) );
+    const auto ok = fseek( f, -long( tsz ), SEEK_END ) == 0 && fread( tail, 1, tsz, f ) == tsz;
+    fclose( f );
+    hash = XXH3_64bits( tail, tsz );
+    return ok;
+}
+
+template<typename T>
+static void MapTimeline( Vector<short_ptr<T>>& _vec, T* data, const AnalysisCacheEntry& entry )
+{
+    auto& vec = *(Vector<T>*)( &_vec );
+    vec.set_magic();
+    vec.set_external( data + entry.offset, entry.size );
+}
+// Raw event stream recorded during capture, to be replayed into a trace later.
+static const uint8_t StreamHeader[8] { 't', 'r', 'S', 't', 'r', 'e', 'a', 'm' };
+// Stream records are prefixed with their size. A flight recording also has records which restore the delta
+// time state of the client, and records of events of which only the query side effects are to be replayed.
+// Padding records fill the rest of a file block at checkpoints.
+enum : uint32_t
+{
+    StreamEventRecord = 0,
+    StreamPaddingRecord = 0x40000000,
+    StreamLightRecord = 0x80000000,
+    StreamStateRecord = 0xFFFFFFFF
+};
+
+struct Worker::StreamState
+{
+    uint64_t threadCtx;
+    int64_t refTimeThread;
+    int64_t refTimeSerial;
+    int64_t refTimeCtx;
+    int64_t refTimeGpu;
+};
+
+// The flight recorder keeps the received frames in chunks of about a second. Chunks which fall out of the
+// window are dropped, except for the events which have to be known to make sense of the window: query
+// responses, frame marks, GPU zones, and so on. These are collected in the dictionary. The dictionary parts
+// of dropped chunks are kept LZ4 compressed. All of it counts towards the size limit, so a dictionary which
+// outgrows the limit shrinks the window down to the most recent chunk.
+struct Worker::FlightRecorderData
+{
+    struct Chunk
+    {
+        int64_t start;
+        std::vector<char> frames;
+        std::vector<char> dictionary;
+    };
+
+    struct DictionaryBlock
+    {
+        std::unique_ptr<char[]> data;
+        uint32_t size;
+        uint32_t rawSize;
+    };
+
+    FlightRecorder config;
+    std::vector<char> header;
+    std::vector<DictionaryBlock> dictionary;
+    std::deque<Chunk> chunks;
+    size_t size = 0;
+
+    std::vector<char> tail;     // responses received after the recording was frozen
+
+    std::vector<char> payload;
+    bool payloadQueried = false;
+    bool dirty = true;
+    size_t openRecord = 0;
+    uint32_t openKind = StreamStateRecord;
+    std::atomic<bool> frozen { false };
+    bool stopped = false;
+};
+
+enum class StreamEventKind
+{
+    Payload,
+    Window,
+    Context,
+    Dictionary
+};
+
+// Window events must have a light handler in Worker::ProcessStreamed(). Frame marks and GPU zones have one
+// too, but they are kept in the dictionary, as the frame numbers and GPU queries of the window depend on them.
+static StreamEventKind GetStreamEventKind( QueueType type )
+{
+    switch( type )
+    {
+    case QueueType::SingleStringData:
+    case QueueType::SecondStringData:
+    case QueueType::MemNamePayload:
+    case QueueType::SourceLocationPayload:
+    case QueueType::CallstackPayload:
+    case QueueType::CallstackAllocPayload:
+    case QueueType::CallstackSerial:
+    case QueueType::Callstack:
+    case QueueType::CallstackAlloc:
+    case QueueType::FrameImageData:
+        return StreamEventKind::Payload;
+    case QueueType::ZoneBegin:
+    case QueueType::ZoneBeginCallstack:
+    case QueueType::ZoneBeginAllocSrcLoc:
+    case QueueType::ZoneBeginAllocSrcLocCallstack:
+    case QueueType::ZoneEnd:
+    case QueueType::ZoneValidation:
+    case QueueType::ZoneText:
+    case QueueType::ZoneName:
+    case QueueType::ZoneColor:
+    case QueueType::ZoneValue:
+    case QueueType::Message:
+    case QueueType::MessageColor:
+    case QueueType::MessageCallstack:
+    case QueueType::MessageColorCallstack:
+    case QueueType::MessageLiteral:
+    case QueueType::MessageLiteralColor:
+    case QueueType::MessageLiteralCallstack:
+    case QueueType::MessageLiteralColorCallstack:
+    case QueueType::LockWait:
+    case QueueType::LockObtain:
+    case QueueType::LockRelease:
+    case QueueType::LockSharedWait:
+    case QueueType::LockSharedObtain:
+    case QueueType::LockSharedRelease:
+    case QueueType::LockMark:
+    case QueueType::PlotDataInt:
+    case QueueType::PlotDataFloat:
+    case QueueType::PlotDataDouble:
+    case QueueType::MemAlloc:
+    case QueueType::MemAllocNamed:
+    case QueueType::MemAllocCallstack:
+    case QueueType::MemAllocCallstackNamed:
+    case QueueType::MemFree:
+    case QueueType::MemFreeNamed:
+    case QueueType::MemFreeCallstack:
+    case QueueType::MemFreeCallstackNamed:
+    case QueueType::FrameImage:
+    case QueueType::CallstackSample:
+    case QueueType::CallstackSampleContextSwitch:
+    case QueueType::ContextSwitch:
+    case QueueType::ThreadWakeup:
+    case QueueType::HwSampleCpuCycle:
+    case QueueType::HwSampleInstructionRetired:
+    case QueueType::HwSampleCacheReference:
+    case QueueType::HwSampleCacheMiss:
+    case QueueType::HwSampleBranchRetired:
+    case QueueType::HwSampleBranchMiss:
+    case QueueType::HwSampleGroup:
+        return StreamEventKind::Window;
+    case QueueType::ThreadContext:
+        return StreamEventKind::Context;
+    default:
+        return StreamEventKind::Dictionary;
+    }
+}
 static const int CurrentVersion = FileVersion( Version::Major, Version::Minor, Version::Patch );
 static const int MinSupportedVersion = FileVersion( 0, 9, 0 );
 
@@ -220,6 +456,254 @@ static tracy_force_inline void WriteTimeOffset( FileWrite& f, int64_t& refTime,
     f.Write( &timeOffset, sizeof( timeOffset ) );
 }
 
+// Timelines are stored as separate columns of variable length integers, one for each event field. Times are
+// stored as the differences from the preceding event, and the column contents are similar enough to compress well.
+enum { ZoneColumnSrcLoc, ZoneColumnStart, ZoneColumnDuration, ZoneColumnExtra, ZoneColumnChildren, ZoneColumnCount };
+enum { GpuColumnCpuStart, GpuColumnGpuStart, GpuColumnCpuDuration, GpuColumnGpuDuration, GpuColumnSrcLoc, GpuColumnCallstack, GpuColumnThread, GpuColumnChildren, GpuColumnCount };
+
+// The columns of a timeline have to be written one after another. They are encoded in memory, unless the timeline
+// is too big, in which case only the column sizes are counted, and each column is then written straight to the file
+// by another pass over the timeline, see TimelineColumnStream.
+template<int N>
+class TimelineColumnWrite
+{
+public:
+    enum { BufferLimit = 16 * 1024 * 1024 };
+
+    TimelineColumnWrite()
+    {
+        clear();
+    }
+
+    tracy_force_inline void Write( int column, uint64_t val )
+    {
+        uint8_t buf[10];
+        int sz = 0;
+        while( val >= 0x80 )
+        {
+            buf[sz++] = uint8_t( val ) | 0x80;
+            val >>= 7;
+        }
+        buf[sz++] = uint8_t( val );
+        m_size[column] += sz;
+        if( !m_buffered ) return;
+        m_column[column].insert( m_column[column].end(), buf, buf + sz );
+        m_total += sz;
+        if( m_total > BufferLimit )
+        {
+            m_buffered = false;
+            for( auto& v : m_column ) std::vector<uint8_t>().swap( v );
+        }
+    }
+
+    tracy_force_inline void WriteSigned( int column, int64_t val )
+    {
+        Write( column, ( uint64_t( val ) << 1 ) ^ uint64_t( val >> 63 ) );
+    }
+
+    uint64_t size() const
+    {
+        uint64_t sz = N * sizeof( uint64_t );
+        for( auto& v : m_size ) sz += v;
+        return sz;
+    }
+
+    bool IsBuffered() const { return m_buffered; }
+
+    void clear()
+    {
+        for( auto& v : m_column ) v.clear();
+        for( auto& v : m_size ) v = 0;
+        m_total = 0;
+        m_buffered = true;
+    }
+
+    // Writes the column sizes, followed by the columns, if they are buffered.
+    void WriteTo( FileWrite& f ) const
+    {
+        f.Write( m_size, sizeof( m_size ) );
+        if( m_buffered ) for( auto& v : m_column ) f.Write( v.data(), v.size() );
+    }
+
+private:
+    std::vector<uint8_t> m_column[N];
+    uint64_t m_size[N];
+    uint64_t m_total;
+    bool m_buffered;
+};
+
+template<int N>
+class TimelineColumnStream
+{
+public:
+    TimelineColumnStream( FileWrite& f, int column )
+        : m_file( f )
+        , m_column( column )
+    {
+    }
+
+    tracy_force_inline void Write( int column, uint64_t val )
+    {
+        if( column != m_column ) return;
+        uint8_t buf[10];
+        int sz = 0;
+        while( val >= 0x80 )
+        {
+            buf[sz++] = uint8_t( val ) | 0x80;
+            val >>= 7;
+        }
+        buf[sz++] = uint8_t( val );
+        m_file.Write( buf, sz );
+    }
+
+    tracy_force_inline void WriteSigned( int column, int64_t val )
+    {
+        Write( column, ( uint64_t( val ) << 1 ) ^ uint64_t( val >> 63 ) );
+    }
+
+private:
+    FileWrite& m_file;
+    int m_column;
+};
+
+// Timeline data comes straight from the file, so the columns are checked not to extend past the data, and the
+// events and child vectors they describe not to exceed the space reserved for them.
+template<int N>
+class TimelineColumnRead
+{
+public:
+    TimelineColumnRead( const char* data, uint64_t size, char* events, uint64_t eventsSize, int32_t childEnd )
+        : m_events( events )
+        , m_eventsEnd( events + eventsSize )
+        , m_childEnd( childEnd )
+    {
+        if( size < N * sizeof( uint64_t ) ) throw LoadFailure( "Invalid timeline data." );
+        auto ptr = (const uint8_t*)data + N * sizeof( uint64_t );
+        auto left = size - N * sizeof( uint64_t );
+        for( int i=0; i<N; i++ )
+        {
+            uint64_t sz;
+            memcpy( &sz, data + i * sizeof( uint64_t ), sizeof( sz ) );
+            if( sz > left ) throw LoadFailure( "Invalid timeline data." );
+            m_column[i] = ptr;
+            ptr += sz;
+            left -= sz;
+            m_end[i] = ptr;
+        }
+    }
+
+    tracy_force_inline uint64_t Read( int column )
+    {
+        auto& ptr = m_column[column];
+        const auto end = m_end[column];
+        uint64_t val = 0;
+        int shift = 0;
+        uint8_t byte;
+        do
+        {
+            if( ptr == end || shift > 63 ) throw LoadFailure( "Invalid timeline data." );
+            byte = *ptr++;
+            val |= uint64_t( byte & 0x7F ) << shift;
+            shift += 7;
+        }
+        while( byte & 0x80 );
+        return val;
+    }
+
+    tracy_force_inline int64_t ReadSigned( int column )
+    {
+        const auto val = Read( column );
+        return int64_t( val >> 1 ) ^ -int64_t( val & 1 );
+    }
+
+    template<class T>
+    tracy_force_inline T* Alloc( size_t cnt )
+    {
+        if( cnt > size_t( m_eventsEnd - m_events ) / sizeof( T ) ) throw LoadFailure( "Invalid timeline data." );
+        auto ret = (T*)m_events;
+        m_events += sizeof( T ) * cnt;
+        return ret;
+    }
+
+    tracy_force_inline void CheckChild( int32_t idx ) const
+    {
+        if( idx >= m_childEnd ) throw LoadFailure( "Invalid timeline data." );
+    }
+
+private:
+    const uint8_t* m_column[N];
+    const uint8_t* m_end[N];
+    char* m_events;
+    char* m_eventsEnd;
+    int32_t m_childEnd;
+};
+
+// Timelines of 0.10.3 traces are stored as rows of event fields. When they are decoded in parallel, their events
+// are placed in memory allocated up front for the whole timeline. As with the columns, reads are checked against
+// the size of the data, and the events and child vectors against the space reserved for them.
+class TimelineRead
+{
+public:
+    TimelineRead( const char* data, uint64_t size, char* events, uint64_t eventsSize, int32_t childEnd )
+        : m_ptr( data )
+        , m_end( data + size )
+        , m_events( events )
+        , m_eventsEnd( events + eventsSize )
+        , m_childEnd( childEnd )
+    {
+    }
+
+    template<class T>
+    tracy_force_inline void Read( T& v )
+    {
+        if( size_t( m_end - m_ptr ) < sizeof( T ) ) throw LoadFailure( "Invalid timeline data." );
+        memcpy( &v, m_ptr, sizeof( T ) );
+        m_ptr += sizeof( T );
+    }
+
+    template<class T, class U>
+    tracy_force_inline void Read2( T& v0, U& v1 ) { Read( v0 ); Read( v1 ); }
+    template<class T, class U, class V, class W>
+    tracy_force_inline void Read4( T& v0, U& v1, V& v2, W& v3 ) { Read( v0 ); Read( v1 ); Read( v2 ); Read( v3 ); }
+    template<class T, class U, class V, class W, class X>
+    tracy_force_inline void Read5( T& v0, U& v1, V& v2, W& v3, X& v4 ) { Read( v0 ); Read( v1 ); Read( v2 ); Read( v3 ); Read( v4 ); }
+    template<class T, class U, class V, class W, class X, class Y>
+    tracy_force_inline void Read6( T& v0, U& v1, V& v2, W& v3, X& v4, Y& v5 ) { Read( v0 ); Read( v1 ); Read( v2 ); Read( v3 ); Read( v4 ); Read( v5 ); }
+
+    template<class T>
+    tracy_force_inline T* Alloc( size_t cnt )
+    {
+        if( cnt > size_t( m_eventsEnd - m_events ) / sizeof( T ) ) throw LoadFailure( "Invalid timeline data." );
+        auto ret = (T*)m_events;
+        m_events += sizeof( T ) * cnt;
+        return ret;
+    }
+
+    tracy_force_inline void CheckChild( int32_t idx ) const
+    {
+        if( idx >= m_childEnd ) throw LoadFailure( "Invalid timeline data." );
+    }
+
+private:
+    const char* m_ptr;
+    const char* m_end;
+    char* m_events;
+    char* m_eventsEnd;
+    int32_t m_childEnd;
+};
+
+template<typename T, size_t U>
+static tracy_force_inline T* AllocTimeline( FileRead& f, Slab<U>& slab, size_t cnt )
+{
+    return (T*)slab.AllocBig( sizeof( T ) * cnt );
+}
+
+template<typename T, size_t U>
+static tracy_force_inline T* AllocTimeline( TimelineRead& f, Slab<U>& slab, size_t cnt )
+{
+    return f.Alloc<T>( cnt );
+}
+
 static tracy_force_inline int64_t ReadTimeOffset( FileRead& f, int64_t& refTime )
 {
     int64_t timeOffset;
@@ -235,6 +719,24 @@ static tracy_force_inline void UpdateLockRange( LockMap& lockmap, const LockEven
     if( range.end < lt ) range.end = lt;
 }
 
+#ifndef TRACY_NO_STATISTICS
+// Off-CPU time following a context switch sample. The sample is taken when the thread is switched
+// out (or, on some platforms, when it is switched back in), so the wait is the gap between the two
+// neighboring running regions. Returns -1 if the thread was not scheduled back yet.
+static int64_t GetSampleWaitTime( const ContextSwitch* ctx, int64_t time )
+{
+    auto& v = ctx->v;
+    auto it = std::lower_bound( v.begin(), v.end(), time, [] ( const auto& l, const auto& r ) { return (uint64_t)l.End() < (uint64_t)r; } );
+    if( it == v.end() || it->Reason() == ContextSwitchData::Wakeup ) return -1;
+    if( it->Start() > time ) return it->Start() - time;
+    if( it->Start() == time ) return it == v.begin() ? 0 : time - (it-1)->End();
+    if( !it->IsEndValid() ) return -1;
+    const auto end = it->End();
+    if( ++it == v.end() || it->Reason() == ContextSwitchData::Wakeup ) return -1;
+    return it->Start() - end;
+}
+#endif
+
 template<size_t U>
 static uint64_t ReadHwSampleVec( FileRead& f, SortedVector<Int48, Int48Sort>& vec, Slab<U>& slab )
 {
@@ -260,13 +762,16 @@ static bool IsQueryPrio( ServerQuery type )
 
 LoadProgress Worker::s_loadProgress;
 
-Worker::Worker( const char* addr, uint16_t port )
+// A stream journal is written in addition to the regular processing of the events, to be checkpointed during the capture.
+Worker::Worker( const char* addr, uint16_t port, int netBufferDepth, FileWrite* streamOut, const FlightRecorder* recorder, bool streamJournal )
     : m_addr( addr )
     , m_port( port )
     , m_hasData( false )
     , m_stream( LZ4_createStreamDecode() )
-    , m_buffer( new char[TargetFrameSize*3 + 1] )
+    , m_buffer( nullptr )
     , m_bufferOffset( 0 )
+    , m_streamOut( streamOut )
+    , m_processStreamed( ( streamOut && !streamJournal ) || recorder )
     , m_inconsistentSamples( false )
     , m_pendingStrings( 0 )
     , m_pendingThreads( 0 )
@@ -279,6 +784,29 @@ Worker::Worker( const char* addr, uint16_t port )
     , m_callstackFrameStaging( nullptr )
     , m_traceVersion( CurrentVersion )
     , m_loadTime( 0 )
+{
+    InitCaptureData();
+
+    m_netRingDepth = std::max( netBufferDepth, 1 );
+    m_netRingSize = m_netRingDepth + 1;
+    m_netRing.reset( new NetBuffer[m_netRingSize] );
+    // Frames are decompressed back to back, starting over at the beginning when the next frame might
+    // not fit at the end. Sized after LZ4's decoder ring buffer this works regardless of the client's
+    // buffer layout and leaves room for all the frames still waiting to be processed.
+    m_netBufferSize = m_netRingDepth * TargetFrameSize + LZ4_DECODER_RING_BUFFER_SIZE( TargetFrameSize );
+    m_buffer = new char[m_netBufferSize];
+
+    if( recorder )
+    {
+        m_recorder = std::make_unique<FlightRecorderData>();
+        m_recorder->config = *recorder;
+    }
+
+    m_thread = std::thread( [this] { SetThreadName( "Tracy Worker" ); Exec(); } );
+    m_threadNet = std::thread( [this] { SetThreadName( "Tracy Network" ); Network(); } );
+}
+
+void Worker::InitCaptureData()
 {
     m_data.sourceLocationExpand.push_back( 0 );
     m_data.localThreadCompress.InitZero();
@@ -298,12 +826,9 @@ Worker::Worker( const char* addr, uint16_t port )
     m_data.ctxUsageReady = true;
     m_data.symbolSamplesReady = true;
 #endif
-
-    m_thread = std::thread( [this] { SetThreadName( "Tracy Worker" ); Exec(); } );
-    m_threadNet = std::thread( [this] { SetThreadName( "Tracy Network" ); Network(); } );
 }
 
-Worker::Worker( const char* name, const char* program, const std::vector<ImportEventTimeline>& timeline, const std::vector<ImportEventMessages>& messages, const std::vector<ImportEventPlots>& plots, const std::unordered_map<uint64_t, std::string>& threadNames )
+Worker::Worker( const char* name, const char* program )
     : m_hasData( true )
     , m_delay( 0 )
     , m_resolution( 0 )
@@ -326,8 +851,12 @@ Worker::Worker( const char* name, const char* program, const std::vector<ImportE
     m_data.symbolLocInline.push_back( std::numeric_limits<uint64_t>::max() );
     m_data.memory = m_slab.AllocInit<MemData>();
     m_data.memNameMap.emplace( 0, m_data.memory );
-
     m_data.lastTime = 0;
+}
+
+Worker::Worker( const char* name, const char* program, const std::vector<ImportEventTimeline>& timeline, const std::vector<ImportEventMessages>& messages, const std::vector<ImportEventPlots>& plots, const std::unordered_map<uint64_t, std::string>& threadNames )
+    : Worker( name, program )
+{
     if( !timeline.empty() )
     {
         m_data.lastTime = timeline.back().timestamp;
@@ -355,31 +884,7 @@ Worker::Worker( const char* name, const char* program, const std::vector<ImportE
                 v.locLine,
                 0
             }};
-            int key;
-            auto it = m_data.sourceLocationPayloadMap.find( &srcloc );
-            if( it == m_data.sourceLocationPayloadMap.end() )
-            {
-                auto slptr = m_slab.Alloc<SourceLocation>();
-                memcpy( slptr, &srcloc, sizeof( srcloc ) );
-                uint32_t idx = m_data.sourceLocationPayload.size();
-                m_data.sourceLocationPayloadMap.emplace( slptr, idx );
-                m_data.sourceLocationPayload.push_back( slptr );
-                key = -int16_t( idx + 1 );
-#ifndef TRACY_NO_STATISTICS
-                auto res = m_data.sourceLocationZones.emplace( key, SourceLocationZones() );
-                m_data.srclocZonesLast.first = key;
-                m_data.srclocZonesLast.second = &res.first->second;
-
-#else
-                auto res = m_data.sourceLocationZonesCnt.emplace( key, 0 );
-                m_data.srclocCntLast.first = key;
-                m_data.srclocCntLast.second = &res.first->second;
-#endif
-            }
-            else
-            {
-                key = -int16_t( it->second + 1 );
-            }
+            const auto key = GetImportSourceLocation( srcloc );
 
             auto zone = AllocZoneEvent();
             zone->SetStartSrcLoc( v.timestamp, key );
@@ -401,23 +906,7 @@ Worker::Worker( const char* name, const char* program, const std::vector<ImportE
         }
         else
         {
-            auto td = NoticeThread( v.tid );
-            if( td->zoneIdStack.empty() ) continue;
-            td->zoneIdStack.pop_back();
-            auto& stack = td->stack;
-            auto zone = stack.back_and_pop();
-            td->DecStackCount( zone->SrcLoc() );
-            zone->SetEnd( v.timestamp );
-
-#ifndef TRACY_NO_STATISTICS
-            ZoneThreadData ztd;
-            ztd.SetZone( zone );
-            ztd.SetThread( CompressThread( v.tid ) );
-            auto slz = GetSourceLocationZones( zone->SrcLoc() );
-            slz->zones.push_back( ztd );
-#else
-            CountZoneStatistics( zone );
-#endif
+            EndImportedZone( v.tid, v.timestamp );
         }
     }
 
@@ -536,42 +1025,273 @@ Worker::Worker( const char* name, const char* program, const std::vector<ImportE
     }
 
     // Add a default frame if we didn't have any framesets
-    if( frameNames.empty() )
-    {
-        m_data.framesBase = m_data.frames.Retrieve( 0, [this] ( uint64_t name ) {
-            auto fd = m_slab.AllocInit<FrameData>();
-            fd->name = name;
-            fd->continuous = 1;
-            return fd;
-        }, [this] ( uint64_t name ) {
-            assert( name == 0 );
-            char tmp[6] = "Frame";
-            HandleFrameName( name, tmp, 5 );
-        } );
+    if( frameNames.empty() ) AddEmptyFramesBase();
+}
 
-        m_data.framesBase->frames.push_back( FrameEvent{ 0, -1, -1 } );
-        m_data.framesBase->frames.push_back( FrameEvent{ 0, -1, -1 } );
-    }
+void Worker::AddEmptyFramesBase()
+{
+    m_data.framesBase = m_data.frames.Retrieve( 0, [this] ( uint64_t name ) {
+        auto fd = m_slab.AllocInit<FrameData>();
+        fd->name = name;
+        fd->continuous = 1;
+        return fd;
+    }, [this] ( uint64_t name ) {
+        assert( name == 0 );
+        char tmp[6] = "Frame";
+        HandleFrameName( name, tmp, 5 );
+    } );
+
+    m_data.framesBase->frames.push_back( FrameEvent{ 0, -1, -1 } );
+    m_data.framesBase->frames.push_back( FrameEvent{ 0, -1, -1 } );
 }
 
-Worker::Worker( FileRead& f, EventType::Type eventMask, bool bgTasks, bool allowStringModification)
-    : m_hasData( true )
-    , m_stream( nullptr )
-    , m_buffer( nullptr )
-    , m_inconsistentSamples( false )
-    , m_allowStringModification(allowStringModification)
+int16_t Worker::GetImportSourceLocation( const SourceLocation& srcloc )
 {
-    auto loadStart = std::chrono::high_resolution_clock::now();
+    auto it = m_data.sourceLocationPayloadMap.find( &srcloc );
+    if( it != m_data.sourceLocationPayloadMap.end() ) return -int16_t( it->second + 1 );
+
+    auto slptr = m_slab.Alloc<SourceLocation>();
+    memcpy( slptr, &srcloc, sizeof( srcloc ) );
+    uint32_t idx = m_data.sourceLocationPayload.size();
+    m_data.sourceLocationPayloadMap.emplace( slptr, idx );
+    m_data.sourceLocationPayload.push_back( slptr );
+    const auto key = -int16_t( idx + 1 );
+#ifndef TRACY_NO_STATISTICS
+    auto res = m_data.sourceLocationZones.emplace( key, SourceLocationZones() );
+    m_data.srclocZonesLast.first = key;
+    m_data.srclocZonesLast.second = &res.first->second;
+#else
+    auto res = m_data.sourceLocationZonesCnt.emplace( key, 0 );
+    m_data.srclocCntLast.first = key;
+    m_data.srclocCntLast.second = &res.first->second;
+#endif
+    return key;
+}
 
-    int fileVer = 0;
+void Worker::EndImportedZone( uint64_t tid, int64_t time )
+{
+    auto td = NoticeThread( tid );
+    if( td->zoneIdStack.empty() ) return;
+    td->zoneIdStack.pop_back();
+    auto& stack = td->stack;
+    auto zone = stack.back_and_pop();
+    td->DecStackCount( zone->SrcLoc() );
+    zone->SetEnd( time );
 
-    uint8_t hdr[8];
-    f.Read( hdr, sizeof( hdr ) );
-    if( memcmp( FileHeader, hdr, FileHeaderMagic ) == 0 )
-    {
-        fileVer = FileVersion( hdr[FileHeaderMagic], hdr[FileHeaderMagic+1], hdr[FileHeaderMagic+2] );
-        if( fileVer > CurrentVersion )
-        {
+#ifndef TRACY_NO_STATISTICS
+    ZoneThreadData ztd;
+    ztd.SetZone( zone );
+    ztd.SetThread( CompressThread( tid ) );
+    auto slz = GetSourceLocationZones( zone->SrcLoc() );
+    slz->zones.push_back( ztd );
+#else
+    CountZoneStatistics( zone );
+#endif
+}
+
+struct Worker::MergeState
+{
+    int64_t offset;
+    unordered_flat_map<int16_t, int16_t> srcloc;
+};
+
+void Worker::Merge( Worker& src, int64_t offset, const char* prefix )
+{
+    if( m_mergeCount == 0 )
+    {
+        m_captureTime = src.GetCaptureTime();
+        m_resolution = src.GetResolution();
+        m_delay = src.GetDelay();
+    }
+    // Each merged trace gets its own range of thread identifiers, as processes may reuse them.
+    const uint64_t tidBase = uint64_t( ++m_mergeCount ) << 32;
+
+    const auto lastTime = src.GetLastTime() + offset;
+    if( m_data.lastTime < lastTime ) m_data.lastTime = lastTime;
+
+    MergeState state { offset };
+    for( auto& td : src.GetThreadData() )
+    {
+        if( td->timeline.empty() ) continue;
+        const auto tid = tidBase | ( td->id & 0xFFFFFFFF );
+        m_threadCtx = tid;
+        m_threadCtxData = NoticeThread( tid );
+        MergeTimeline( src, td->timeline, state );
+    }
+
+    for( auto& v : src.GetMessages() )
+    {
+        const auto tid = tidBase | ( src.DecompressThread( v->thread ) & 0xFFFFFFFF );
+        const auto text = src.GetString( v->ref );
+
+        auto msg = m_slab.Alloc<MessageData>();
+        msg->time = v->time + offset;
+        msg->ref = StringRef( StringRef::Type::Idx, StoreString( text, strlen( text ) ).idx );
+        msg->thread = CompressThread( tid );
+        msg->color = v->color;
+        msg->callstack.SetVal( 0 );
+
+        if( m_threadCtx != tid )
+        {
+            m_threadCtx = tid;
+            m_threadCtxData = nullptr;
+        }
+        InsertMessageData( msg );
+    }
+
+    // The default frame set can't be named, so it stays empty. The frames of each input, including the first
+    // one, go to frame sets named after the program.
+    if( !m_data.framesBase ) AddEmptyFramesBase();
+
+    char buf[1024];
+    for( auto& v : src.GetFrames() )
+    {
+        const uint64_t key = m_data.frames.Data().size() + 1;
+        const auto len = std::min<int>( snprintf( buf, sizeof( buf ), "%s: %s", prefix, v->name == 0 ? "Frame" : src.GetString( v->name ) ), sizeof( buf ) - 1 );
+        auto fd = m_data.frames.Retrieve( key, [&] ( uint64_t name ) {
+            auto fd = m_slab.AllocInit<FrameData>();
+            fd->name = name;
+            fd->continuous = v->continuous;
+            return fd;
+        }, [&] ( uint64_t name ) {
+            HandleFrameName( name, buf, len );
+        } );
+
+        fd->frames.reserve( fd->frames.size() + v->frames.size() );
+        for( auto& f : v->frames )
+        {
+            fd->frames.push_back( FrameEvent{ f.start + offset, f.end >= 0 ? f.end + offset : -1, -1 } );
+        }
+    }
+
+    for( auto& v : src.GetPlots() )
+    {
+        if( v->type != PlotType::User ) continue;
+
+        const auto len = std::min<int>( snprintf( buf, sizeof( buf ), "%s: %s", prefix, src.GetString( v->name ) ), sizeof( buf ) - 1 );
+        const auto sl = StoreString( buf, len );
+        m_data.strings.emplace( (uint64_t)sl.ptr, sl.ptr );
+
+        auto plot = m_slab.AllocInit<PlotData>();
+        plot->name = (uint64_t)sl.ptr;
+        plot->type = PlotType::User;
+        plot->format = v->format;
+        plot->showSteps = v->showSteps;
+        plot->fill = v->fill;
+        plot->color = v->color;
+        plot->min = v->min;
+        plot->max = v->max;
+        plot->sum = v->sum;
+
+        plot->data.reserve_exact( v->data.size(), m_slab );
+        for( size_t i=0; i<v->data.size(); i++ )
+        {
+            plot->data[i].time.SetVal( v->data[i].time.Val() + offset );
+            plot->data[i].val = v->data[i].val;
+        }
+
+        m_data.plots.Data().push_back( plot );
+    }
+
+    for( auto& td : src.GetThreadData() )
+    {
+        const auto tid = tidBase | ( td->id & 0xFFFFFFFF );
+        if( m_threadMap.find( tid ) == m_threadMap.end() ) continue;
+        const auto len = std::min<int>( snprintf( buf, sizeof( buf ), "%s: %s", prefix, src.GetThreadName( td->id ) ), sizeof( buf ) - 1 );
+        AddThreadString( tid, buf, len );
+    }
+}
+
+void Worker::MergeTimeline( Worker& src, const Vector<short_ptr<ZoneEvent>>& vec, MergeState& state )
+{
+    if( vec.is_magic() )
+    {
+        MergeTimelineImpl<VectorAdapterDirect<ZoneEvent>>( src, *(Vector<ZoneEvent>*)( &vec ), state );
+    }
+    else
+    {
+        MergeTimelineImpl<VectorAdapterPointer<ZoneEvent>>( src, vec, state );
+    }
+}
+
+template<typename Adapter, typename V>
+void Worker::MergeTimelineImpl( Worker& src, const V& vec, MergeState& state )
+{
+    Adapter a;
+    for( auto& val : vec )
+    {
+        auto& v = a(val);
+        auto it = state.srcloc.find( v.SrcLoc() );
+        if( it == state.srcloc.end() )
+        {
+            auto& sl = src.GetSourceLocation( v.SrcLoc() );
+            const auto function = src.GetString( sl.function );
+            const auto file = src.GetString( sl.file );
+            StringRef name;
+            if( sl.name.active )
+            {
+                const auto str = src.GetString( sl.name );
+                name = StringRef( StringRef::Idx, StoreString( str, strlen( str ) ).idx );
+            }
+            SourceLocation srcloc {{
+                name,
+                StringRef( StringRef::Idx, StoreString( function, strlen( function ) ).idx ),
+                StringRef( StringRef::Idx, StoreString( file, strlen( file ) ).idx ),
+                sl.line,
+                sl.color
+            }};
+            it = state.srcloc.emplace( v.SrcLoc(), GetImportSourceLocation( srcloc ) ).first;
+        }
+
+        auto zone = AllocZoneEvent();
+        zone->SetStartSrcLoc( v.Start() + state.offset, it->second );
+        zone->SetEnd( -1 );
+        zone->SetChild( -1 );
+
+        if( src.HasZoneExtra( v ) )
+        {
+            auto& se = src.GetZoneExtra( v );
+            if( se.text.Active() || se.name.Active() || se.color.Val() != 0 )
+            {
+                auto& extra = RequestZoneExtra( *zone );
+                if( se.text.Active() )
+                {
+                    const auto str = src.GetString( se.text );
+                    extra.text = StringIdx( StoreString( str, strlen( str ) ).idx );
+                }
+                if( se.name.Active() )
+                {
+                    const auto str = src.GetString( se.name );
+                    extra.name = StringIdx( StoreString( str, strlen( str ) ).idx );
+                }
+                extra.color = se.color;
+            }
+        }
+
+        NewZone( zone );
+        if( v.HasChildren() ) MergeTimeline( src, src.GetZoneChildren( v.Child() ), state );
+        EndImportedZone( m_threadCtx, src.GetZoneEnd( v ) + state.offset );
+    }
+}
+
+Worker::Worker( FileRead& f, EventType::Type eventMask, bool bgTasks, bool allowStringModification, ReplayProfile* replayProfile )
+    : m_hasData( true )
+    , m_stream( nullptr )
+    , m_buffer( nullptr )
+    , m_inconsistentSamples( false )
+    , m_allowStringModification(allowStringModification)
+{
+    auto loadStart = std::chrono::high_resolution_clock::now();
+
+    int fileVer = 0;
+
+    uint8_t hdr[8];
+    f.Read( hdr, sizeof( hdr ) );
+    if( memcmp( FileHeader, hdr, FileHeaderMagic ) == 0 )
+    {
+        fileVer = FileVersion( hdr[FileHeaderMagic], hdr[FileHeaderMagic+1], hdr[FileHeaderMagic+2] );
+        if( fileVer > CurrentVersion )
+        {
             throw UnsupportedVersion( fileVer );
         }
         if( fileVer < MinSupportedVersion )
@@ -581,12 +1301,26 @@ Worker::Worker( FileRead& f, EventType::Type eventMask, bool bgTasks, bool allow
 
         f.Read( m_delay );
     }
+    else if( memcmp( StreamHeader, hdr, sizeof( hdr ) ) == 0 )
+    {
+        ReplayStream( f, replayProfile );
+        m_loadTime = std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::high_resolution_clock::now() - loadStart ).count();
+        return;
+    }
     else
     {
         throw LegacyVersion( FileVersion( 0, 2, 0 ) );
     }
     m_traceVersion = fileVer;
 
+    if( f.IsSeekable() && GetFileFingerprint( f.GetFilename().c_str(), m_timelineSource.size, m_timelineSource.time, m_timelineSource.hash ) )
+    {
+        m_timelineSource.file = f.GetFilename();
+    }
+
+    uint64_t sectionEnd[(int)FileSection::NUM_SECTIONS];
+    const auto sectionIndex = fileVer >= FileVersion( 0, 10, 2 ) && f.IsSeekable() && eventMask != EventType::All && ReadSectionIndex( f, sectionEnd );
+
     s_loadProgress.total.store( 11, std::memory_order_relaxed );
     s_loadProgress.subTotal.store( 0, std::memory_order_relaxed );
     s_loadProgress.progress.store( LoadProgress::Initialization, std::memory_order_relaxed );
@@ -922,6 +1656,10 @@ Worker::Worker( FileRead& f, EventType::Type eventMask, bool bgTasks, bool allow
             m_data.lockMap.emplace( id, lockmapPtr );
         }
     }
+    else if( sectionIndex )
+    {
+        f.Seek( sectionEnd[(int)FileSection::Locks] );
+    }
     else
     {
         for( uint64_t i=0; i<sz; i++ )
@@ -974,9 +1712,73 @@ Worker::Worker( FileRead& f, EventType::Type eventMask, bool bgTasks, bool allow
     f.Read( sz );
     m_data.zoneChildren.reserve_exact( sz, m_slab );
     memset( (char*)m_data.zoneChildren.data(), 0, sizeof( Vector<short_ptr<ZoneEvent>> ) * sz );
+    const auto childCount = sz;
     int32_t childIdx = 0;
     f.Read( sz );
     m_data.threads.reserve_exact( sz, m_slab );
+
+    auto cache = (const AnalysisCacheHeader*)MapAnalysisCache();
+    if( cache && ( cache->threads != sz || cache->zoneChildren != childCount ) )
+    {
+        munmap( m_cacheMap, m_cacheMapSize );
+        m_cacheMap = nullptr;
+        cache = nullptr;
+    }
+    const AnalysisCacheEntry* cacheEntry = nullptr;
+    ZoneEvent* cacheZones = nullptr;
+    if( cache )
+    {
+        cacheEntry = (const AnalysisCacheEntry*)( cache + 1 );
+        cacheZones = (ZoneEvent*)( m_cacheMap + cache->zoneData );
+        for( uint64_t i=0; i<childCount; i++ )
+        {
+            MapTimeline( m_data.zoneChildren[i], cacheZones, cacheEntry[sz+i] );
+        }
+    }
+
+    // Each timeline is stored with its encoded size and the number of events and child vectors it contains,
+    // so the timelines can be copied out of the file and decoded on worker threads into preallocated memory.
+    struct GpuTimelineLoad
+    {
+        GpuCtxData* ctx;
+        uint64_t thread;
+        std::unique_ptr<Vector<short_ptr<GpuEvent>>> timeline;
+    };
+    std::vector<GpuTimelineLoad> gpuTimelines;
+    const bool columns = fileVer >= FileVersion( 0, 10, 4 );
+    uint64_t fileSize = std::numeric_limits<uint64_t>::max();
+    // The failure flag is referenced by the decoding tasks, so it has to outlive the dispatch. If loading
+    // throws, the dispatch is destroyed first, which waits for the running tasks and drops the queued ones.
+    std::atomic<bool> timelineFailed { false };
+    std::unique_ptr<TaskDispatch> timelineDispatch;
+    if( !cache && fileVer >= FileVersion( 0, 10, 3 ) )
+    {
+        if( f.IsSeekable() ) fileSize = f.GetSize();
+        const auto cores = std::thread::hardware_concurrency();
+        if( cores > 1 ) timelineDispatch = std::make_unique<TaskDispatch>( cores - 1, "Tracy Timeline" );
+    }
+    // Timeline data copied out of the file waits in memory until it is decoded. When too much of it piles up,
+    // the reading stops until the queued timelines are done.
+    enum { TimelineQueueLimit = 64 * 1024 * 1024 };
+    uint64_t timelineQueued = 0;
+    auto QueueTimeline = [&timelineDispatch, &timelineQueued] ( std::function<void(void)>&& decode, uint64_t bytes ) {
+        if( !timelineDispatch )
+        {
+            decode();
+            return;
+        }
+        timelineDispatch->Queue( std::move( decode ) );
+        timelineQueued += bytes;
+        if( timelineQueued > TimelineQueueLimit )
+        {
+            timelineDispatch->Sync();
+            timelineQueued = 0;
+        }
+    };
+#ifdef TRACY_NO_STATISTICS
+    std::vector<std::pair<ZoneEvent*, uint64_t>> timelineZones;
+#endif
+
     for( uint64_t i=0; i<sz; i++ )
     {
         auto td = m_slab.AllocInit<ThreadData>();
@@ -984,12 +1786,62 @@ Worker::Worker( FileRead& f, EventType::Type eventMask, bool bgTasks, bool allow
         f.Read4( tid, td->count, td->kernelSampleCnt, td->isFiber );
         td->id = tid;
         m_data.zonesCnt += td->count;
+        uint64_t tbytes = 0, tzones = 0;
+        uint32_t tchildren = 0;
+        if( fileVer >= FileVersion( 0, 10, 3 ) )
+        {
+            f.Read3( tbytes, tzones, tchildren );
+        }
         uint32_t tsz;
         f.Read( tsz );
         if( tsz != 0 )
         {
-            ReadTimeline( f, td->timeline, tsz, 0, childIdx );
+            if( cache )
+            {
+                if( cacheEntry[i].size != tsz ) throw LoadFailure( "Analysis cache doesn't match the trace." );
+                MapTimeline( td->timeline, cacheZones, cacheEntry[i] );
+                f.Seek( cacheEntry[i].end );
+            }
+            else if( timelineDispatch || columns )
+            {
+                // Every event takes at least one byte of the encoded data.
+                if( tbytes > fileSize - f.GetPosition() || tzones > tbytes || tzones < tsz ) throw LoadFailure( "Invalid timeline size." );
+                auto data = std::shared_ptr<char[]>( new char[tbytes] );
+                f.Read( data.get(), tbytes );
+                auto zones = (ZoneEvent*)m_slab.AllocBig( sizeof( ZoneEvent ) * tzones );
+                const auto idx = childIdx;
+                childIdx += tchildren;
+                if( childIdx > (int32_t)childCount ) throw LoadFailure( "Invalid timeline size." );
+                QueueTimeline( [this, td, data, tbytes, zones, tzones, tsz, idx, tchildren, columns, &timelineFailed] {
+                    int32_t childIdx = idx;
+                    try
+                    {
+                        if( columns )
+                        {
+                            TimelineColumnRead<ZoneColumnCount> tr( data.get(), tbytes, (char*)zones, sizeof( ZoneEvent ) * tzones, idx + tchildren );
+                            ReadTimelineColumns( tr, td->timeline, tsz, 0, childIdx );
+                        }
+                        else
+                        {
+                            TimelineRead tr( data.get(), tbytes, (char*)zones, sizeof( ZoneEvent ) * tzones, idx + tchildren );
+                            ReadTimeline( tr, td->timeline, tsz, 0, childIdx );
+                        }
+                    }
+                    catch( const LoadFailure& )
+                    {
+                        timelineFailed.store( true, std::memory_order_relaxed );
+                    }
+                }, tbytes );
+#ifdef TRACY_NO_STATISTICS
+                timelineZones.emplace_back( zones, tzones );
+#endif
+            }
+            else
+            {
+                ReadTimeline( f, td->timeline, tsz, 0, childIdx );
+            }
         }
+        if( !m_timelineSource.file.empty() ) m_timelineSource.threadEnd.push_back( f.GetPosition() );
         uint64_t msz;
         f.Read( msz );
         if( eventMask & EventType::Messages )
@@ -1054,6 +1906,12 @@ Worker::Worker( FileRead& f, EventType::Type eventMask, bool bgTasks, bool allow
         m_data.threads[i] = td;
         m_threadMap.emplace( tid, td );
     }
+#ifdef TRACY_NO_STATISTICS
+    if( cache )
+    {
+        for( uint64_t i=0; i<cache->zoneCount; i++ ) CountZoneStatistics( cacheZones + i );
+    }
+#endif
 
     s_loadProgress.progress.store( LoadProgress::GpuZones, std::memory_order_relaxed );
     f.Read( sz );
@@ -1062,7 +1920,20 @@ Worker::Worker( FileRead& f, EventType::Type eventMask, bool bgTasks, bool allow
     f.Read( sz );
     m_data.gpuChildren.reserve_exact( sz, m_slab );
     memset( (char*)m_data.gpuChildren.data(), 0, sizeof( Vector<short_ptr<GpuEvent>> ) * sz );
+    const auto gpuChildCount = sz;
     childIdx = 0;
+    GpuEvent* cacheGpu = nullptr;
+    uint64_t cacheGpuIdx = 0;
+    if( cache )
+    {
+        if( cache->gpuChildren != sz ) throw LoadFailure( "Analysis cache doesn't match the trace." );
+        cacheEntry += cache->threads + cache->zoneChildren;
+        cacheGpu = (GpuEvent*)( m_cacheMap + cache->gpuData );
+        for( uint64_t i=0; i<sz; i++ )
+        {
+            MapTimeline( m_data.gpuChildren[i], cacheGpu, cacheEntry[cache->gpuThreads+i] );
+        }
+    }
     f.Read( sz );
     m_data.gpuData.reserve_exact( sz, m_slab );
     for( uint64_t i=0; i<sz; i++ )
@@ -1078,18 +1949,89 @@ Worker::Worker( FileRead& f, EventType::Type eventMask, bool bgTasks, bool allow
         for( uint64_t j=0; j<tdsz; j++ )
         {
             uint64_t tid, tsz;
-            f.Read2( tid, tsz );
+            f.Read( tid );
+            uint64_t tbytes = 0, tzones = 0;
+            uint32_t tchildren = 0;
+            if( fileVer >= FileVersion( 0, 10, 3 ) )
+            {
+                f.Read3( tbytes, tzones, tchildren );
+            }
+            f.Read( tsz );
             if( tsz != 0 )
             {
                 int64_t refTime = 0;
                 int64_t refGpuTime = 0;
                 auto td = ctx->threadData.emplace( tid, GpuCtxThreadData {} ).first;
-                ReadTimeline( f, td->second.timeline, tsz, refTime, refGpuTime, childIdx );
+                if( cache )
+                {
+                    if( cacheGpuIdx >= cache->gpuThreads || cacheEntry[cacheGpuIdx].size != tsz ) throw LoadFailure( "Analysis cache doesn't match the trace." );
+                    MapTimeline( td->second.timeline, cacheGpu, cacheEntry[cacheGpuIdx] );
+                    f.Seek( cacheEntry[cacheGpuIdx].end );
+                }
+                else if( timelineDispatch || columns )
+                {
+                    // Map entries may move while further threads are inserted, the timeline is decoded to a stable
+                    // location and moved to its entry once all tasks are done.
+                    if( tbytes > fileSize - f.GetPosition() || tzones > tbytes || tzones < tsz ) throw LoadFailure( "Invalid timeline size." );
+                    auto data = std::shared_ptr<char[]>( new char[tbytes] );
+                    f.Read( data.get(), tbytes );
+                    auto zones = (GpuEvent*)m_slab.AllocBig( sizeof( GpuEvent ) * tzones );
+                    const auto idx = childIdx;
+                    childIdx += tchildren;
+                    if( childIdx > (int32_t)gpuChildCount ) throw LoadFailure( "Invalid timeline size." );
+                    gpuTimelines.emplace_back( GpuTimelineLoad { ctx, tid, std::make_unique<Vector<short_ptr<GpuEvent>>>() } );
+                    auto vec = gpuTimelines.back().timeline.get();
+                    QueueTimeline( [this, vec, data, tbytes, zones, tzones, tsz, idx, tchildren, columns, &timelineFailed] {
+                        int32_t childIdx = idx;
+                        try
+                        {
+                            if( columns )
+                            {
+                                TimelineColumnRead<GpuColumnCount> tr( data.get(), tbytes, (char*)zones, sizeof( GpuEvent ) * tzones, idx + tchildren );
+                                ReadTimelineColumns( tr, *vec, tsz, 0, 0, childIdx );
+                            }
+                            else
+                            {
+                                TimelineRead tr( data.get(), tbytes, (char*)zones, sizeof( GpuEvent ) * tzones, idx + tchildren );
+                                int64_t refTime = 0;
+                                int64_t refGpuTime = 0;
+                                ReadTimeline( tr, *vec, tsz, refTime, refGpuTime, childIdx );
+                            }
+                        }
+                        catch( const LoadFailure& )
+                        {
+                            timelineFailed.store( true, std::memory_order_relaxed );
+                        }
+                    }, tbytes );
+                }
+                else
+                {
+                    ReadTimeline( f, td->second.timeline, tsz, refTime, refGpuTime, childIdx );
+                }
             }
+            if( !m_timelineSource.file.empty() ) m_timelineSource.gpu.push_back( { uint32_t( i ), tid, f.GetPosition() } );
+            cacheGpuIdx++;
         }
         m_data.gpuData[i] = ctx;
     }
 
+    if( timelineDispatch )
+    {
+        timelineDispatch->Sync();
+        timelineDispatch.reset();
+    }
+    if( timelineFailed.load( std::memory_order_relaxed ) ) throw LoadFailure( "Invalid timeline data." );
+    for( auto& v : gpuTimelines )
+    {
+        v.ctx->threadData.find( v.thread )->second.timeline = std::move( *v.timeline );
+    }
+#ifdef TRACY_NO_STATISTICS
+    for( auto& v : timelineZones )
+    {
+        for( uint64_t i=0; i<v.second; i++ ) CountZoneStatistics( v.first + i );
+    }
+#endif
+
     s_loadProgress.progress.store( LoadProgress::Plots, std::memory_order_relaxed );
     f.Read( sz );
     if( eventMask & EventType::Plots )
@@ -1116,6 +2058,10 @@ Worker::Worker( FileRead& f, EventType::Type eventMask, bool bgTasks, bool allow
             m_data.plots.Data().push_back_no_space_check( pd );
         }
     }
+    else if( sectionIndex )
+    {
+        f.Seek( sectionEnd[(int)FileSection::Plots] );
+    }
     else
     {
         for( uint64_t i=0; i<sz; i++ )
@@ -1133,6 +2079,11 @@ Worker::Worker( FileRead& f, EventType::Type eventMask, bool bgTasks, bool allow
     uint64_t memcount, memtarget, memload = 0;
     f.Read2( memcount, memtarget );
     s_loadProgress.subTotal.store( memtarget, std::memory_order_relaxed );
+    if( sectionIndex && !( eventMask & EventType::Memory ) )
+    {
+        f.Seek( sectionEnd[(int)FileSection::Memory] );
+        memcount = 0;
+    }
 
     for( uint64_t k=0; k<memcount; k++ )
     {
@@ -1362,6 +2313,14 @@ Worker::Worker( FileRead& f, EventType::Type eventMask, bool bgTasks, bool allow
 
         ZSTD_freeCDict( cdict );
     }
+    else if( sectionIndex )
+    {
+        f.Seek( sectionEnd[(int)FileSection::FrameImages] );
+        for( auto& v : m_data.framesBase->frames )
+        {
+            v.frameImage = -1;
+        }
+    }
     else
     {
         uint32_t dsz;
@@ -1421,6 +2380,10 @@ Worker::Worker( FileRead& f, EventType::Type eventMask, bool bgTasks, bool allow
             m_data.ctxSwitch.emplace( thread, data );
         }
     }
+    else if( sectionIndex )
+    {
+        f.Seek( sectionEnd[(int)FileSection::ContextSwitches] );
+    }
     else
     {
         f.Read( sz );
@@ -1467,6 +2430,10 @@ Worker::Worker( FileRead& f, EventType::Type eventMask, bool bgTasks, bool allow
             s_loadProgress.subProgress.store( cnt, std::memory_order_relaxed );
         }
     }
+    else if( sectionIndex )
+    {
+        f.Seek( sectionEnd[(int)FileSection::ContextSwitchesPerCpu] );
+    }
     else
     {
         for( int i=0; i<256; i++ )
@@ -1544,6 +2511,10 @@ Worker::Worker( FileRead& f, EventType::Type eventMask, bool bgTasks, bool allow
         }
         m_data.symbolCodeSize = ssz;
     }
+    else if( sectionIndex )
+    {
+        f.Seek( sectionEnd[(int)FileSection::SymbolCode] );
+    }
     else
     {
         for( uint64_t i=0; i<sz; i++ )
@@ -1564,6 +2535,12 @@ Worker::Worker( FileRead& f, EventType::Type eventMask, bool bgTasks, bool allow
         m_data.codeSymbolMap.emplace( v1, v2 );
     }
 
+    if( fileVer >= FileVersion( 0, 10, 1 ) )
+    {
+        uint8_t flag;
+        f.Read( flag );
+        m_data.hasHwSampleCounters = flag;
+    }
     f.Read( sz );
     m_data.hwSamples.reserve( sz );
     for( uint64_t i=0; i<sz; i++ )
@@ -1577,6 +2554,7 @@ Worker::Worker( FileRead& f, EventType::Type eventMask, bool bgTasks, bool allow
         ReadHwSampleVec( f, data.cacheMiss, m_slab );
         if( ReadHwSampleVec( f, data.branchRetired, m_slab ) != 0 ) m_data.hasBranchRetirement = true;
         ReadHwSampleVec( f, data.branchMiss, m_slab );
+        if( m_data.hasHwSampleCounters ) f.Read( &data.counters, sizeof( HwSampleCounters ) );
     }
 
     f.Read( sz );
@@ -1596,6 +2574,10 @@ Worker::Worker( FileRead& f, EventType::Type eventMask, bool bgTasks, bool allow
             m_data.sourceFileCache.emplace( key, MemoryBlock { data, len } );
         }
     }
+    else if( sectionIndex )
+    {
+        f.Seek( sectionEnd[(int)FileSection::SourceCache] );
+    }
     else
     {
         for( uint64_t i=0; i<sz; i++ )
@@ -1608,6 +2590,14 @@ Worker::Worker( FileRead& f, EventType::Type eventMask, bool bgTasks, bool allow
         }
     }
 
+#ifndef TRACY_NO_STATISTICS
+    for( auto& td : m_data.threads )
+    {
+        if( !td->ctxSwitchSamples.empty() ) QueueThreadWaitTime( *td );
+    }
+    UpdateThreadWaitTimes();
+#endif
+
     s_loadProgress.total.store( 0, std::memory_order_relaxed );
     m_loadTime = std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::high_resolution_clock::now() - loadStart ).count();
 
@@ -1661,7 +2651,7 @@ Worker::Worker( FileRead& f, EventType::Type eventMask, bool bgTasks, bool allow
                         ProcessTimeline( countMap, t->timeline, m_data.localThreadCompress.DecompressMustRaw( t->id ) );
                     }
                 }
-                std::lock_guard<std::mutex> lock( m_data.lock );
+                std::lock_guard<DataLock> lock( m_data.lock );
                 m_data.sourceLocationZonesReady = true;
             } ) );
 
@@ -1693,7 +2683,7 @@ Worker::Worker( FileRead& f, EventType::Type eventMask, bool bgTasks, bool allow
                         }
                     }
                 }
-                std::lock_guard<std::mutex> lock( m_data.lock );
+                std::lock_guard<DataLock> lock( m_data.lock );
                 m_data.gpuSourceLocationZonesReady = true;
             } ) );
 
@@ -1760,7 +2750,7 @@ Worker::Worker( FileRead& f, EventType::Type eventMask, bool bgTasks, bool allow
                         }
                         for( auto& v : counts ) UpdateSampleStatistics( v.first, v.second, false );
                     }
-                    std::lock_guard<std::mutex> lock( m_data.lock );
+                    std::lock_guard<DataLock> lock( m_data.lock );
                     m_data.callstackSamplesReady = true;
                 } ) );
 
@@ -1788,7 +2778,7 @@ Worker::Worker( FileRead& f, EventType::Type eventMask, bool bgTasks, bool allow
                             }
                         }
                     }
-                    std::lock_guard<std::mutex> lock( m_data.lock );
+                    std::lock_guard<DataLock> lock( m_data.lock );
                     m_data.ghostZonesReady = true;
                     m_data.ghostCnt = gcnt;
                 } ) );
@@ -1842,7 +2832,7 @@ Worker::Worker( FileRead& f, EventType::Type eventMask, bool bgTasks, bool allow
                     {
                         pdqsort_branchless( v.second.begin(), v.second.end(), []( const auto& lhs, const auto& rhs ) { return lhs.time.Val() < rhs.time.Val(); } );
                     }
-                    std::lock_guard<std::mutex> lock( m_data.lock );
+                    std::lock_guard<DataLock> lock( m_data.lock );
                     m_data.symbolSamplesReady = true;
                 } ) );
             }
@@ -1856,41 +2846,234 @@ Worker::Worker( FileRead& f, EventType::Type eventMask, bool bgTasks, bool allow
     }
 }
 
-Worker::~Worker()
+// Builds the trace from an event stream recorded by a capture with stream output. The events are processed
+// exactly as they were received, only without a client to talk to, as all the query responses are already
+// a part of the stream. If a profile is given, the time spent in handlers of each event type is measured.
+void Worker::ReplayStream( FileRead& f, ReplayProfile* profile )
 {
-    Shutdown();
-
-    if( m_threadNet.joinable() ) m_threadNet.join();
-    if( m_thread.joinable() ) m_thread.join();
-    if( m_threadBackground.joinable() ) m_threadBackground.join();
-
-    delete[] m_buffer;
-    LZ4_freeStreamDecode( (LZ4_streamDecode_t*)m_stream );
+    uint32_t protocolVersion;
+    f.Read( protocolVersion );
+    if( protocolVersion != ProtocolVersion ) throw LoadFailure( "Event stream was recorded with a different protocol version." );
 
-    delete[] m_frameImageBuffer;
-    delete[] m_tmpBuf;
+    m_traceVersion = CurrentVersion;
+    m_pendingStrings = 0;
+    m_pendingThreads = 0;
+    m_pendingFibers = 0;
+    m_pendingExternalNames = 0;
+    m_pendingSourceLocation = 0;
+    m_pendingCallstackFrames = 0;
+    m_pendingCallstackSubframes = 0;
+    m_pendingSymbolCode = 0;
+    m_callstackFrameStaging = nullptr;
+    m_serverQuerySpaceBase = m_serverQuerySpaceLeft = 0;
+    InitCaptureData();
 
-    for( auto& v : m_data.threads )
+    WelcomeMessage welcome;
+    f.Read( &welcome, sizeof( welcome ) );
+    ProcessWelcome( welcome );
+    if( m_onDemand )
     {
-        v->timeline.~Vector();
-        v->stack.~Vector();
-        v->messages.~Vector();
-        v->zoneIdStack.~Vector();
-        v->samples.~Vector();
-#ifndef TRACY_NO_STATISTICS
-        v->childTimeStack.~Vector();
-        v->ghostZones.~Vector();
-#endif
+        OnDemandPayloadMessage onDemand;
+        f.Read( &onDemand, sizeof( onDemand ) );
+        ProcessOnDemandPayload( onDemand );
     }
-    for( auto& v : m_data.gpuData )
+
+    // Streams which are still being recorded, or which were not closed, end without the end of stream marker,
+    // possibly in the middle of a record. Such streams are replayed up to the last complete record.
+    const auto size = f.IsSeekable() ? f.GetSize() : std::numeric_limits<uint64_t>::max();
+    auto buf = std::unique_ptr<char[]>( new char[TargetFrameSize] );
+    for(;;)
     {
-        for( auto& vt : v->threadData )
+        uint32_t sz;
+        if( f.GetPosition() + sizeof( sz ) > size ) break;
+        f.Read( sz );
+        if( sz == 0 ) break;
+        if( sz == StreamStateRecord )
+        {
+            // Flight recordings start in the middle of the capture, so there are zones, locks and memory
+            // allocations which have no beginning in the stream.
+            StreamState state;
+            f.Read( &state, sizeof( state ) );
+            m_windowReplay = true;
+            m_ignoreMemFreeFaults = true;
+            m_ignoreFrameEndFaults = true;
+            if( m_threadCtx != state.threadCtx )
+            {
+                m_threadCtx = state.threadCtx;
+                m_threadCtxData = RetrieveThread( state.threadCtx );
+            }
+            m_refTimeThread = state.refTimeThread;
+            m_refTimeSerial = state.refTimeSerial;
+            m_refTimeCtx = state.refTimeCtx;
+            m_refTimeGpu = state.refTimeGpu;
+            continue;
+        }
+        if( sz & StreamPaddingRecord )
+        {
+            sz &= ~StreamPaddingRecord;
+            if( f.GetPosition() + sz > size ) break;
+            f.Skip( sz );
+            continue;
+        }
+        const auto light = ( sz & StreamLightRecord ) != 0;
+        sz &= ~StreamLightRecord;
+        if( sz > TargetFrameSize ) throw LoadFailure( "Event stream is corrupted." );
+        if( f.GetPosition() + sz > size ) break;
+        f.Read( buf.get(), sz );
+
+        // Light records hold events which are only replayed for the queries they have issued.
+        const auto zonesCnt = m_data.zonesCnt;
+        m_processStreamed = light;
+        const char* ptr = buf.get();
+        const char* end = ptr + sz;
+        while( ptr < end )
         {
-            vt.second.timeline.~Vector();
-            vt.second.stack.~Vector();
+            auto ev = (const QueueItem*)ptr;
+            if( profile )
+            {
+                // The leaf zone path consumes several events at once, which are all accounted to zone begin.
+                const auto type = ev->hdr.idx;
+                const auto cnt = m_eventCount;
+                const auto t0 = std::chrono::high_resolution_clock::now();
+                const auto ok = DispatchProcess( *ev, ptr, end );
+                const auto t1 = std::chrono::high_resolution_clock::now();
+                profile->count[type] += m_eventCount - cnt + 1;
+                profile->time[type] += std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count();
+                if( !ok ) ReplayFailure();
+            }
+            else if( !DispatchProcess( *ev, ptr, end ) ) ReplayFailure();
+            m_eventCount++;
+        }
+        if( profile && profile->peakMemory < memUsage ) profile->peakMemory = memUsage;
+        if( light )
+        {
+            m_processStreamed = false;
+            m_data.zonesCnt = zonesCnt;
         }
     }
-    for( auto& v : m_data.plots.Data() )
+}
+
+// Instrumentation errors found during the replay of a stream are reported the same way as when they
+// happen in a live capture, only there is no view to show them in.
+void Worker::ReplayFailure()
+{
+    std::string msg = "Event stream replay failed: ";
+    msg += GetFailureString( m_failure );
+    if( m_failureData.srcloc != 0 )
+    {
+        const auto& srcloc = GetSourceLocation( m_failureData.srcloc );
+        msg += "\nFunction: ";
+        msg += GetString( srcloc.function );
+        msg += "\nLocation: ";
+        msg += GetString( srcloc.file );
+        msg += ':';
+        msg += std::to_string( srcloc.line );
+    }
+    if( m_failureData.thread != 0 )
+    {
+        msg += "\nThread: ";
+        msg += GetThreadName( m_failureData.thread );
+        msg += " (";
+        msg += std::to_string( m_failureData.thread );
+        msg += ')';
+    }
+    if( !m_failureData.message.empty() )
+    {
+        msg += "\nContext: ";
+        msg += m_failureData.message;
+    }
+    throw LoadFailure( msg.c_str() );
+}
+
+// Stores the recorded event stream in the file, so that everything received up to now survives a crash of the
+// server. Only the data recorded since the previous checkpoint has to be written.
+void Worker::WriteCheckpoint()
+{
+    auto space = m_streamOut->GetBlockSpace();
+    if( space != 0 && space != FileBlockSize )
+    {
+        if( space < sizeof( uint32_t ) ) space += FileBlockSize;
+        uint32_t pad = space - sizeof( uint32_t );
+        const uint32_t record = StreamPaddingRecord | pad;
+        m_streamOut->Write( &record, sizeof( record ) );
+        static const char zero[64*1024] = {};
+        while( pad > 0 )
+        {
+            const auto sz = std::min<uint32_t>( pad, sizeof( zero ) );
+            m_streamOut->Write( zero, sz );
+            pad -= sz;
+        }
+    }
+    m_streamOut->Sync();
+    m_checkpointTime.store( time( nullptr ), std::memory_order_relaxed );
+}
+
+// Writes the events kept by the flight recorder as an event stream. The capture must be finished.
+void Worker::WriteFlightRecording( FileWrite& f )
+{
+    assert( m_recorder && !IsConnected() );
+    auto& rec = *m_recorder;
+    f.Write( rec.header.data(), rec.header.size() );
+    std::vector<char> buf;
+    for( auto& block : rec.dictionary )
+    {
+        buf.resize( block.rawSize );
+        const auto sz = LZ4_decompress_safe( block.data.get(), buf.data(), block.size, block.rawSize );
+        assert( sz == int( block.rawSize ) );
+        f.Write( buf.data(), block.rawSize );
+    }
+    for( auto& chunk : rec.chunks ) f.Write( chunk.frames.data(), chunk.frames.size() );
+    if( !rec.tail.empty() ) f.Write( rec.tail.data(), rec.tail.size() );
+    const uint32_t endOfStream = 0;
+    f.Write( &endOfStream, sizeof( endOfStream ) );
+}
+
+void Worker::FreezeFlightRecording()
+{
+    assert( m_recorder );
+    m_recorder->frozen.store( true, std::memory_order_relaxed );
+}
+
+bool Worker::IsFlightRecordingFrozen() const
+{
+    return m_recorder && m_recorder->frozen.load( std::memory_order_relaxed );
+}
+
+Worker::~Worker()
+{
+    Shutdown();
+
+    if( m_threadNet.joinable() ) m_threadNet.join();
+    if( m_thread.joinable() ) m_thread.join();
+    if( m_threadBackground.joinable() ) m_threadBackground.join();
+
+    delete[] m_buffer;
+    LZ4_freeStreamDecode( (LZ4_streamDecode_t*)m_stream );
+
+    delete[] m_frameImageBuffer;
+    delete[] m_tmpBuf;
+
+    for( auto& v : m_data.threads )
+    {
+        v->timeline.~Vector();
+        v->stack.~Vector();
+        v->messages.~Vector();
+        v->zoneIdStack.~Vector();
+        v->samples.~Vector();
+#ifndef TRACY_NO_STATISTICS
+        v->childTimeStack.~Vector();
+        v->ghostZones.~Vector();
+#endif
+    }
+    for( auto& v : m_data.gpuData )
+    {
+        for( auto& vt : v->threadData )
+        {
+            vt.second.timeline.~Vector();
+            vt.second.stack.~Vector();
+        }
+    }
+    for( auto& v : m_data.plots.Data() )
     {
         v->~PlotData();
     }
@@ -1924,6 +3107,8 @@ Worker::~Worker()
         v.~Vector();
     }
 #endif
+
+    if( m_cacheMap ) munmap( m_cacheMap, m_cacheMapSize );
 }
 
 uint64_t Worker::GetLockCount() const
@@ -2002,6 +3187,20 @@ uint64_t Worker::GetContextSwitchSampleCount() const
     }
     return cnt;
 }
+
+const ThreadWaitTime* Worker::GetThreadWaitTime( uint64_t thread ) const
+{
+    auto it = m_data.threadWaitTime.find( thread );
+    if( it == m_data.threadWaitTime.end() ) return nullptr;
+    return &it->second;
+}
+
+int64_t Worker::GetContextSwitchSampleWaitTime( uint64_t thread, int64_t time )
+{
+    auto ctx = GetContextSwitchData( thread );
+    if( !ctx ) return -1;
+    return GetSampleWaitTime( ctx, time );
+}
 #endif
 
 uint64_t Worker::GetPidFromTid( uint64_t tid ) const
@@ -2612,13 +3811,9 @@ void Worker::Network()
 
     for(;;)
     {
-        {
-            std::unique_lock<std::mutex> lock( m_netWriteLock );
-            m_netWriteCv.wait( lock, [this] { return m_netWriteCnt > 0 || m_shutdown.load( std::memory_order_relaxed ); } );
-            if( m_shutdown.load( std::memory_order_relaxed ) ) goto close;
-            m_netWriteCnt--;
-        }
+        if( !NetBufferReserve() ) goto close;
 
+        if( m_bufferOffset + TargetFrameSize > m_netBufferSize ) m_bufferOffset = 0;
         auto buf = m_buffer + m_bufferOffset;
         lz4sz_t lz4sz;
         if( !m_sock.Read( &lz4sz, sizeof( lz4sz ), 10, ShouldExit ) ) goto close;
@@ -2631,20 +3826,132 @@ void Worker::Network()
         bb = m_decBytes.load( std::memory_order_relaxed );
         m_decBytes.store( bb + sz, std::memory_order_relaxed );
 
+        NetBufferPublish( NetBuffer { m_bufferOffset, sz } );
+        m_bufferOffset += sz;
+    }
+
+close:
+    // There is always a spare slot for the end of stream marker.
+    NetBufferPublish( NetBuffer { NetBufferClosed } );
+}
+
+bool Worker::NetBufferReserve()
+{
+    const auto write = m_netRingWrite.load( std::memory_order_relaxed );
+    auto HasSpace = [this, write] { return ( m_connected.load( std::memory_order_relaxed ) && write - m_netRingRead.load() < m_netRingDepth ) || m_shutdown.load( std::memory_order_relaxed ); };
+    if( !HasSpace() )
+    {
+        std::unique_lock<std::mutex> lock( m_netWriteLock );
+        m_netWriteSleeping.store( true );
+        m_netWriteCv.wait( lock, HasSpace );
+        m_netWriteSleeping.store( false, std::memory_order_relaxed );
+    }
+    return !m_shutdown.load( std::memory_order_relaxed );
+}
+
+void Worker::NetBufferPublish( const NetBuffer& buf )
+{
+    const auto write = m_netRingWrite.load( std::memory_order_relaxed );
+    m_netRing[write % m_netRingSize] = buf;
+    m_netRingWrite.store( write + 1 );
+    if( m_netReadSleeping.load() )
+    {
+        std::lock_guard<std::mutex> lock( m_netReadLock );
+        m_netReadCv.notify_one();
+    }
+}
+
+Worker::NetBuffer Worker::NetBufferAcquire( std::chrono::steady_clock::time_point deadline )
+{
+    const auto read = m_netRingRead.load( std::memory_order_relaxed );
+    if( m_netRingWrite.load( std::memory_order_acquire ) == read )
+    {
+        std::unique_lock<std::mutex> lock( m_netReadLock );
+        m_netReadSleeping.store( true );
+        auto HasData = [this, read] { return m_netRingWrite.load() != read; };
+        bool ready = true;
+        if( deadline == std::chrono::steady_clock::time_point::max() )
+        {
+            m_netReadCv.wait( lock, HasData );
+        }
+        else
         {
-            std::lock_guard<std::mutex> lock( m_netReadLock );
-            m_netRead.push_back( NetBuffer { m_bufferOffset, sz } );
-            m_netReadCv.notify_one();
+            ready = m_netReadCv.wait_until( lock, deadline, HasData );
         }
+        m_netReadSleeping.store( false, std::memory_order_relaxed );
+        if( !ready ) return NetBuffer { NetBufferTimeout };
+    }
+    return m_netRing[read % m_netRingSize];
+}
 
-        m_bufferOffset += sz;
-        if( m_bufferOffset > TargetFrameSize * 2 ) m_bufferOffset = 0;
+void Worker::NetBufferRelease()
+{
+    m_netRingRead.store( m_netRingRead.load( std::memory_order_relaxed ) + 1 );
+    if( m_netWriteSleeping.load() )
+    {
+        std::lock_guard<std::mutex> lock( m_netWriteLock );
+        m_netWriteCv.notify_one();
     }
+}
 
-close:
-    std::lock_guard<std::mutex> lock( m_netReadLock );
-    m_netRead.push_back( NetBuffer { -1 } );
-    m_netReadCv.notify_one();
+void Worker::NetBufferWakeWriter()
+{
+    std::lock_guard<std::mutex> lock( m_netWriteLock );
+    m_netWriteCv.notify_one();
+}
+
+void Worker::ProcessWelcome( const WelcomeMessage& welcome )
+{
+    m_data.framesBase = m_data.frames.Retrieve( 0, [this] ( uint64_t name ) {
+        auto fd = m_slab.AllocInit<FrameData>();
+        fd->name = name;
+        fd->continuous = 1;
+        return fd;
+    }, [this] ( uint64_t name ) {
+        assert( name == 0 );
+        char tmp[6] = "Frame";
+        HandleFrameName( name, tmp, 5 );
+    } );
+
+    m_timerMul = welcome.timerMul;
+    m_data.baseTime = welcome.initBegin;
+    const auto initEnd = TscTime( welcome.initEnd );
+    m_data.framesBase->frames.push_back( FrameEvent{ 0, -1, -1 } );
+    m_data.framesBase->frames.push_back( FrameEvent{ initEnd, -1, -1 } );
+    m_data.lastTime = initEnd;
+    m_delay = TscPeriod( welcome.delay );
+    m_resolution = TscPeriod( welcome.resolution );
+    m_pid = welcome.pid;
+    m_samplingPeriod = welcome.samplingPeriod;
+    m_onDemand = welcome.flags & WelcomeFlag::OnDemand;
+    m_captureProgram = welcome.programName;
+    m_captureTime = welcome.epoch;
+    m_executableTime = welcome.exectime;
+    m_ignoreMemFreeFaults = ( welcome.flags & WelcomeFlag::OnDemand ) || ( welcome.flags & WelcomeFlag::IsApple );
+    m_ignoreFrameEndFaults = welcome.flags & WelcomeFlag::OnDemand;
+    m_data.cpuArch = (CpuArchitecture)welcome.cpuArch;
+    m_codeTransfer = welcome.flags & WelcomeFlag::CodeTransfer;
+    m_combineSamples = welcome.flags & WelcomeFlag::CombineSamples;
+    m_identifySamples = welcome.flags & WelcomeFlag::IdentifySamples;
+    m_data.cpuId = welcome.cpuId;
+    memcpy( m_data.cpuManufacturer, welcome.cpuManufacturer, 12 );
+    m_data.cpuManufacturer[12] = '\0';
+
+    char dtmp[64];
+    time_t date = welcome.epoch;
+    auto lt = localtime( &date );
+    strftime( dtmp, 64, "%F %T", lt );
+    char tmp[1024];
+    sprintf( tmp, "%s @ %s", welcome.programName, dtmp );
+    m_captureName = tmp;
+
+    m_hostInfo = welcome.hostInfo;
+}
+
+void Worker::ProcessOnDemandPayload( const OnDemandPayloadMessage& onDemand )
+{
+    m_data.frameOffset = onDemand.frames;
+    m_data.framesBase->frames.push_back( FrameEvent{ TscTime( onDemand.currentTime ), -1, -1 } );
 }
 
 void Worker::Exec()
@@ -2653,12 +3960,13 @@ void Worker::Exec()
 
     for(;;)
     {
-        if( m_shutdown.load( std::memory_order_relaxed ) ) { m_netWriteCv.notify_one(); return; };
+        if( m_shutdown.load( std::memory_order_relaxed ) ) { NetBufferWakeWriter(); return; };
         if( m_sock.Connect( m_addr.c_str(), m_port ) ) break;
         std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
     }
 
     std::chrono::time_point<std::chrono::high_resolution_clock> t0;
+    std::chrono::time_point<std::chrono::steady_clock> lastCheckpoint;
 
     m_sock.Send( HandshakeShibboleth, HandshakeShibbolethSize );
     uint32_t protocolVersion = ProtocolVersion;
@@ -2680,17 +3988,6 @@ void Worker::Exec()
         goto close;
     }
 
-    m_data.framesBase = m_data.frames.Retrieve( 0, [this] ( uint64_t name ) {
-        auto fd = m_slab.AllocInit<FrameData>();
-        fd->name = name;
-        fd->continuous = 1;
-        return fd;
-    }, [this] ( uint64_t name ) {
-        assert( name == 0 );
-        char tmp[6] = "Frame";
-        HandleFrameName( name, tmp, 5 );
-    } );
-
     {
         WelcomeMessage welcome;
         if( !m_sock.Read( &welcome, sizeof( welcome ), 10, ShouldExit ) )
@@ -2698,50 +3995,33 @@ void Worker::Exec()
             m_handshake.store( HandshakeDropped, std::memory_order_relaxed );
             goto close;
         }
-        m_timerMul = welcome.timerMul;
-        m_data.baseTime = welcome.initBegin;
-        const auto initEnd = TscTime( welcome.initEnd );
-        m_data.framesBase->frames.push_back( FrameEvent{ 0, -1, -1 } );
-        m_data.framesBase->frames.push_back( FrameEvent{ initEnd, -1, -1 } );
-        m_data.lastTime = initEnd;
-        m_delay = TscPeriod( welcome.delay );
-        m_resolution = TscPeriod( welcome.resolution );
-        m_pid = welcome.pid;
-        m_samplingPeriod = welcome.samplingPeriod;
-        m_onDemand = welcome.flags & WelcomeFlag::OnDemand;
-        m_captureProgram = welcome.programName;
-        m_captureTime = welcome.epoch;
-        m_executableTime = welcome.exectime;
-        m_ignoreMemFreeFaults = ( welcome.flags & WelcomeFlag::OnDemand ) || ( welcome.flags & WelcomeFlag::IsApple );
-        m_ignoreFrameEndFaults = welcome.flags & WelcomeFlag::OnDemand;
-        m_data.cpuArch = (CpuArchitecture)welcome.cpuArch;
-        m_codeTransfer = welcome.flags & WelcomeFlag::CodeTransfer;
-        m_combineSamples = welcome.flags & WelcomeFlag::CombineSamples;
-        m_identifySamples = welcome.flags & WelcomeFlag::IdentifySamples;
-        m_data.cpuId = welcome.cpuId;
-        memcpy( m_data.cpuManufacturer, welcome.cpuManufacturer, 12 );
-        m_data.cpuManufacturer[12] = '\0';
-
-        char dtmp[64];
-        time_t date = welcome.epoch;
-        auto lt = localtime( &date );
-        strftime( dtmp, 64, "%F %T", lt );
-        char tmp[1024];
-        sprintf( tmp, "%s @ %s", welcome.programName, dtmp );
-        m_captureName = tmp;
-
-        m_hostInfo = welcome.hostInfo;
+        ProcessWelcome( welcome );
 
+        OnDemandPayloadMessage onDemand;
         if( m_onDemand )
         {
-            OnDemandPayloadMessage onDemand;
             if( !m_sock.Read( &onDemand, sizeof( onDemand ), 10, ShouldExit ) )
             {
                 m_handshake.store( HandshakeDropped, std::memory_order_relaxed );
                 goto close;
             }
-            m_data.frameOffset = onDemand.frames;
-            m_data.framesBase->frames.push_back( FrameEvent{ TscTime( onDemand.currentTime ), -1, -1 } );
+            ProcessOnDemandPayload( onDemand );
+        }
+
+        if( m_streamOut )
+        {
+            m_streamOut->Write( StreamHeader, sizeof( StreamHeader ) );
+            m_streamOut->Write( &protocolVersion, sizeof( protocolVersion ) );
+            m_streamOut->Write( &welcome, sizeof( welcome ) );
+            if( m_onDemand ) m_streamOut->Write( &onDemand, sizeof( onDemand ) );
+        }
+        if( m_recorder )
+        {
+            auto& header = m_recorder->header;
+            header.insert( header.end(), (const char*)StreamHeader, (const char*)StreamHeader + sizeof( StreamHeader ) );
+            header.insert( header.end(), (const char*)&protocolVersion, (const char*)&protocolVersion + sizeof( protocolVersion ) );
+            header.insert( header.end(), (const char*)&welcome, (const char*)&welcome + sizeof( welcome ) );
+            if( m_onDemand ) header.insert( header.end(), (const char*)&onDemand, (const char*)&onDemand + sizeof( onDemand ) );
         }
     }
 
@@ -2750,13 +4030,20 @@ void Worker::Exec()
 
     LZ4_setStreamDecode( (LZ4_streamDecode_t*)m_stream, nullptr, 0 );
     m_connected.store( true, std::memory_order_relaxed );
+    NetBufferWakeWriter();
+
     {
-        std::lock_guard<std::mutex> lock( m_netWriteLock );
-        m_netWriteCnt = 2;
-        m_netWriteCv.notify_one();
+        // Zone events of different threads are processed in parallel, if there are enough cores to spare.
+        const auto workers = std::min( int( std::thread::hardware_concurrency() ) - 3, 7 );
+        if( workers > 0 && !m_processStreamed )
+        {
+            m_ingestDispatch = GetIngestDispatch( workers );
+            m_ingestTasks = workers + 1;
+        }
     }
 
     t0 = std::chrono::high_resolution_clock::now();
+    lastCheckpoint = std::chrono::steady_clock::now();
 
     for(;;)
     {
@@ -2766,36 +4053,58 @@ void Worker::Exec()
             goto close;
         }
 
-        NetBuffer netbuf;
+        // Checkpoints are also due when the client is idle, so the wait for data ends when the next one is.
+        const auto interval = m_streamOut ? m_checkpointInterval.load( std::memory_order_relaxed ) : 0;
+        const auto nextCheckpoint = interval > 0 ? lastCheckpoint + std::chrono::seconds( interval ) : std::chrono::steady_clock::time_point::max();
+
+        const auto netbuf = NetBufferAcquire( nextCheckpoint );
+        if( netbuf.bufferOffset == NetBufferTimeout )
         {
-            std::unique_lock<std::mutex> lock( m_netReadLock );
-            m_netReadCv.wait( lock, [this] { return !m_netRead.empty(); } );
-            netbuf = m_netRead.front();
-            m_netRead.erase( m_netRead.begin() );
+            WriteCheckpoint();
+            lastCheckpoint = std::chrono::steady_clock::now();
+            continue;
         }
         if( netbuf.bufferOffset < 0 ) goto close;
 
         const char* ptr = m_buffer + netbuf.bufferOffset;
         const char* end = ptr + netbuf.size;
 
+        if( m_streamOut )
+        {
+            const uint32_t sz = netbuf.size;
+            m_streamOut->Write( &sz, sizeof( sz ) );
+            m_streamOut->Write( ptr, sz );
+
+            if( interval > 0 )
+            {
+                const auto now = std::chrono::steady_clock::now();
+                if( now >= nextCheckpoint )
+                {
+                    WriteCheckpoint();
+                    lastCheckpoint = now;
+                }
+            }
+        }
+        else if( m_recorder )
+        {
+            RecordFrame( ptr, netbuf.size );
+        }
+
         {
-            std::lock_guard<std::mutex> lock( m_data.lock );
+            std::lock_guard<DataLock> lock( m_data.lock );
             while( ptr < end )
             {
                 auto ev = (const QueueItem*)ptr;
-                if( !DispatchProcess( *ev, ptr ) )
+                if( !( m_ingestDispatch ? DispatchIngest( ptr, end ) : m_recorder ? DispatchRecorded( *ev, ptr ) : DispatchProcess( *ev, ptr, end ) ) )
                 {
                     if( m_failure != Failure::None ) HandleFailure( ptr, end );
                     QueryTerminate();
                     goto close;
                 }
+                if( m_data.lock.HasWaiters() ) m_data.lock.Handoff();
             }
 
-            {
-                std::lock_guard<std::mutex> lock( m_netWriteLock );
-                m_netWriteCnt++;
-                m_netWriteCv.notify_one();
-            }
+            NetBufferRelease();
 
             if( m_serverQuerySpaceLeft > 0 && !m_serverQueryQueuePrio.empty() )
             {
@@ -2825,6 +4134,8 @@ void Worker::Exec()
                     m_serverQueryQueue.erase( m_serverQueryQueue.begin(), m_serverQueryQueue.begin() + toSend );
                 }
             }
+
+            CheckMemoryLimit();
         }
 
         auto t1 = std::chrono::high_resolution_clock::now();
@@ -2836,18 +4147,19 @@ void Worker::Exec()
             t0 = t1;
         }
 
+        // A frozen flight recording still waits for the responses to the queries made by the kept events.
+        if( m_recorder && m_recorder->frozen.load( std::memory_order_relaxed ) && !IsQueryPending() )
+        {
+            QueryTerminate();
+            UpdateMbps( 0 );
+            break;
+        }
+
         if( m_terminate )
         {
-            if( m_pendingStrings != 0 || m_pendingThreads != 0 || m_pendingSourceLocation != 0 || m_pendingCallstackFrames != 0 ||
-                m_data.plots.IsPending() || m_pendingCallstackId != 0 || m_pendingExternalNames != 0 ||
-                m_pendingCallstackSubframes != 0 || m_pendingFrameImageData.image != nullptr || !m_pendingSymbols.empty() ||
-                m_pendingSymbolCode != 0 || !m_serverQueryQueue.empty() || !m_serverQueryQueuePrio.empty() ||
-                m_pendingSourceLocationPayload != 0 || m_pendingSingleString.ptr != nullptr || m_pendingSecondString.ptr != nullptr ||
-                !m_sourceCodeQuery.empty() || m_pendingFibers != 0 )
-            {
-                continue;
-            }
-            if( !m_crashed && !m_disconnect )
+            if( IsQueryPending() ) continue;
+            // Zones are not closed anymore once the timeline is dropped.
+            if( !m_crashed && !m_disconnect && m_memoryBudget != MemoryBudget::DropTimeline )
             {
                 bool done = true;
                 for( auto& v : m_data.threads )
@@ -2868,9 +4180,76 @@ void Worker::Exec()
 
 close:
     Shutdown();
-    m_netWriteCv.notify_one();
+    NetBufferWakeWriter();
     m_sock.Close();
-    m_connected.store( false, std::memory_order_relaxed );
+    if( m_streamOut && m_hasData.load( std::memory_order_relaxed ) )
+    {
+        const uint32_t endOfStream = 0;
+        m_streamOut->Write( &endOfStream, sizeof( endOfStream ) );
+        if( m_checkpointInterval.load( std::memory_order_relaxed ) > 0 ) WriteCheckpoint();
+    }
+    m_connected.store( false, std::memory_order_release );
+}
+
+// Approaching the memory budget, optional data is dropped first. If that is not enough, the timeline
+// stops growing, but the capture goes on answering client queries, so that the data collected so far
+// is complete and can be saved.
+void Worker::CheckMemoryLimit()
+{
+    const auto limit = m_memoryLimit.load( std::memory_order_relaxed );
+    if( limit == 0 || m_memoryBudget == MemoryBudget::DropTimeline ) return;
+
+    auto usage = memUsage;
+    if( m_recorder ) usage += m_recorder->size;
+    if( m_memoryBudget == MemoryBudget::Normal && usage > limit / 4 * 3 )
+    {
+        m_memoryBudget = MemoryBudget::DropOptional;
+        AddMemoryLimitNote( "frame images, symbol code, source files and hardware samples were dropped" );
+    }
+    if( m_memoryBudget == MemoryBudget::DropOptional && usage > limit / 10 * 9 )
+    {
+        m_memoryBudget = MemoryBudget::DropTimeline;
+        m_processStreamed = true;
+        m_ingestDispatch.reset();
+        m_ingestTasks = 0;
+        AddMemoryLimitNote( "further timeline events were dropped" );
+        // The flight recorder already processes events lightly, and its dictionary can't be dropped. The
+        // recording is saved as it is now, while it can still be replayed.
+        if( m_recorder ) m_recorder->frozen.store( true, std::memory_order_relaxed );
+    }
+}
+
+void Worker::AddMemoryLimitNote( const char* what )
+{
+    char buf[256];
+    const auto len = snprintf( buf, sizeof( buf ), "Server memory budget of %s reached at %s: %s.", MemSizeToString( m_memoryLimit.load( std::memory_order_relaxed ) ), TimeToString( m_data.lastTime ), what );
+    m_data.appInfo.push_back( StringRef( StringRef::Type::Idx, StoreString( buf, std::min<int>( len, sizeof( buf ) - 1 ) ).idx ) );
+}
+
+bool Worker::IsQueryPending() const
+{
+    return m_pendingStrings != 0 || m_pendingThreads != 0 || m_pendingSourceLocation != 0 || m_pendingCallstackFrames != 0 ||
+        m_data.plots.IsPending() || m_pendingCallstackId != 0 || m_pendingExternalNames != 0 ||
+        m_pendingCallstackSubframes != 0 || m_pendingFrameImageData.image != nullptr || !m_pendingSymbols.empty() ||
+        m_pendingSymbolCode != 0 || !m_serverQueryQueue.empty() || !m_serverQueryQueuePrio.empty() ||
+        m_pendingSourceLocationPayload != 0 || m_pendingSingleString.ptr != nullptr || m_pendingSecondString.ptr != nullptr ||
+        !m_sourceCodeQuery.empty() || m_pendingFibers != 0;
+}
+
+// All the workers in a process share one ingest thread pool, so that the number of threads does not grow
+// with the number of clients captured at the same time.
+std::shared_ptr<TaskDispatch> Worker::GetIngestDispatch( size_t workers )
+{
+    static std::mutex lock;
+    static std::weak_ptr<TaskDispatch> shared;
+    std::lock_guard<std::mutex> guard( lock );
+    auto dispatch = shared.lock();
+    if( !dispatch )
+    {
+        dispatch = std::make_shared<TaskDispatch>( workers, "Tracy Ingest" );
+        shared = dispatch;
+    }
+    return dispatch;
 }
 
 void Worker::UpdateMbps( int64_t td )
@@ -2933,11 +4312,7 @@ void Worker::HandleFailure( const char* ptr, const char* end )
         }
         if( HasAllFailureData() ) return;
 
-        {
-            std::lock_guard<std::mutex> lock( m_netWriteLock );
-            m_netWriteCnt++;
-            m_netWriteCv.notify_one();
-        }
+        NetBufferRelease();
 
         if( m_serverQuerySpaceLeft > 0 && !m_serverQueryQueuePrio.empty() )
         {
@@ -2970,13 +4345,7 @@ void Worker::HandleFailure( const char* ptr, const char* end )
 
         if( m_shutdown.load( std::memory_order_relaxed ) ) return;
 
-        NetBuffer netbuf;
-        {
-            std::unique_lock<std::mutex> lock( m_netReadLock );
-            m_netReadCv.wait( lock, [this] { return !m_netRead.empty(); } );
-            netbuf = m_netRead.front();
-            m_netRead.erase( m_netRead.begin() );
-        }
+        const auto netbuf = NetBufferAcquire();
         if( netbuf.bufferOffset < 0 ) return;
 
         ptr = m_buffer + netbuf.bufferOffset;
@@ -3080,6 +4449,8 @@ void Worker::DispatchFailure( const QueueItem& ev, const char*& ptr )
 
 void Worker::Query( ServerQuery type, uint64_t data, uint32_t extra )
 {
+    if( !m_sock.IsValid() ) return;
+    m_queryCount++;
     ServerQueryPacket query { type, data, extra };
     if( m_serverQuerySpaceLeft > 0 && m_serverQueryQueuePrio.empty() && m_serverQueryQueue.empty() )
     {
@@ -3144,6 +4515,12 @@ void Worker::QueryDataTransfer( const void* ptr, size_t size )
     }
 }
 
+bool Worker::DispatchProcess( const QueueItem& ev, const char*& ptr, const char* end )
+{
+    if( ev.hdr.type == QueueType::ZoneBegin && !m_processStreamed && ProcessLeafZone( ptr, end ) ) return true;
+    return DispatchProcess( ev, ptr );
+}
+
 bool Worker::DispatchProcess( const QueueItem& ev, const char*& ptr )
 {
     if( ev.hdr.idx >= (int)QueueType::StringData )
@@ -3247,63 +4624,253 @@ bool Worker::DispatchProcess( const QueueItem& ev, const char*& ptr )
             return true;
         default:
             ptr += QueueDataSize[ev.hdr.idx];
-            return Process( ev );
+            return m_processStreamed ? ProcessStreamed( ev ) : Process( ev );
         }
     }
 }
 
-void Worker::CheckSourceLocation( uint64_t ptr )
+bool Worker::DispatchIngest( const char*& ptr, const char* end )
 {
-    if( m_data.checkSrclocLast != ptr )
+    enum { MinParallelEvents = 4096 };
+
+    auto Resolve = [] ( ThreadData* td ) { return td->fiber ? td->fiber : td; };
+
+    // Stage one: find the run of events which only touch the timeline of their own thread.
+    auto ctxData = m_threadCtxData ? m_threadCtxData : RetrieveThread( m_threadCtx );
+    const auto initial = ctxData ? Resolve( ctxData ) : nullptr;
+    bool threadSwitch = false;
+    size_t count = 0;
+    auto p = ptr;
+    while( p < end )
     {
-        m_data.checkSrclocLast = ptr;
-        if( m_data.sourceLocation.find( ptr ) == m_data.sourceLocation.end() )
+        auto& ev = *(const QueueItem*)p;
+        if( ev.hdr.type == QueueType::ThreadContext )
         {
-            NewSourceLocation( ptr );
+            ctxData = RetrieveThread( ev.threadCtx.thread );
+            if( !ctxData ) break;
+            if( Resolve( ctxData ) != initial ) threadSwitch = true;
+        }
+        else if( ev.hdr.type == QueueType::ZoneBegin )
+        {
+            if( !ctxData ) break;
+            const auto srcloc = ev.zoneBegin.srcloc;
+            if( m_data.checkSrclocLast != srcloc )
+            {
+                if( m_data.sourceLocation.find( srcloc ) == m_data.sourceLocation.end() ) break;
+                m_data.checkSrclocLast = srcloc;
+            }
         }
+        else if( ev.hdr.type == QueueType::ZoneEnd || ev.hdr.type == QueueType::ZoneValidation )
+        {
+            if( !ctxData ) break;
+        }
+        else
+        {
+            break;
+        }
+        p += QueueDataSize[ev.hdr.idx];
+        count++;
     }
-}
-
-void Worker::NewSourceLocation( uint64_t ptr )
-{
-    static const SourceLocation emptySourceLocation = {};
 
-    if( m_data.sourceLocation.size() > std::numeric_limits<int16_t>::max() )
+    if( count < MinParallelEvents || !threadSwitch )
     {
-        SourceLocationOverflowFailure();
-        return;
+        while( ptr < p )
+        {
+            if( !DispatchProcess( *(const QueueItem*)ptr, ptr, p ) ) return false;
+        }
+        if( ptr == end ) return true;
+        return DispatchProcess( *(const QueueItem*)ptr, ptr );
     }
 
-    m_data.sourceLocation.emplace( ptr, emptySourceLocation );
-    m_pendingSourceLocation++;
-    m_sourceLocationQueue.push_back( ptr );
-
-    Query( ServerQuerySourceLocation, ptr );
-}
+    // Route the events to per-thread jobs.
+    size_t jobs = 0;
+    m_ingestJobMap.clear();
+    auto GetJob = [this, &jobs, &Resolve] ( ThreadData* ctx ) {
+        auto td = Resolve( ctx );
+        auto it = m_ingestJobMap.find( td );
+        if( it != m_ingestJobMap.end() ) return it->second;
+        if( m_ingestJobs.size() == jobs ) m_ingestJobs.emplace_back();
+        auto& job = m_ingestJobs[jobs];
+        job.td = td;
+        job.events.clear();
+        job.zoneBegins = 0;
+        job.refTime = m_refTimeThread;
+        job.lastTime = 0;
+        job.zonesCnt = 0;
+        job.children.clear();
+        job.childParents.clear();
+#ifndef TRACY_NO_STATISTICS
+        job.thread = CompressThread( td->id );
+#endif
+        job.stats.clear();
+        job.failure = Failure::None;
+        m_ingestJobMap.emplace( td, jobs );
+        return jobs++;
+    };
 
-int16_t Worker::ShrinkSourceLocationReal( uint64_t srcloc )
-{
-    auto it = m_sourceLocationShrink.find( srcloc );
-    if( it != m_sourceLocationShrink.end() )
+    auto ctxThread = m_threadCtx;
+    ctxData = m_threadCtxData ? m_threadCtxData : RetrieveThread( m_threadCtx );
+    size_t current = initial ? GetJob( ctxData ) : 0;
+    while( ptr < p )
     {
-        m_data.shrinkSrclocLast.first = srcloc;
-        m_data.shrinkSrclocLast.second = it->second;
-        return it->second;
+        auto ev = (const QueueItem*)ptr;
+        int16_t srcloc = 0;
+        if( ev->hdr.type == QueueType::ThreadContext )
+        {
+            ctxThread = ev->threadCtx.thread;
+            ctxData = RetrieveThread( ctxThread );
+            current = GetJob( ctxData );
+        }
+        else if( ev->hdr.type == QueueType::ZoneBegin )
+        {
+            srcloc = ShrinkSourceLocation( ev->zoneBegin.srcloc );
+            m_ingestJobs[current].zoneBegins++;
+        }
+        m_ingestJobs[current].events.push_back( IngestEvent { ev, srcloc } );
+        ptr += QueueDataSize[ev->hdr.idx];
     }
-    else
+
+    // Each job gets a disjoint range of provisional child vector indices.
+    auto childBase = int32_t( m_data.zoneChildren.size() );
+    for( size_t i=0; i<jobs; i++ )
     {
-        return NewShrinkedSourceLocation( srcloc );
+        m_ingestJobs[i].childBase = childBase;
+        childBase += m_ingestJobs[i].zoneBegins;
     }
-}
 
-int16_t Worker::NewShrinkedSourceLocation( uint64_t srcloc )
-{
-    assert( m_data.sourceLocationExpand.size() < std::numeric_limits<int16_t>::max() );
-    const auto sz = int16_t( m_data.sourceLocationExpand.size() );
-    m_data.sourceLocationExpand.push_back( srcloc );
-#ifndef TRACY_NO_STATISTICS
-    auto res = m_data.sourceLocationZones.emplace( sz, SourceLocationZones() );
-    m_data.srclocZonesLast.first = sz;
+    // Stage two: process the threads concurrently. The pool is shared with other workers in the process,
+    // so this thread takes part in the processing and only waits for the jobs the helpers have picked up.
+    // A helper which starts late finds no jobs left and does not touch the worker at all.
+    struct IngestBatch
+    {
+        std::atomic<size_t> next { 0 };
+        std::atomic<size_t> done { 0 };
+    };
+    const auto tasks = std::min( jobs, m_ingestTasks );
+    while( m_ingestContexts.size() < tasks ) m_ingestContexts.emplace_back( std::make_unique<IngestContext>() );
+    auto batch = std::make_shared<IngestBatch>();
+    auto Run = [this, jobs] ( IngestBatch& batch, size_t t ) {
+        for(;;)
+        {
+            const auto j = batch.next.fetch_add( 1, std::memory_order_relaxed );
+            if( j >= jobs ) break;
+            auto& ctx = *m_ingestContexts[t];
+            memUsageCounter = &ctx.memUsage;
+            RunIngestJob( m_ingestJobs[j], ctx );
+            memUsageCounter = &memUsage;
+            batch.done.fetch_add( 1, std::memory_order_release );
+        }
+    };
+    for( size_t t=1; t<tasks; t++ )
+    {
+        m_ingestDispatch->Queue( [batch, Run, t] { Run( *batch, t ); } );
+    }
+    Run( *batch, 0 );
+    while( batch->done.load( std::memory_order_acquire ) != jobs ) YieldThread();
+    for( size_t t=0; t<tasks; t++ )
+    {
+        memUsage += m_ingestContexts[t]->memUsage;
+        m_ingestContexts[t]->memUsage = 0;
+    }
+
+    // Merge the cross-thread data.
+    const IngestJob* failed = nullptr;
+    for( size_t i=0; i<jobs; i++ )
+    {
+        auto& job = m_ingestJobs[i];
+        const auto base = int32_t( m_data.zoneChildren.size() );
+        for( size_t k=0; k<job.childParents.size(); k++ )
+        {
+            job.childParents[k]->SetChild( base + int32_t( k ) );
+        }
+        for( auto& v : job.children )
+        {
+            m_data.zoneChildren.push_back( std::move( v ) );
+        }
+        job.children.clear();
+        m_data.zonesCnt += job.zonesCnt;
+        if( m_data.lastTime < job.lastTime ) m_data.lastTime = job.lastTime;
+#ifndef TRACY_NO_STATISTICS
+        for( auto& v : job.stats )
+        {
+            AddZoneStatistics( v.zone, job.thread, v.zone->End() - v.zone->Start(), v.selfSpan, v.isReentry );
+        }
+#else
+        for( auto& v : job.stats )
+        {
+            auto cnt = GetSourceLocationZonesCnt( v );
+            (*cnt)++;
+        }
+#endif
+        if( !failed && job.failure != Failure::None ) failed = &job;
+    }
+
+    m_threadCtx = ctxThread;
+    m_threadCtxData = ctxData;
+    m_refTimeThread = m_ingestJobs[current].refTime;
+
+    if( failed )
+    {
+        m_failure = failed->failure;
+        m_failureData.thread = failed->td->id;
+        m_failureData.srcloc = failed->failureSrcloc;
+        return false;
+    }
+    return true;
+}
+
+void Worker::CheckSourceLocation( uint64_t ptr )
+{
+    if( m_data.checkSrclocLast != ptr )
+    {
+        m_data.checkSrclocLast = ptr;
+        if( m_data.sourceLocation.find( ptr ) == m_data.sourceLocation.end() )
+        {
+            NewSourceLocation( ptr );
+        }
+    }
+}
+
+void Worker::NewSourceLocation( uint64_t ptr )
+{
+    static const SourceLocation emptySourceLocation = {};
+
+    if( m_data.sourceLocation.size() > std::numeric_limits<int16_t>::max() )
+    {
+        SourceLocationOverflowFailure();
+        return;
+    }
+
+    m_data.sourceLocation.emplace( ptr, emptySourceLocation );
+    m_pendingSourceLocation++;
+    m_sourceLocationQueue.push_back( ptr );
+
+    Query( ServerQuerySourceLocation, ptr );
+}
+
+int16_t Worker::ShrinkSourceLocationReal( uint64_t srcloc )
+{
+    auto it = m_sourceLocationShrink.find( srcloc );
+    if( it != m_sourceLocationShrink.end() )
+    {
+        m_data.shrinkSrclocLast.first = srcloc;
+        m_data.shrinkSrclocLast.second = it->second;
+        return it->second;
+    }
+    else
+    {
+        return NewShrinkedSourceLocation( srcloc );
+    }
+}
+
+int16_t Worker::NewShrinkedSourceLocation( uint64_t srcloc )
+{
+    assert( m_data.sourceLocationExpand.size() < std::numeric_limits<int16_t>::max() );
+    const auto sz = int16_t( m_data.sourceLocationExpand.size() );
+    m_data.sourceLocationExpand.push_back( srcloc );
+#ifndef TRACY_NO_STATISTICS
+    auto res = m_data.sourceLocationZones.emplace( sz, SourceLocationZones() );
+    m_data.srclocZonesLast.first = sz;
     m_data.srclocZonesLast.second = &res.first->second;
 #else
     auto res = m_data.sourceLocationZonesCnt.emplace( sz, 0 );
@@ -3480,29 +5047,7 @@ void Worker::NewZone( ZoneEvent* zone )
     }
     else
     {
-        auto& back = td->stack.data()[ssz-1];
-        if( !back->HasChildren() )
-        {
-            back->SetChild( int32_t( m_data.zoneChildren.size() ) );
-            if( m_data.zoneVectorCache.empty() )
-            {
-                m_data.zoneChildren.push_back( Vector<short_ptr<ZoneEvent>>( zone ) );
-            }
-            else
-            {
-                Vector<short_ptr<ZoneEvent>> vze = std::move( m_data.zoneVectorCache.back_and_pop() );
-                assert( !vze.empty() );
-                vze.clear();
-                vze.push_back_non_empty( zone );
-                m_data.zoneChildren.push_back( std::move( vze ) );
-            }
-        }
-        else
-        {
-            const auto backChild = back->Child();
-            assert( !m_data.zoneChildren[backChild].empty() );
-            m_data.zoneChildren[backChild].push_back_non_empty( zone );
-        }
+        AppendZoneChild( td->stack.data()[ssz-1], zone );
         td->stack.push_back_non_empty( zone );
     }
 
@@ -3514,6 +5059,32 @@ void Worker::NewZone( ZoneEvent* zone )
 #endif
 }
 
+void Worker::AppendZoneChild( ZoneEvent* parent, ZoneEvent* zone )
+{
+    if( !parent->HasChildren() )
+    {
+        parent->SetChild( int32_t( m_data.zoneChildren.size() ) );
+        if( m_data.zoneVectorCache.empty() )
+        {
+            m_data.zoneChildren.push_back( Vector<short_ptr<ZoneEvent>>( zone ) );
+        }
+        else
+        {
+            Vector<short_ptr<ZoneEvent>> vze = std::move( m_data.zoneVectorCache.back_and_pop() );
+            assert( !vze.empty() );
+            vze.clear();
+            vze.push_back_non_empty( zone );
+            m_data.zoneChildren.push_back( std::move( vze ) );
+        }
+    }
+    else
+    {
+        const auto child = parent->Child();
+        assert( !m_data.zoneChildren[child].empty() );
+        m_data.zoneChildren[child].push_back_non_empty( zone );
+    }
+}
+
 void Worker::InsertLockEvent( LockMap& lockmap, LockEvent* lev, uint64_t thread, int64_t time )
 {
     if( m_data.lastTime < time ) m_data.lastTime = time;
@@ -3705,9 +5276,9 @@ void Worker::AddString( uint64_t ptr, const char* str, size_t sz )
 
 void Worker::AddThreadString( uint64_t id, const char* str, size_t sz )
 {
+    auto it = m_data.threadNames.find( id );
     assert( m_pendingThreads > 0 );
     m_pendingThreads--;
-    auto it = m_data.threadNames.find( id );
     assert( it != m_data.threadNames.end() && strcmp( it->second, "???" ) == 0 );
     const auto sl = StoreString( str, sz );
     it->second = sl.ptr;
@@ -3768,6 +5339,7 @@ void Worker::AddFrameImageData( const char* data, size_t sz )
 {
     assert( m_pendingFrameImageData.image == nullptr );
     assert( sz % 8 == 0 );
+    if( m_memoryBudget != MemoryBudget::Normal || m_processStreamed ) return;
     // Input data buffer cannot be changed, as it is used as LZ4 dictionary.
     if( m_frameImageBufferSize < sz )
     {
@@ -4186,6 +5758,7 @@ void Worker::DoPostponedWork()
                             if( sit->time.Val() == cit->Start() )
                             {
                                 td->ctxSwitchSamples.push_back( *sit );
+                                QueueThreadWaitTime( *td );
                             }
                             else
                             {
@@ -4207,12 +5780,64 @@ void Worker::DoPostponedWork()
                 }
             }
         }
+    }
+
+    if( m_data.newContextSwitchesReceived )
+    {
+        UpdateThreadWaitTimes();
         m_data.newContextSwitchesReceived = false;
     }
 #endif
 }
 
 #ifndef TRACY_NO_STATISTICS
+void Worker::QueueThreadWaitTime( ThreadData& td )
+{
+    auto& wt = m_data.threadWaitTime[td.id];
+    if( wt.pending ) return;
+    wt.pending = true;
+    m_data.threadWaitPending.push_back( &td );
+}
+
+// Only the threads which got new context switch samples are visited. A thread stays queued while its
+// oldest unprocessed sample waits for the thread to be scheduled back.
+void Worker::UpdateThreadWaitTimes()
+{
+    size_t keep = 0;
+    for( auto td : m_data.threadWaitPending )
+    {
+        auto& wt = m_data.threadWaitTime[td->id];
+        const auto sz = td->ctxSwitchSamples.size();
+        auto ctx = GetContextSwitchData( td->id );
+        while( ctx && wt.processed < sz )
+        {
+            auto& sd = td->ctxSwitchSamples[wt.processed];
+            const auto wait = GetSampleWaitTime( ctx, sd.time.Val() );
+            if( wait < 0 ) break;
+            wt.total += wait;
+            auto sit = wt.stacks.find( sd.callstack.Val() );
+            if( sit == wt.stacks.end() )
+            {
+                wt.stacks.emplace( sd.callstack.Val(), wait );
+            }
+            else
+            {
+                sit->second += wait;
+            }
+            wt.processed++;
+        }
+        if( wt.processed < sz )
+        {
+            m_data.threadWaitPending[keep++] = td;
+        }
+        else
+        {
+            wt.pending = false;
+        }
+    }
+    m_data.threadWaitPending.erase( m_data.threadWaitPending.begin() + keep, m_data.threadWaitPending.end() );
+}
+
 void Worker::HandlePostponedSamples()
 {
     assert( m_data.newFramesWereReceived );
@@ -4639,22 +6264,25 @@ bool Worker::Process( const QueueItem& ev )
         ProcessTidToPid( ev.tidToPid );
         break;
     case QueueType::HwSampleCpuCycle:
-        ProcessHwSampleCpuCycle( ev.hwSample );
+        if( m_memoryBudget == MemoryBudget::Normal ) ProcessHwSampleCpuCycle( ev.hwSample );
         break;
     case QueueType::HwSampleInstructionRetired:
-        ProcessHwSampleInstructionRetired( ev.hwSample );
+        if( m_memoryBudget == MemoryBudget::Normal ) ProcessHwSampleInstructionRetired( ev.hwSample );
         break;
     case QueueType::HwSampleCacheReference:
-        ProcessHwSampleCacheReference( ev.hwSample );
+        if( m_memoryBudget == MemoryBudget::Normal ) ProcessHwSampleCacheReference( ev.hwSample );
         break;
     case QueueType::HwSampleCacheMiss:
-        ProcessHwSampleCacheMiss( ev.hwSample );
+        if( m_memoryBudget == MemoryBudget::Normal ) ProcessHwSampleCacheMiss( ev.hwSample );
         break;
     case QueueType::HwSampleBranchRetired:
-        ProcessHwSampleBranchRetired( ev.hwSample );
+        if( m_memoryBudget == MemoryBudget::Normal ) ProcessHwSampleBranchRetired( ev.hwSample );
         break;
     case QueueType::HwSampleBranchMiss:
-        ProcessHwSampleBranchMiss( ev.hwSample );
+        if( m_memoryBudget == MemoryBudget::Normal ) ProcessHwSampleBranchMiss( ev.hwSample );
+        break;
+    case QueueType::HwSampleGroup:
+        if( m_memoryBudget == MemoryBudget::Normal ) ProcessHwSampleGroup( ev.hwSampleGroup );
         break;
     case QueueType::ParamSetup:
         ProcessParamSetup( ev.paramSetup );
@@ -4690,16 +6318,6 @@ bool Worker::Process( const QueueItem& ev )
     return m_failure == Failure::None;
 }
 
-void Worker::ProcessThreadContext( const QueueThreadContext& ev )
-{
-    m_refTimeThread = 0;
-    if( m_threadCtx != ev.thread )
-    {
-        m_threadCtx = ev.thread;
-        m_threadCtxData = RetrieveThread( ev.thread );
-    }
-}
-
 static tracy_force_inline int64_t RefTime( int64_t& reference, int64_t delta )
 {
     const auto refTime = reference + delta;
@@ -4707,113 +6325,606 @@ static tracy_force_inline int64_t RefTime( int64_t& reference, int64_t delta )
     return refTime;
 }
 
-void Worker::ProcessZoneBeginImpl( ZoneEvent* zone, const QueueZoneBegin& ev )
-{
-    CheckSourceLocation( ev.srcloc );
-
-    const auto start = TscTime( RefTime( m_refTimeThread, ev.time ) );
-    zone->SetStartSrcLoc( start, ShrinkSourceLocation( ev.srcloc ) );
-    zone->SetEnd( -1 );
-    zone->SetChild( -1 );
-
-    if( m_data.lastTime < start ) m_data.lastTime = start;
-
-    NewZone( zone );
-}
-
-void Worker::ProcessZoneBeginAllocSrcLocImpl( ZoneEvent* zone, const QueueZoneBeginLean& ev )
-{
-    assert( m_pendingSourceLocationPayload != 0 );
-
-    const auto start = TscTime( RefTime( m_refTimeThread, ev.time ) );
-    zone->SetStartSrcLoc( start, m_pendingSourceLocationPayload );
-    zone->SetEnd( -1 );
-    zone->SetChild( -1 );
-
-    if( m_data.lastTime < start ) m_data.lastTime = start;
-
-    NewZone( zone );
-
-    m_pendingSourceLocationPayload = 0;
-}
-
-ZoneEvent* Worker::AllocZoneEvent()
-{
-    ZoneEvent* ret;
-#ifndef TRACY_NO_STATISTICS
-    ret = m_slab.Alloc<ZoneEvent>();
-#else
-    if( m_zoneEventPool.empty() )
-    {
-        ret = m_slab.Alloc<ZoneEvent>();
-    }
-    else
-    {
-        ret = m_zoneEventPool.back_and_pop();
-    }
-#endif
-    ret->extra = 0;
-    return ret;
-}
-
-void Worker::ProcessZoneBegin( const QueueZoneBegin& ev )
-{
-    auto zone = AllocZoneEvent();
-    ProcessZoneBeginImpl( zone, ev );
-}
-
-void Worker::ProcessZoneBeginCallstack( const QueueZoneBegin& ev )
-{
-    auto zone = AllocZoneEvent();
-    ProcessZoneBeginImpl( zone, ev );
-    auto td = GetCurrentThreadData();
-    auto it = m_nextCallstack.find( td->id );
-    assert( it != m_nextCallstack.end() );
-    auto& extra = RequestZoneExtra( *zone );
-    extra.callstack.SetVal( it->second );
-    it->second = 0;
-}
-
-void Worker::ProcessZoneBeginAllocSrcLoc( const QueueZoneBeginLean& ev )
-{
-    auto zone = AllocZoneEvent();
-    ProcessZoneBeginAllocSrcLocImpl( zone, ev );
-}
-
-void Worker::ProcessZoneBeginAllocSrcLocCallstack( const QueueZoneBeginLean& ev )
+// While the event stream is recorded the timeline is not kept in memory. Only the work needed to keep
+// the client's queries and the delta times in step is done for the bulk of events, so that the replay of
+// the stream sees all the data it will ask for. This includes noticing the threads the events belong to,
+// which queries their names. Anything else goes through the regular processing.
+bool Worker::ProcessStreamed( const QueueItem& ev )
 {
-    auto zone = AllocZoneEvent();
-    ProcessZoneBeginAllocSrcLocImpl( zone, ev );
-    auto td = GetCurrentThreadData();
-    auto it = m_nextCallstack.find( td->id );
-    assert( it != m_nextCallstack.end() );
-    auto& extra = RequestZoneExtra( *zone );
-    extra.callstack.SetVal( it->second );
-    it->second = 0;
-}
+    auto ConsumeCallstack = [this] {
+        auto td = GetCurrentThreadData();
+        auto it = m_nextCallstack.find( td->id );
+        assert( it != m_nextCallstack.end() );
+        it->second = 0;
+    };
+    auto CheckFreezeMessage = [this] ( const char* text ) {
+        if( !m_recorder || m_recorder->config.freezeMessage.empty() ) return;
+        if( strstr( text, m_recorder->config.freezeMessage.c_str() ) ) m_recorder->frozen.store( true, std::memory_order_relaxed );
+    };
 
-void Worker::ProcessZoneEnd( const QueueZoneEnd& ev )
-{
-    auto td = GetCurrentThreadData();
-    if( td->zoneIdStack.empty() )
-    {
-        ZoneDoubleEndFailure( td->id, td->timeline.empty() ? nullptr : td->timeline.back() );
-        return;
-    }
-    auto zoneId = td->zoneIdStack.back_and_pop();
-    if( zoneId != td->nextZoneId )
+    switch( ev.hdr.type )
     {
-        ZoneStackFailure( td->id, td->stack.back() );
-        return;
-    }
-    td->nextZoneId = 0;
-
-    auto& stack = td->stack;
-    assert( !stack.empty() );
-    auto zone = stack.back_and_pop();
-    assert( zone->End() == -1 );
-    const auto isReentry = td->DecStackCount( zone->SrcLoc() );
-    const auto timeEnd = TscTime( RefTime( m_refTimeThread, ev.time ) );
+    case QueueType::ZoneBegin:
+        GetCurrentThreadData();
+        CheckSourceLocation( ev.zoneBegin.srcloc );
+        RefTime( m_refTimeThread, ev.zoneBegin.time );
+        m_data.zonesCnt++;
+        break;
+    case QueueType::ZoneBeginCallstack:
+        GetCurrentThreadData();
+        CheckSourceLocation( ev.zoneBegin.srcloc );
+        RefTime( m_refTimeThread, ev.zoneBegin.time );
+        ConsumeCallstack();
+        m_data.zonesCnt++;
+        break;
+    case QueueType::ZoneBeginAllocSrcLoc:
+        GetCurrentThreadData();
+        assert( m_pendingSourceLocationPayload != 0 );
+        m_pendingSourceLocationPayload = 0;
+        RefTime( m_refTimeThread, ev.zoneBegin.time );
+        m_data.zonesCnt++;
+        break;
+    case QueueType::ZoneBeginAllocSrcLocCallstack:
+        GetCurrentThreadData();
+        assert( m_pendingSourceLocationPayload != 0 );
+        m_pendingSourceLocationPayload = 0;
+        RefTime( m_refTimeThread, ev.zoneBegin.time );
+        ConsumeCallstack();
+        m_data.zonesCnt++;
+        break;
+    case QueueType::ZoneEnd:
+        GetCurrentThreadData();
+        RefTime( m_refTimeThread, ev.zoneEnd.time );
+        break;
+    case QueueType::ZoneText:
+    case QueueType::ZoneName:
+        GetSingleStringIdx();
+        break;
+    case QueueType::Message:
+    case QueueType::MessageColor:
+        GetCurrentThreadData();
+        CheckFreezeMessage( m_pendingSingleString.ptr );
+        GetSingleStringIdx();
+        break;
+    case QueueType::MessageCallstack:
+    case QueueType::MessageColorCallstack:
+        GetCurrentThreadData();
+        CheckFreezeMessage( m_pendingSingleString.ptr );
+        GetSingleStringIdx();
+        ConsumeCallstack();
+        break;
+    case QueueType::MessageLiteral:
+        GetCurrentThreadData();
+        CheckString( ev.messageLiteral.text );
+        CheckFreezeMessage( GetString( ev.messageLiteral.text ) );
+        break;
+    case QueueType::MessageLiteralColor:
+        GetCurrentThreadData();
+        CheckString( ev.messageColorLiteral.text );
+        CheckFreezeMessage( GetString( ev.messageColorLiteral.text ) );
+        break;
+    case QueueType::MessageLiteralCallstack:
+        GetCurrentThreadData();
+        CheckString( ev.messageLiteral.text );
+        CheckFreezeMessage( GetString( ev.messageLiteral.text ) );
+        ConsumeCallstack();
+        break;
+    case QueueType::MessageLiteralColorCallstack:
+        GetCurrentThreadData();
+        CheckString( ev.messageColorLiteral.text );
+        CheckFreezeMessage( GetString( ev.messageColorLiteral.text ) );
+        ConsumeCallstack();
+        break;
+    case QueueType::ZoneValidation:
+        GetCurrentThreadData();
+        break;
+    case QueueType::ZoneColor:
+    case QueueType::ZoneValue:
+        break;
+    case QueueType::LockWait:
+    case QueueType::LockSharedWait:
+        RefTime( m_refTimeSerial, ev.lockWait.time );
+        NoticeThread( ev.lockWait.thread );
+        break;
+    case QueueType::LockObtain:
+    case QueueType::LockSharedObtain:
+        RefTime( m_refTimeSerial, ev.lockObtain.time );
+        NoticeThread( ev.lockObtain.thread );
+        break;
+    case QueueType::LockRelease:
+        RefTime( m_refTimeSerial, ev.lockRelease.time );
+        break;
+    case QueueType::LockSharedRelease:
+        RefTime( m_refTimeSerial, ev.lockReleaseShared.time );
+        NoticeThread( ev.lockReleaseShared.thread );
+        break;
+    case QueueType::LockMark:
+        CheckSourceLocation( ev.lockMark.srcloc );
+        break;
+    case QueueType::PlotDataInt:
+        RetrieveUserPlot( ev.plotDataInt.name );
+        RefTime( m_refTimeThread, ev.plotDataInt.time );
+        break;
+    case QueueType::PlotDataFloat:
+        if( !isfinite( ev.plotDataFloat.val ) ) break;
+        RetrieveUserPlot( ev.plotDataFloat.name );
+        RefTime( m_refTimeThread, ev.plotDataFloat.time );
+        break;
+    case QueueType::PlotDataDouble:
+        if( !isfinite( ev.plotDataDouble.val ) ) break;
+        RetrieveUserPlot( ev.plotDataDouble.name );
+        RefTime( m_refTimeThread, ev.plotDataDouble.time );
+        break;
+    case QueueType::MemAlloc:
+        RefTime( m_refTimeSerial, ev.memAlloc.time );
+        NoticeThread( ev.memAlloc.thread );
+        break;
+    case QueueType::MemAllocNamed:
+        ConsumeMemNamePayload();
+        RefTime( m_refTimeSerial, ev.memAlloc.time );
+        NoticeThread( ev.memAlloc.thread );
+        break;
+    case QueueType::MemAllocCallstack:
+        RefTime( m_refTimeSerial, ev.memAlloc.time );
+        NoticeThread( ev.memAlloc.thread );
+        m_serialNextCallstack = 0;
+        break;
+    case QueueType::MemAllocCallstackNamed:
+        ConsumeMemNamePayload();
+        RefTime( m_refTimeSerial, ev.memAlloc.time );
+        NoticeThread( ev.memAlloc.thread );
+        m_serialNextCallstack = 0;
+        break;
+    case QueueType::MemFree:
+        RefTime( m_refTimeSerial, ev.memFree.time );
+        if( ev.memFree.ptr != 0 ) NoticeThread( ev.memFree.thread );
+        break;
+    case QueueType::MemFreeNamed:
+        ConsumeMemNamePayload();
+        RefTime( m_refTimeSerial, ev.memFree.time );
+        if( ev.memFree.ptr != 0 ) NoticeThread( ev.memFree.thread );
+        break;
+    case QueueType::MemFreeCallstack:
+        RefTime( m_refTimeSerial, ev.memFree.time );
+        if( ev.memFree.ptr != 0 ) NoticeThread( ev.memFree.thread );
+        m_serialNextCallstack = 0;
+        break;
+    case QueueType::MemFreeCallstackNamed:
+        ConsumeMemNamePayload();
+        RefTime( m_refTimeSerial, ev.memFree.time );
+        if( ev.memFree.ptr != 0 ) NoticeThread( ev.memFree.thread );
+        m_serialNextCallstack = 0;
+        break;
+    case QueueType::FrameMarkMsg:
+    case QueueType::FrameMarkMsgStart:
+    case QueueType::FrameMarkMsgEnd:
+    {
+        m_data.frames.Retrieve( ev.frameMark.name, [this, &ev] ( uint64_t name ) {
+            auto fd = m_slab.AllocInit<FrameData>();
+            fd->name = name;
+            fd->continuous = ev.hdr.type == QueueType::FrameMarkMsg;
+            return fd;
+        }, [this] ( uint64_t name ) {
+            Query( ServerQueryFrameName, name );
+        } );
+        const auto time = TscTime( ev.frameMark.time );
+        if( m_data.lastTime < time ) m_data.lastTime = time;
+        break;
+    }
+    case QueueType::FrameImage:
+        m_pendingFrameImageData.image = nullptr;
+        break;
+    case QueueType::GpuZoneBegin:
+        CheckSourceLocation( ev.gpuZoneBegin.srcloc );
+        RefTime( m_refTimeThread, ev.gpuZoneBegin.cpuTime );
+        break;
+    case QueueType::GpuZoneBeginCallstack:
+        CheckSourceLocation( ev.gpuZoneBegin.srcloc );
+        RefTime( m_refTimeThread, ev.gpuZoneBegin.cpuTime );
+        ConsumeCallstack();
+        break;
+    case QueueType::GpuZoneBeginAllocSrcLoc:
+        assert( m_pendingSourceLocationPayload != 0 );
+        m_pendingSourceLocationPayload = 0;
+        RefTime( m_refTimeThread, ev.gpuZoneBeginLean.cpuTime );
+        break;
+    case QueueType::GpuZoneBeginAllocSrcLocCallstack:
+        assert( m_pendingSourceLocationPayload != 0 );
+        m_pendingSourceLocationPayload = 0;
+        RefTime( m_refTimeThread, ev.gpuZoneBeginLean.cpuTime );
+        ConsumeCallstack();
+        break;
+    case QueueType::GpuZoneEnd:
+        RefTime( m_refTimeThread, ev.gpuZoneEnd.cpuTime );
+        break;
+    case QueueType::GpuZoneBeginSerial:
+        CheckSourceLocation( ev.gpuZoneBegin.srcloc );
+        RefTime( m_refTimeSerial, ev.gpuZoneBegin.cpuTime );
+        break;
+    case QueueType::GpuZoneBeginCallstackSerial:
+        CheckSourceLocation( ev.gpuZoneBegin.srcloc );
+        RefTime( m_refTimeSerial, ev.gpuZoneBegin.cpuTime );
+        m_serialNextCallstack = 0;
+        break;
+    case QueueType::GpuZoneBeginAllocSrcLocSerial:
+        assert( m_pendingSourceLocationPayload != 0 );
+        m_pendingSourceLocationPayload = 0;
+        RefTime( m_refTimeSerial, ev.gpuZoneBeginLean.cpuTime );
+        break;
+    case QueueType::GpuZoneBeginAllocSrcLocCallstackSerial:
+        assert( m_pendingSourceLocationPayload != 0 );
+        m_pendingSourceLocationPayload = 0;
+        RefTime( m_refTimeSerial, ev.gpuZoneBeginLean.cpuTime );
+        m_serialNextCallstack = 0;
+        break;
+    case QueueType::GpuZoneEndSerial:
+        RefTime( m_refTimeSerial, ev.gpuZoneEnd.cpuTime );
+        break;
+    case QueueType::GpuTime:
+        RefTime( m_refTimeGpu, ev.gpuTime.gpuTime );
+        break;
+    case QueueType::CallstackSample:
+    case QueueType::CallstackSampleContextSwitch:
+        assert( m_pendingCallstackId != 0 );
+        m_pendingCallstackId = 0;
+        RefTime( m_refTimeCtx, ev.callstackSample.time );
+        NoticeThread( ev.callstackSample.thread );
+        break;
+    case QueueType::ContextSwitch:
+        RefTime( m_refTimeCtx, ev.contextSwitch.time );
+        if( ev.contextSwitch.newThread != 0 ) CheckExternalName( ev.contextSwitch.newThread );
+        break;
+    case QueueType::ThreadWakeup:
+        RefTime( m_refTimeCtx, ev.threadWakeup.time );
+        break;
+    case QueueType::HwSampleCpuCycle:
+    case QueueType::HwSampleInstructionRetired:
+    case QueueType::HwSampleCacheReference:
+    case QueueType::HwSampleCacheMiss:
+    case QueueType::HwSampleBranchRetired:
+    case QueueType::HwSampleBranchMiss:
+    case QueueType::HwSampleGroup:
+        break;
+    default:
+        return Process( ev );
+    }
+
+    return true;
+}
+
+static void AppendStreamData( std::vector<char>& vec, const void* ptr, size_t size )
+{
+    vec.insert( vec.end(), (const char*)ptr, (const char*)ptr + size );
+}
+
+bool Worker::DispatchRecorded( const QueueItem& ev, const char*& ptr )
+{
+    auto& rec = *m_recorder;
+    const auto kind = GetStreamEventKind( ev.hdr.type );
+    const StreamState state { m_threadCtx, m_refTimeThread, m_refTimeSerial, m_refTimeCtx, m_refTimeGpu };
+    const auto queryCount = m_queryCount;
+    const auto start = ptr;
+    if( !DispatchProcess( ev, ptr ) ) return false;
+
+    switch( kind )
+    {
+    case StreamEventKind::Payload:
+        AppendStreamData( rec.payload, start, ptr - start );
+        if( m_queryCount != queryCount ) rec.payloadQueried = true;
+        break;
+    case StreamEventKind::Window:
+        // Window events go away with their chunk, unless the client was queried about something they
+        // refer to. The replay has to register the query in order to accept its response later on. This
+        // includes the name of a thread first seen in a window event, which the light handler notices.
+        if( rec.payloadQueried || m_queryCount != queryCount )
+        {
+            RecordDictionary( StreamLightRecord, start, ptr - start, state );
+        }
+        rec.payload.clear();
+        rec.payloadQueried = false;
+        rec.dirty = true;
+        break;
+    case StreamEventKind::Context:
+        rec.dirty = true;
+        break;
+    case StreamEventKind::Dictionary:
+        RecordDictionary( StreamEventRecord, start, ptr - start, state );
+        break;
+    default:
+        assert( false );
+        break;
+    }
+    return true;
+}
+
+void Worker::RecordDictionary( uint32_t kind, const char* ptr, size_t sz, const StreamState& state )
+{
+    auto& rec = *m_recorder;
+    auto& out = rec.stopped ? rec.tail : rec.chunks.back().dictionary;
+    const auto outSize = out.size();
+    if( rec.dirty )
+    {
+        const uint32_t stateRecord = StreamStateRecord;
+        AppendStreamData( out, &stateRecord, sizeof( stateRecord ) );
+        AppendStreamData( out, &state, sizeof( state ) );
+        rec.openKind = StreamStateRecord;
+        rec.dirty = false;
+    }
+    if( rec.openKind != kind || out.size() - rec.openRecord - sizeof( uint32_t ) + rec.payload.size() + sz > TargetFrameSize )
+    {
+        rec.openRecord = out.size();
+        rec.openKind = kind;
+        AppendStreamData( out, &kind, sizeof( kind ) );
+    }
+    out.insert( out.end(), rec.payload.begin(), rec.payload.end() );
+    AppendStreamData( out, ptr, sz );
+    const uint32_t recordSize = uint32_t( out.size() - rec.openRecord - sizeof( uint32_t ) ) | kind;
+    memcpy( out.data() + rec.openRecord, &recordSize, sizeof( recordSize ) );
+
+    rec.payload.clear();
+    rec.payloadQueried = false;
+    if( !rec.stopped ) rec.size += out.size() - outSize;
+}
+
+void Worker::RecordFrame( const char* ptr, uint32_t sz )
+{
+    enum { ChunkTime = 1000 };
+
+    auto& rec = *m_recorder;
+    if( rec.frozen.load( std::memory_order_relaxed ) )
+    {
+        if( !rec.stopped )
+        {
+            rec.stopped = true;
+            rec.dirty = true;
+        }
+        return;
+    }
+
+    const auto now = std::chrono::duration_cast<std::chrono::milliseconds>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+
+    // A chunk must not start between payload events and the event which consumes them.
+    if( rec.payload.empty() && ( rec.chunks.empty() || now - rec.chunks.back().start >= ChunkTime ||
+        ( rec.config.size != 0 && rec.chunks.back().frames.size() >= rec.config.size / 8 ) ) )
+    {
+        rec.chunks.emplace_back();
+        auto& chunk = rec.chunks.back();
+        chunk.start = now;
+        const uint32_t stateRecord = StreamStateRecord;
+        const StreamState state { m_threadCtx, m_refTimeThread, m_refTimeSerial, m_refTimeCtx, m_refTimeGpu };
+        AppendStreamData( chunk.frames, &stateRecord, sizeof( stateRecord ) );
+        AppendStreamData( chunk.frames, &state, sizeof( state ) );
+        rec.size += chunk.frames.size();
+        rec.dirty = true;
+    }
+
+    auto& frames = rec.chunks.back().frames;
+    AppendStreamData( frames, &sz, sizeof( sz ) );
+    AppendStreamData( frames, ptr, sz );
+    rec.size += sizeof( sz ) + sz;
+
+    while( rec.chunks.size() > 1 )
+    {
+        auto& front = rec.chunks.front();
+        const auto expired = rec.config.seconds != 0 && now - rec.chunks[1].start >= rec.config.seconds * 1000ll;
+        const auto oversized = rec.config.size != 0 && rec.size > rec.config.size;
+        if( !expired && !oversized ) break;
+        rec.size -= front.frames.size();
+        if( !front.dictionary.empty() )
+        {
+            const auto rawSize = int( front.dictionary.size() );
+            auto tmp = std::unique_ptr<char[]>( new char[LZ4_compressBound( rawSize )] );
+            const auto sz = LZ4_compress_default( front.dictionary.data(), tmp.get(), rawSize, LZ4_compressBound( rawSize ) );
+            assert( sz > 0 );
+            FlightRecorderData::DictionaryBlock block { std::unique_ptr<char[]>( new char[sz] ), uint32_t( sz ), uint32_t( rawSize ) };
+            memcpy( block.data.get(), tmp.get(), sz );
+            rec.size -= rawSize;
+            rec.size += sz;
+            rec.dictionary.emplace_back( std::move( block ) );
+        }
+        rec.chunks.pop_front();
+    }
+}
+
+void Worker::ProcessThreadContext( const QueueThreadContext& ev )
+{
+    m_refTimeThread = 0;
+    if( m_threadCtx != ev.thread )
+    {
+        m_threadCtx = ev.thread;
+        m_threadCtxData = RetrieveThread( ev.thread );
+    }
+}
+
+void Worker::ProcessZoneBeginImpl( ZoneEvent* zone, const QueueZoneBegin& ev )
+{
+    CheckSourceLocation( ev.srcloc );
+
+    const auto start = TscTime( RefTime( m_refTimeThread, ev.time ) );
+    zone->SetStartSrcLoc( start, ShrinkSourceLocation( ev.srcloc ) );
+    zone->SetEnd( -1 );
+    zone->SetChild( -1 );
+
+    if( m_data.lastTime < start ) m_data.lastTime = start;
+
+    NewZone( zone );
+}
+
+void Worker::ProcessZoneBeginAllocSrcLocImpl( ZoneEvent* zone, const QueueZoneBeginLean& ev )
+{
+    assert( m_pendingSourceLocationPayload != 0 );
+
+    const auto start = TscTime( RefTime( m_refTimeThread, ev.time ) );
+    zone->SetStartSrcLoc( start, m_pendingSourceLocationPayload );
+    zone->SetEnd( -1 );
+    zone->SetChild( -1 );
+
+    if( m_data.lastTime < start ) m_data.lastTime = start;
+
+    NewZone( zone );
+
+    m_pendingSourceLocationPayload = 0;
+}
+
+ZoneEvent* Worker::AllocZoneEvent()
+{
+    ZoneEvent* ret;
+#ifndef TRACY_NO_STATISTICS
+    ret = AllocZoneEventBatched();
+#else
+    if( m_zoneEventPool.empty() )
+    {
+        ret = AllocZoneEventBatched();
+    }
+    else
+    {
+        ret = m_zoneEventPool.back_and_pop();
+    }
+#endif
+    ret->extra = 0;
+    return ret;
+}
+
+ZoneEvent* Worker::AllocZoneEventBatched()
+{
+    // Zone events are taken from the slab in batches, which keeps the slab block checks out of the per-zone path.
+    enum { BatchSize = 1024 };
+    if( m_zoneEventBatchLeft == 0 )
+    {
+        m_zoneEventBatch = m_slab.Alloc<ZoneEvent>( BatchSize );
+        m_zoneEventBatchLeft = BatchSize;
+    }
+    m_zoneEventBatchLeft--;
+    return m_zoneEventBatch++;
+}
+
+// Zones without children make up most of the data. When the zone end directly follows its begin, the zone is
+// completed at once, without going through the zone stacks of the thread. Anything else, including the cases
+// which would fail the zone validation, is left to the regular path.
+bool Worker::ProcessLeafZone( const char*& ptr, const char* end )
+{
+    const auto& begin = ((const QueueItem*)ptr)->zoneBegin;
+    auto next = ptr + QueueDataSize[(int)QueueType::ZoneBegin];
+    uint32_t zoneId = 0;
+    uint64_t events = 2;
+    if( next < end && ((const QueueItem*)next)->hdr.type == QueueType::ZoneValidation )
+    {
+        zoneId = ((const QueueItem*)next)->zoneValidation.id;
+        next += QueueDataSize[(int)QueueType::ZoneValidation];
+        events++;
+    }
+    if( next >= end || ((const QueueItem*)next)->hdr.type != QueueType::ZoneEnd ) return false;
+    auto td = GetCurrentThreadData();
+    if( td->nextZoneId != zoneId ) return false;
+
+    const auto& zoneEnd = ((const QueueItem*)next)->zoneEnd;
+    ptr = next + QueueDataSize[(int)QueueType::ZoneEnd];
+    m_eventCount += events - 1;
+
+    CheckSourceLocation( begin.srcloc );
+    const auto srcloc = ShrinkSourceLocation( begin.srcloc );
+    const auto start = TscTime( RefTime( m_refTimeThread, begin.time ) );
+    const auto timeEnd = TscTime( RefTime( m_refTimeThread, zoneEnd.time ) );
+    assert( timeEnd >= start );
+
+    auto zone = AllocZoneEvent();
+    zone->SetStartSrcLoc( start, srcloc );
+    zone->SetEnd( timeEnd );
+    zone->SetChild( -1 );
+
+    if( m_data.lastTime < timeEnd ) m_data.lastTime = timeEnd;
+
+    m_data.zonesCnt++;
+    td->count++;
+    td->nextZoneId = 0;
+    const auto ssz = td->stack.size();
+    if( ssz == 0 )
+    {
+        td->timeline.push_back( zone );
+    }
+    else
+    {
+        AppendZoneChild( td->stack.data()[ssz-1], zone );
+    }
+
+#ifndef TRACY_NO_STATISTICS
+    const auto timeSpan = timeEnd - start;
+    if( timeSpan > 0 )
+    {
+        if( !td->childTimeStack.empty() ) td->childTimeStack.back() += timeSpan;
+        AddZoneStatistics( zone, CompressThread( td->id ), timeSpan, timeSpan, td->stackCount[uint16_t( srcloc )] != 0 );
+    }
+#else
+    CountZoneStatistics( zone );
+#endif
+    return true;
+}
+
+void Worker::ProcessZoneBegin( const QueueZoneBegin& ev )
+{
+    auto zone = AllocZoneEvent();
+    ProcessZoneBeginImpl( zone, ev );
+}
+
+void Worker::ProcessZoneBeginCallstack( const QueueZoneBegin& ev )
+{
+    auto zone = AllocZoneEvent();
+    ProcessZoneBeginImpl( zone, ev );
+    auto td = GetCurrentThreadData();
+    auto it = m_nextCallstack.find( td->id );
+    assert( it != m_nextCallstack.end() );
+    auto& extra = RequestZoneExtra( *zone );
+    extra.callstack.SetVal( it->second );
+    it->second = 0;
+}
+
+void Worker::ProcessZoneBeginAllocSrcLoc( const QueueZoneBeginLean& ev )
+{
+    auto zone = AllocZoneEvent();
+    ProcessZoneBeginAllocSrcLocImpl( zone, ev );
+}
+
+void Worker::ProcessZoneBeginAllocSrcLocCallstack( const QueueZoneBeginLean& ev )
+{
+    auto zone = AllocZoneEvent();
+    ProcessZoneBeginAllocSrcLocImpl( zone, ev );
+    auto td = GetCurrentThreadData();
+    auto it = m_nextCallstack.find( td->id );
+    assert( it != m_nextCallstack.end() );
+    auto& extra = RequestZoneExtra( *zone );
+    extra.callstack.SetVal( it->second );
+    it->second = 0;
+}
+
+void Worker::ProcessZoneEnd( const QueueZoneEnd& ev )
+{
+    auto td = GetCurrentThreadData();
+    if( td->zoneIdStack.empty() )
+    {
+        if( m_windowReplay )
+        {
+            // The zone was started before the beginning of the flight recording.
+            td->nextZoneId = 0;
+            RefTime( m_refTimeThread, ev.time );
+            return;
+        }
+        ZoneDoubleEndFailure( td->id, td->timeline.empty() ? nullptr : td->timeline.back() );
+        return;
+    }
+    auto zoneId = td->zoneIdStack.back_and_pop();
+    if( zoneId != td->nextZoneId )
+    {
+        ZoneStackFailure( td->id, td->stack.back() );
+        return;
+    }
+    td->nextZoneId = 0;
+
+    auto& stack = td->stack;
+    assert( !stack.empty() );
+    auto zone = stack.back_and_pop();
+    assert( zone->End() == -1 );
+    const auto isReentry = td->DecStackCount( zone->SrcLoc() );
+    const auto timeEnd = TscTime( RefTime( m_refTimeThread, ev.time ) );
     zone->SetEnd( timeEnd );
     assert( timeEnd >= zone->Start() );
 
@@ -4842,7 +6953,229 @@ void Worker::ProcessZoneEnd( const QueueZoneEnd& ev )
             }
 #endif
             fitVec.swap( childVec );
-            m_data.zoneVectorCache.push_back( std::move( fitVec ) );
+            m_data.zoneVectorCache.push_back( std::move( fitVec ) );
+        }
+    }
+
+#ifndef TRACY_NO_STATISTICS
+    assert( !td->childTimeStack.empty() );
+    const auto timeSpan = timeEnd - zone->Start();
+    if( timeSpan > 0 )
+    {
+        const auto selfSpan = timeSpan - td->childTimeStack.back_and_pop();
+        if( !td->childTimeStack.empty() )
+        {
+            td->childTimeStack.back() += timeSpan;
+        }
+        AddZoneStatistics( zone, CompressThread( td->id ), timeSpan, selfSpan, isReentry );
+    }
+    else
+    {
+        td->childTimeStack.pop_back();
+    }
+#else
+    CountZoneStatistics( zone );
+#endif
+}
+
+#ifndef TRACY_NO_STATISTICS
+void Worker::AddZoneStatistics( ZoneEvent* zone, uint16_t thread, int64_t timeSpan, int64_t selfSpan, bool isReentry )
+{
+    ZoneThreadData ztd;
+    ztd.SetZone( zone );
+    ztd.SetThread( thread );
+
+    auto slz = GetSourceLocationZones( zone->SrcLoc() );
+    slz->zones.push_back( ztd );
+    if( slz->min > timeSpan ) slz->min = timeSpan;
+    if( slz->max < timeSpan ) slz->max = timeSpan;
+    slz->total += timeSpan;
+    slz->sumSq += double( timeSpan ) * timeSpan;
+    if( slz->selfMin > selfSpan ) slz->selfMin = selfSpan;
+    if( slz->selfMax < selfSpan ) slz->selfMax = selfSpan;
+    slz->selfTotal += selfSpan;
+
+    if( !isReentry )
+    {
+        slz->nonReentrantCount++;
+        if( slz->nonReentrantMin > timeSpan ) slz->nonReentrantMin = timeSpan;
+        if( slz->nonReentrantMax < timeSpan ) slz->nonReentrantMax = timeSpan;
+        slz->nonReentrantTotal += timeSpan;
+    }
+
+    auto it = slz->threadCnt.find( thread );
+    if( it == slz->threadCnt.end() )
+    {
+        slz->threadCnt.emplace( thread, 1 );
+    }
+    else
+    {
+        it->second++;
+    }
+}
+#endif
+
+void Worker::RunIngestJob( IngestJob& job, IngestContext& ctx )
+{
+    for( auto& v : job.events )
+    {
+        const auto& ev = *v.ev;
+        switch( ev.hdr.type )
+        {
+        case QueueType::ThreadContext:
+            job.refTime = 0;
+            break;
+        case QueueType::ZoneBegin:
+            IngestZoneBegin( job, ctx, ev.zoneBegin, v.srcloc );
+            break;
+        case QueueType::ZoneEnd:
+            if( !IngestZoneEnd( job, ctx, ev.zoneEnd ) ) return;
+            break;
+        case QueueType::ZoneValidation:
+            job.td->nextZoneId = ev.zoneValidation.id;
+            break;
+        default:
+            assert( false );
+            break;
+        }
+    }
+}
+
+Vector<short_ptr<ZoneEvent>>& Worker::GetIngestChildren( IngestJob& job, int32_t idx )
+{
+    // Child vectors created by the job are kept aside until the merge, as m_data.zoneChildren is shared.
+    if( idx >= job.childBase ) return job.children[idx - job.childBase];
+    return m_data.zoneChildren[idx];
+}
+
+void Worker::IngestZoneBegin( IngestJob& job, IngestContext& ctx, const QueueZoneBegin& ev, int16_t srcloc )
+{
+    ZoneEvent* zone;
+#ifndef TRACY_NO_STATISTICS
+    zone = ctx.slab.Alloc<ZoneEvent>();
+#else
+    if( ctx.zoneEventPool.empty() )
+    {
+        zone = ctx.slab.Alloc<ZoneEvent>();
+    }
+    else
+    {
+        zone = ctx.zoneEventPool.back_and_pop();
+    }
+#endif
+    zone->extra = 0;
+
+    const auto start = TscTime( RefTime( job.refTime, ev.time ) );
+    zone->SetStartSrcLoc( start, srcloc );
+    zone->SetEnd( -1 );
+    zone->SetChild( -1 );
+
+    if( job.lastTime < start ) job.lastTime = start;
+
+    job.zonesCnt++;
+
+    auto td = job.td;
+    td->count++;
+    td->IncStackCount( srcloc );
+    const auto ssz = td->stack.size();
+    if( ssz == 0 )
+    {
+        td->stack.push_back( zone );
+        td->timeline.push_back( zone );
+    }
+    else
+    {
+        auto& back = td->stack.data()[ssz-1];
+        if( !back->HasChildren() )
+        {
+            back->SetChild( job.childBase + int32_t( job.children.size() ) );
+            job.childParents.push_back( back );
+            if( ctx.vectorCache.empty() )
+            {
+                job.children.push_back( Vector<short_ptr<ZoneEvent>>( zone ) );
+            }
+            else
+            {
+                Vector<short_ptr<ZoneEvent>> vze = std::move( ctx.vectorCache.back_and_pop() );
+                assert( !vze.empty() );
+                vze.clear();
+                vze.push_back_non_empty( zone );
+                job.children.push_back( std::move( vze ) );
+            }
+        }
+        else
+        {
+            auto& children = GetIngestChildren( job, back->Child() );
+            assert( !children.empty() );
+            children.push_back_non_empty( zone );
+        }
+        td->stack.push_back_non_empty( zone );
+    }
+
+    td->zoneIdStack.push_back( td->nextZoneId );
+    td->nextZoneId = 0;
+
+#ifndef TRACY_NO_STATISTICS
+    td->childTimeStack.push_back( 0 );
+#endif
+}
+
+bool Worker::IngestZoneEnd( IngestJob& job, IngestContext& ctx, const QueueZoneEnd& ev )
+{
+    auto td = job.td;
+    if( td->zoneIdStack.empty() )
+    {
+        job.failure = Failure::ZoneDoubleEnd;
+        job.failureSrcloc = td->timeline.empty() ? 0 : td->timeline.back()->SrcLoc();
+        return false;
+    }
+    auto zoneId = td->zoneIdStack.back_and_pop();
+    if( zoneId != td->nextZoneId )
+    {
+        job.failure = Failure::ZoneStack;
+        job.failureSrcloc = td->stack.back()->SrcLoc();
+        return false;
+    }
+    td->nextZoneId = 0;
+
+    auto& stack = td->stack;
+    assert( !stack.empty() );
+    auto zone = stack.back_and_pop();
+    assert( zone->End() == -1 );
+    const auto isReentry = td->DecStackCount( zone->SrcLoc() );
+    const auto timeEnd = TscTime( RefTime( job.refTime, ev.time ) );
+    zone->SetEnd( timeEnd );
+    assert( timeEnd >= zone->Start() );
+
+    if( job.lastTime < timeEnd ) job.lastTime = timeEnd;
+
+    if( zone->HasChildren() )
+    {
+        auto& childVec = GetIngestChildren( job, zone->Child() );
+        const auto sz = childVec.size();
+        if( sz <= 8 * 1024 )
+        {
+            Vector<short_ptr<ZoneEvent>> fitVec;
+#ifndef TRACY_NO_STATISTICS
+            fitVec.reserve_exact( sz, ctx.slab );
+            memcpy( fitVec.data(), childVec.data(), sz * sizeof( short_ptr<ZoneEvent> ) );
+#else
+            fitVec.set_magic();
+            auto& fv = *((Vector<ZoneEvent>*)&fitVec);
+            fv.reserve_exact( sz, ctx.slab );
+            auto dst = fv.data();
+            for( auto& ze : childVec )
+            {
+                ZoneEvent* src = ze;
+                memcpy( dst, src, sizeof( ZoneEvent ) );
+                // The zone has moved, the merge has to patch its new location.
+                if( dst->HasChildren() && dst->Child() >= job.childBase ) job.childParents[dst->Child() - job.childBase] = dst;
+                dst++;
+                ctx.zoneEventPool.push_back( src );
+            }
+#endif
+            fitVec.swap( childVec );
+            ctx.vectorCache.push_back( std::move( fitVec ) );
         }
     }
 
@@ -4851,51 +7184,21 @@ void Worker::ProcessZoneEnd( const QueueZoneEnd& ev )
     const auto timeSpan = timeEnd - zone->Start();
     if( timeSpan > 0 )
     {
-        const auto ctid = CompressThread( td->id );
-        ZoneThreadData ztd;
-        ztd.SetZone( zone );
-        ztd.SetThread( ctid );
-
-        auto slz = GetSourceLocationZones( zone->SrcLoc() );
-        slz->zones.push_back( ztd );
-        if( slz->min > timeSpan ) slz->min = timeSpan;
-        if( slz->max < timeSpan ) slz->max = timeSpan;
-        slz->total += timeSpan;
-        slz->sumSq += double( timeSpan ) * timeSpan;
         const auto selfSpan = timeSpan - td->childTimeStack.back_and_pop();
-        if( slz->selfMin > selfSpan ) slz->selfMin = selfSpan;
-        if( slz->selfMax < selfSpan ) slz->selfMax = selfSpan;
-        slz->selfTotal += selfSpan;
-
-        if( !isReentry )
-        {
-            slz->nonReentrantCount++;
-            if( slz->nonReentrantMin > timeSpan ) slz->nonReentrantMin = timeSpan;
-            if( slz->nonReentrantMax < timeSpan ) slz->nonReentrantMax = timeSpan;
-            slz->nonReentrantTotal += timeSpan;
-        }
         if( !td->childTimeStack.empty() )
         {
             td->childTimeStack.back() += timeSpan;
         }
-
-        auto it = slz->threadCnt.find( ctid );
-        if( it == slz->threadCnt.end() )
-        {
-            slz->threadCnt.emplace( ctid, 1 );
-        }
-        else
-        {
-            it->second++;
-        }
+        job.stats.push_back( IngestZoneStat { zone, selfSpan, isReentry } );
     }
     else
     {
         td->childTimeStack.pop_back();
     }
 #else
-    CountZoneStatistics( zone );
+    job.stats.push_back( zone->SrcLoc() );
 #endif
+    return true;
 }
 
 void Worker::ZoneStackFailure( uint64_t thread, const ZoneEvent* ev )
@@ -5119,6 +7422,11 @@ void Worker::ProcessFrameVsync( const QueueFrameVsync& ev )
 
 void Worker::ProcessFrameImage( const QueueFrameImage& ev )
 {
+    if( m_memoryBudget != MemoryBudget::Normal )
+    {
+        m_pendingFrameImageData.image = nullptr;
+        return;
+    }
     assert( m_pendingFrameImageData.image != nullptr );
 
     auto& frames = m_data.framesBase->frames;
@@ -5168,12 +7476,17 @@ void Worker::ProcessFrameImage( const QueueFrameImage& ev )
 void Worker::ProcessZoneText()
 {
     auto td = RetrieveThread( m_threadCtx );
+    if( td && td->fiber ) td = td->fiber;
+    if( m_windowReplay && ( !td || td->stack.empty() ) )
+    {
+        GetSingleStringIdx();
+        return;
+    }
     if( !td )
     {
         ZoneTextFailure( m_threadCtx, m_pendingSingleString.ptr );
         return;
     }
-    if( td->fiber ) td = td->fiber;
     if( td->stack.empty() || td->nextZoneId != td->zoneIdStack.back() )
     {
         ZoneTextFailure( td->id, m_pendingSingleString.ptr );
@@ -5215,12 +7528,17 @@ void Worker::ProcessZoneText()
 void Worker::ProcessZoneName()
 {
     auto td = RetrieveThread( m_threadCtx );
+    if( td && td->fiber ) td = td->fiber;
+    if( m_windowReplay && ( !td || td->stack.empty() ) )
+    {
+        GetSingleStringIdx();
+        return;
+    }
     if( !td )
     {
         ZoneNameFailure( m_threadCtx );
         return;
     }
-    if( td->fiber ) td = td->fiber;
     if( td->stack.empty() || td->nextZoneId != td->zoneIdStack.back() )
     {
         ZoneNameFailure( td->id );
@@ -5237,12 +7555,13 @@ void Worker::ProcessZoneName()
 void Worker::ProcessZoneColor( const QueueZoneColor& ev )
 {
     auto td = RetrieveThread( m_threadCtx );
+    if( td && td->fiber ) td = td->fiber;
+    if( m_windowReplay && ( !td || td->stack.empty() ) ) return;
     if( !td )
     {
         ZoneColorFailure( m_threadCtx );
         return;
     }
-    if( td->fiber ) td = td->fiber;
     if( td->stack.empty() || td->nextZoneId != td->zoneIdStack.back() )
     {
         ZoneColorFailure( td->id );
@@ -5263,12 +7582,13 @@ void Worker::ProcessZoneValue( const QueueZoneValue& ev )
     const auto tsz = sprintf( tmp, "%" PRIu64, ev.value );
 
     auto td = RetrieveThread( m_threadCtx );
+    if( td && td->fiber ) td = td->fiber;
+    if( m_windowReplay && ( !td || td->stack.empty() ) ) return;
     if( !td )
     {
         ZoneValueFailure( m_threadCtx, ev.value );
         return;
     }
-    if( td->fiber ) td = td->fiber;
     if( td->stack.empty() || td->nextZoneId != td->zoneIdStack.back() )
     {
         ZoneValueFailure( td->id, ev.value );
@@ -5362,8 +7682,11 @@ void Worker::ProcessLockRelease( const QueueLockRelease& ev )
     assert( it != m_data.lockMap.end() );
     auto& lock = *it->second;
 
-    auto lev = lock.type == LockType::Lockable ? m_slab.Alloc<LockEvent>() : m_slab.Alloc<LockEventShared>();
     const auto time = TscTime( RefTime( m_refTimeSerial, ev.time ) );
+    // The lock may have been obtained before the beginning of the flight recording.
+    if( m_windowReplay && ( lock.timeline.empty() || lock.timeline.back().lockCount == 0 ) ) return;
+
+    auto lev = lock.type == LockType::Lockable ? m_slab.Alloc<LockEvent>() : m_slab.Alloc<LockEventShared>();
     lev->SetTime( time );
     lev->SetSrcLoc( 0 );
     lev->type = LockEvent::Type::Release;
@@ -5475,7 +7798,15 @@ void Worker::ProcessPlotDataDouble( const QueuePlotDataDouble& ev )
 
 void Worker::ProcessPlotDataImpl( uint64_t name, int64_t evTime, double val )
 {
-    PlotData* plot = m_data.plots.Retrieve( name, [this] ( uint64_t name ) {
+    PlotData* plot = RetrieveUserPlot( name );
+    const auto time = TscTime( RefTime( m_refTimeThread, evTime ) );
+    if( m_data.lastTime < time ) m_data.lastTime = time;
+    InsertPlot( plot, time, val );
+}
+
+PlotData* Worker::RetrieveUserPlot( uint64_t name )
+{
+    return m_data.plots.Retrieve( name, [this] ( uint64_t name ) {
         auto plot = m_slab.AllocInit<PlotData>();
         plot->name = name;
         plot->type = PlotType::User;
@@ -5487,10 +7818,6 @@ void Worker::ProcessPlotDataImpl( uint64_t name, int64_t evTime, double val )
     }, [this]( uint64_t name ) {
         Query( ServerQueryPlotName, name );
     } );
-
-    const auto time = TscTime( RefTime( m_refTimeThread, evTime ) );
-    if( m_data.lastTime < time ) m_data.lastTime = time;
-    InsertPlot( plot, time, val );
 }
 
 void Worker::ProcessPlotConfig( const QueuePlotConfig& ev )
@@ -5995,11 +8322,9 @@ MemEvent* Worker::ProcessMemFreeImpl( MemData& memdata, const QueueMemFree& ev )
     {
         if( ev.ptr == 0 ) return nullptr;
 
-        if( !m_ignoreMemFreeFaults )
-        {
-            CheckThreadString( ev.thread );
-            MemFreeFailure( ev.thread );
-        }
+        // The thread name is expected even if the fault is ignored, as the recorded event stream may hold it.
+        CheckThreadString( ev.thread );
+        if( !m_ignoreMemFreeFaults ) MemFreeFailure( ev.thread );
         return nullptr;
     }
 
@@ -6024,6 +8349,11 @@ MemEvent* Worker::ProcessMemAlloc( const QueueMemAlloc& ev )
 }
 
 MemEvent* Worker::ProcessMemAllocNamed( const QueueMemAlloc& ev )
+{
+    return ProcessMemAllocImpl( ConsumeMemNamePayload(), ev );
+}
+
+MemData& Worker::ConsumeMemNamePayload()
 {
     assert( m_memNamePayload != 0 );
     auto memname = m_memNamePayload;
@@ -6035,7 +8365,7 @@ MemEvent* Worker::ProcessMemAllocNamed( const QueueMemAlloc& ev )
         it = m_data.memNameMap.emplace( memname, m_slab.AllocInit<MemData>() ).first;
         it->second->name = memname;
     }
-    return ProcessMemAllocImpl( *it->second, ev );
+    return *it->second;
 }
 
 MemEvent* Worker::ProcessMemFree( const QueueMemFree& ev )
@@ -6046,17 +8376,7 @@ MemEvent* Worker::ProcessMemFree( const QueueMemFree& ev )
 
 MemEvent* Worker::ProcessMemFreeNamed( const QueueMemFree& ev )
 {
-    assert( m_memNamePayload != 0 );
-    auto memname = m_memNamePayload;
-    m_memNamePayload = 0;
-    auto it = m_data.memNameMap.find( memname );
-    if( it == m_data.memNameMap.end() )
-    {
-        CheckString( memname );
-        it = m_data.memNameMap.emplace( memname, m_slab.AllocInit<MemData>() ).first;
-        it->second->name = memname;
-    }
-    return ProcessMemFreeImpl( *it->second, ev );
+    return ProcessMemFreeImpl( ConsumeMemNamePayload(), ev );
 }
 
 void Worker::ProcessMemAllocCallstack( const QueueMemAlloc& ev )
@@ -6069,17 +8389,7 @@ void Worker::ProcessMemAllocCallstack( const QueueMemAlloc& ev )
 
 void Worker::ProcessMemAllocCallstackNamed( const QueueMemAlloc& ev )
 {
-    assert( m_memNamePayload != 0 );
-    auto memname = m_memNamePayload;
-    m_memNamePayload = 0;
-    auto it = m_data.memNameMap.find( memname );
-    if( it == m_data.memNameMap.end() )
-    {
-        CheckString( memname );
-        it = m_data.memNameMap.emplace( memname, m_slab.AllocInit<MemData>() ).first;
-        it->second->name = memname;
-    }
-    auto mem = ProcessMemAllocImpl( *it->second, ev );
+    auto mem = ProcessMemAllocImpl( ConsumeMemNamePayload(), ev );
     assert( m_serialNextCallstack != 0 );
     if( mem ) mem->SetCsAlloc( m_serialNextCallstack );
     m_serialNextCallstack = 0;
@@ -6095,17 +8405,7 @@ void Worker::ProcessMemFreeCallstack( const QueueMemFree& ev )
 
 void Worker::ProcessMemFreeCallstackNamed( const QueueMemFree& ev )
 {
-    assert( m_memNamePayload != 0 );
-    auto memname = m_memNamePayload;
-    m_memNamePayload = 0;
-    auto it = m_data.memNameMap.find( memname );
-    if( it == m_data.memNameMap.end() )
-    {
-        CheckString( memname );
-        it = m_data.memNameMap.emplace( memname, m_slab.AllocInit<MemData>() ).first;
-        it->second->name = memname;
-    }
-    auto mem = ProcessMemFreeImpl( *it->second, ev );
+    auto mem = ProcessMemFreeImpl( ConsumeMemNamePayload(), ev );
     assert( m_serialNextCallstack != 0 );
     if( mem ) mem->csFree.SetVal( m_serialNextCallstack );
     m_serialNextCallstack = 0;
@@ -6195,6 +8495,7 @@ void Worker::ProcessCallstackSampleImpl( const SampleData& sd, ThreadData& td )
             else if( sd.time.Val() == it->Start() )
             {
                 td.ctxSwitchSamples.push_back( sd );
+                QueueThreadWaitTime( td );
             }
             else
             {
@@ -6376,6 +8677,10 @@ void Worker::ProcessCallstackSampleContextSwitch( const QueueCallstackSample& ev
     ProcessCallstackSampleInsertSample( sd, td );
 
     td.ctxSwitchSamples.push_back( sd );
+#ifndef TRACY_NO_STATISTICS
+    QueueThreadWaitTime( td );
+    m_data.newContextSwitchesReceived = true;
+#endif
 }
 
 void Worker::ProcessCallstackFrameSize( const QueueCallstackFrameSize& ev )
@@ -6536,7 +8841,7 @@ void Worker::ProcessSymbolInformation( const QueueSymbolInformation& ev )
     sd.size.SetVal( it->second.size );
     m_data.symbolMap.emplace( ev.symAddr, sd );
 
-    if( m_codeTransfer && it->second.size > 0 && it->second.size <= 128*1024 )
+    if( m_codeTransfer && m_memoryBudget == MemoryBudget::Normal && it->second.size > 0 && it->second.size <= 128*1024 )
     {
         m_pendingSymbolCode++;
         Query( ServerQuerySymbolCode, ev.symAddr, it->second.size );
@@ -6816,6 +9121,37 @@ void Worker::ProcessHwSampleBranchMiss( const QueueHwSample& ev )
     it->second.branchMiss.push_back( time );
 }
 
+void Worker::ProcessHwSampleGroup( const QueueHwSampleGroup& ev )
+{
+    const auto time = ev.time == 0 ? 0 : TscTime( ev.time );
+    auto it = m_data.hwSamples.find( ev.ip );
+    if( it == m_data.hwSamples.end() ) it = m_data.hwSamples.emplace( ev.ip, HwSampleData {} ).first;
+    auto& hw = it->second;
+    switch( ev.group )
+    {
+    case HwSampleGroupType::Retirement:
+        hw.cycles.push_back( time );
+        hw.counters.cycles += ev.leader;
+        hw.counters.retired += ev.member;
+        break;
+    case HwSampleGroupType::Cache:
+        hw.cacheRef.push_back( time );
+        hw.counters.cacheRef += ev.leader;
+        hw.counters.cacheMiss += ev.member;
+        break;
+    case HwSampleGroupType::Branch:
+        hw.branchRetired.push_back( time );
+        hw.counters.branchRetired += ev.leader;
+        hw.counters.branchMiss += ev.member;
+        m_data.hasBranchRetirement = true;
+        break;
+    default:
+        assert( false );
+        break;
+    }
+    m_data.hasHwSampleCounters = true;
+}
+
 void Worker::ProcessParamSetup( const QueueParamSetup& ev )
 {
     CheckString( ev.name );
@@ -6966,7 +9302,7 @@ void Worker::ReconstructMemAllocPlot( MemData& mem )
 
     PlotData* plot;
     {
-        std::lock_guard<std::mutex> lock( m_data.lock );
+        std::lock_guard<DataLock> lock( m_data.lock );
         plot = m_slab.AllocInit<PlotData>();
         plot->data.reserve_exact( psz, m_slab );
     }
@@ -7059,7 +9395,7 @@ void Worker::ReconstructMemAllocPlot( MemData& mem )
     plot->max = max;
     plot->sum = sum;
 
-    std::lock_guard<std::mutex> lock( m_data.lock );
+    std::lock_guard<DataLock> lock( m_data.lock );
     m_data.plots.Data().insert( m_data.plots.Data().begin(), plot );
     mem.plot = plot;
 }
@@ -7156,7 +9492,7 @@ void Worker::ReconstructContextSwitchUsage()
         }
     }
 
-    std::lock_guard<std::mutex> lock( m_data.lock );
+    std::lock_guard<DataLock> lock( m_data.lock );
     m_data.ctxUsageReady = true;
 }
 
@@ -7228,6 +9564,35 @@ void Worker::UpdateSampleStatisticsPostponed( decltype(Worker::DataBlock::postpo
 
 void Worker::UpdateSampleStatisticsImpl( const CallstackFrameData** frames, uint16_t framesCount, uint32_t count, const VarArray<CallstackFrameId>& cs )
 {
+    if( ( GetCanonicalPointer( cs[0] ) >> 63 ) != 0 )
+    {
+        // Attribute kernel samples to the user space function which entered the kernel.
+        // Samples of kernel threads, which have no user space frames, go to address 0.
+        m_data.kernelSamples += count;
+        uint64_t entry = 0;
+        for( uint16_t c=1; c<framesCount; c++ )
+        {
+            if( ( GetCanonicalPointer( cs[c] ) >> 63 ) == 0 )
+            {
+                entry = frames[c]->data[0].symAddr;
+                break;
+            }
+        }
+        auto it = m_data.kernelEntryStats.find( entry );
+        if( it == m_data.kernelEntryStats.end() )
+        {
+            m_data.kernelEntryStats.emplace( entry, count );
+        }
+        else
+        {
+            it->second += count;
+        }
+    }
+    else
+    {
+        m_data.userSamples += count;
+    }
+
     const auto fexcl = frames[0];
     const auto fxsz = fexcl->size;
     const auto& frame0 = fexcl->data[0];
@@ -7389,7 +9754,8 @@ int64_t Worker::ReadTimeline( FileRead& f, ZoneEvent* zone, int64_t refTime, int
     return ReadTimelineHaveSize( f, zone, refTime, childIdx, sz );
 }
 
-int64_t Worker::ReadTimelineHaveSize( FileRead& f, ZoneEvent* zone, int64_t refTime, int32_t& childIdx, uint32_t sz )
+template<typename R>
+int64_t Worker::ReadTimelineHaveSize( R& f, ZoneEvent* zone, int64_t refTime, int32_t& childIdx, uint32_t sz )
 {
     if( sz == 0 )
     {
@@ -7399,6 +9765,7 @@ int64_t Worker::ReadTimelineHaveSize( FileRead& f, ZoneEvent* zone, int64_t refT
     else
     {
         const auto idx = childIdx;
+        if constexpr( std::is_same<R, TimelineRead>::value ) f.CheckChild( idx );
         childIdx++;
         zone->SetChild( idx );
         return ReadTimeline( f, m_data.zoneChildren[idx], sz, refTime, childIdx );
@@ -7412,7 +9779,8 @@ void Worker::ReadTimeline( FileRead& f, GpuEvent* zone, int64_t& refTime, int64_
     ReadTimelineHaveSize( f, zone, refTime, refGpuTime, childIdx, sz );
 }
 
-void Worker::ReadTimelineHaveSize( FileRead& f, GpuEvent* zone, int64_t& refTime, int64_t& refGpuTime, int32_t& childIdx, uint64_t sz )
+template<typename R>
+void Worker::ReadTimelineHaveSize( R& f, GpuEvent* zone, int64_t& refTime, int64_t& refGpuTime, int32_t& childIdx, uint64_t sz )
 {
     if( sz == 0 )
     {
@@ -7421,6 +9789,7 @@ void Worker::ReadTimelineHaveSize( FileRead& f, GpuEvent* zone, int64_t& refTime
     else
     {
         const auto idx = childIdx;
+        if constexpr( std::is_same<R, TimelineRead>::value ) f.CheckChild( idx );
         childIdx++;
         zone->SetChild( idx );
         ReadTimeline( f, m_data.gpuChildren[idx], sz, refTime, refGpuTime, childIdx );
@@ -7520,14 +9889,14 @@ void Worker::CountZoneStatistics( GpuEvent* zone )
 }
 #endif
 
-int64_t Worker::ReadTimeline( FileRead& f, Vector<short_ptr<ZoneEvent>>& _vec, uint32_t size, int64_t refTime, int32_t& childIdx )
+template<typename R>
+int64_t Worker::ReadTimeline( R& f, Vector<short_ptr<ZoneEvent>>& _vec, uint32_t size, int64_t refTime, int32_t& childIdx )
 {
     assert( size != 0 );
-    const auto lp = s_loadProgress.subProgress.load( std::memory_order_relaxed );
-    s_loadProgress.subProgress.store( lp + size, std::memory_order_relaxed );
+    s_loadProgress.subProgress.fetch_add( size, std::memory_order_relaxed );
     auto& vec = *(Vector<ZoneEvent>*)( &_vec );
     vec.set_magic();
-    vec.reserve_exact( size, m_slab );
+    vec.set_external( AllocTimeline<ZoneEvent>( f, m_slab, size ), size );
     auto zone = vec.begin();
     auto end = vec.end() - 1;
 
@@ -7546,7 +9915,7 @@ int64_t Worker::ReadTimeline( FileRead& f, Vector<short_ptr<ZoneEvent>>& _vec, u
         refTime += tend;
         zone->SetEnd( refTime );
 #ifdef TRACY_NO_STATISTICS
-        CountZoneStatistics( zone );
+        if constexpr( std::is_same<R, FileRead>::value ) CountZoneStatistics( zone );
 #endif
         zone++;
     }
@@ -7559,20 +9928,20 @@ int64_t Worker::ReadTimeline( FileRead& f, Vector<short_ptr<ZoneEvent>>& _vec, u
     refTime += tend;
     zone->SetEnd( refTime );
 #ifdef TRACY_NO_STATISTICS
-    CountZoneStatistics( zone );
+    if constexpr( std::is_same<R, FileRead>::value ) CountZoneStatistics( zone );
 #endif
 
     return refTime;
 }
 
-void Worker::ReadTimeline( FileRead& f, Vector<short_ptr<GpuEvent>>& _vec, uint64_t size, int64_t& refTime, int64_t& refGpuTime, int32_t& childIdx )
+template<typename R>
+void Worker::ReadTimeline( R& f, Vector<short_ptr<GpuEvent>>& _vec, uint64_t size, int64_t& refTime, int64_t& refGpuTime, int32_t& childIdx )
 {
     assert( size != 0 );
-    const auto lp = s_loadProgress.subProgress.load( std::memory_order_relaxed );
-    s_loadProgress.subProgress.store( lp + size, std::memory_order_relaxed );
+    s_loadProgress.subProgress.fetch_add( size, std::memory_order_relaxed );
     auto& vec = *(Vector<GpuEvent>*)( &_vec );
     vec.set_magic();
-    vec.reserve_exact( size, m_slab );
+    vec.set_external( AllocTimeline<GpuEvent>( f, m_slab, size ), size );
     auto zone = vec.begin();
     auto end = vec.end();
     do
@@ -7600,6 +9969,206 @@ void Worker::ReadTimeline( FileRead& f, Vector<short_ptr<GpuEvent>>& _vec, uint6
     while( ++zone != end );
 }
 
+template<typename C>
+void Worker::ReadTimelineColumns( C& f, Vector<short_ptr<ZoneEvent>>& _vec, uint32_t size, int64_t refTime, int32_t& childIdx )
+{
+    assert( size != 0 );
+    s_loadProgress.subProgress.fetch_add( size, std::memory_order_relaxed );
+    auto& vec = *(Vector<ZoneEvent>*)( &_vec );
+    vec.set_magic();
+    vec.set_external( f.template Alloc<ZoneEvent>( size ), size );
+    for( auto& zone : vec )
+    {
+        const auto srcloc = int16_t( f.ReadSigned( ZoneColumnSrcLoc ) );
+        const auto start = refTime + f.ReadSigned( ZoneColumnStart );
+        zone.SetStartSrcLoc( start, srcloc );
+        zone.extra = uint32_t( f.Read( ZoneColumnExtra ) );
+        const auto childSz = uint32_t( f.Read( ZoneColumnChildren ) );
+        if( childSz == 0 )
+        {
+            zone.SetChild( -1 );
+        }
+        else
+        {
+            const auto idx = childIdx;
+            f.CheckChild( idx );
+            childIdx++;
+            zone.SetChild( idx );
+            ReadTimelineColumns( f, m_data.zoneChildren[idx], childSz, start, childIdx );
+        }
+        refTime = start + f.ReadSigned( ZoneColumnDuration );
+        zone.SetEnd( refTime );
+    }
+}
+
+template<typename C>
+void Worker::ReadTimelineColumns( C& f, Vector<short_ptr<GpuEvent>>& _vec, uint64_t size, int64_t refTime, int64_t refGpuTime, int32_t& childIdx )
+{
+    assert( size != 0 );
+    s_loadProgress.subProgress.fetch_add( size, std::memory_order_relaxed );
+    auto& vec = *(Vector<GpuEvent>*)( &_vec );
+    vec.set_magic();
+    vec.set_external( f.template Alloc<GpuEvent>( size ), size );
+    for( auto& zone : vec )
+    {
+        const auto cpuStart = refTime + f.ReadSigned( GpuColumnCpuStart );
+        const auto gpuStart = refGpuTime + f.ReadSigned( GpuColumnGpuStart );
+        zone.SetCpuStart( cpuStart );
+        zone.SetGpuStart( gpuStart );
+        zone.SetSrcLoc( int16_t( f.ReadSigned( GpuColumnSrcLoc ) ) );
+        zone.callstack.SetVal( uint32_t( f.Read( GpuColumnCallstack ) ) );
+        zone.SetThread( uint16_t( f.Read( GpuColumnThread ) ) );
+        const auto childSz = f.Read( GpuColumnChildren );
+        if( childSz == 0 )
+        {
+            zone.SetChild( -1 );
+        }
+        else
+        {
+            const auto idx = childIdx;
+            f.CheckChild( idx );
+            childIdx++;
+            zone.SetChild( idx );
+            ReadTimelineColumns( f, m_data.gpuChildren[idx], childSz, cpuStart, gpuStart, childIdx );
+        }
+        refTime = cpuStart + f.ReadSigned( GpuColumnCpuDuration );
+        refGpuTime = gpuStart + f.ReadSigned( GpuColumnGpuDuration );
+        zone.SetCpuEnd( refTime );
+        zone.SetGpuEnd( refGpuTime );
+    }
+}
+
+const char* Worker::MapAnalysisCache()
+{
+    if( m_timelineSource.file.empty() ) return nullptr;
+    const auto fn = GetAnalysisCachePath( m_timelineSource.file );
+    struct stat64 buf;
+    if( stat64( fn.c_str(), &buf ) != 0 || uint64_t( buf.st_size ) < sizeof( AnalysisCacheHeader ) ) return nullptr;
+    const uint64_t size = buf.st_size;
+    FILE* f = fopen( fn.c_str(), "rb" );
+    if( !f ) return nullptr;
+    // Pages are shared with other processes which map the cache, until they are written to.
+    auto map = (char*)mmap( nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileno( f ), 0 );
+    fclose( f );
+    if( map == MAP_FAILED ) return nullptr;
+
+    auto hdr = (const AnalysisCacheHeader*)map;
+    const auto entries = hdr->threads + hdr->zoneChildren + hdr->gpuThreads + hdr->gpuChildren;
+    bool valid = memcmp( hdr->magic, AnalysisCacheMagic, sizeof( AnalysisCacheMagic ) ) == 0 &&
+        hdr->zoneEventSize == sizeof( ZoneEvent ) && hdr->gpuEventSize == sizeof( GpuEvent ) &&
+        hdr->traceSize == m_timelineSource.size && hdr->traceTime == m_timelineSource.time && hdr->traceHash == m_timelineSource.hash &&
+        sizeof( AnalysisCacheHeader ) + entries * sizeof( AnalysisCacheEntry ) <= hdr->zoneData &&
+        hdr->zoneData + hdr->zoneCount * sizeof( ZoneEvent ) <= hdr->gpuData &&
+        hdr->gpuData + hdr->gpuCount * sizeof( GpuEvent ) <= size;
+    if( valid )
+    {
+        auto entry = (const AnalysisCacheEntry*)( hdr + 1 );
+        for( uint64_t i=0; i<entries; i++ )
+        {
+            const auto count = i < hdr->threads + hdr->zoneChildren ? hdr->zoneCount : hdr->gpuCount;
+            if( entry[i].offset + entry[i].size > count )
+            {
+                valid = false;
+                break;
+            }
+        }
+    }
+    if( !valid )
+    {
+        munmap( map, size );
+        return nullptr;
+    }
+
+    m_cacheMap = map;
+    m_cacheMapSize = size;
+    return map;
+}
+
+bool Worker::WriteAnalysisCache() const
+{
+    if( m_timelineSource.file.empty() ) return false;
+    // The cache in use matches the trace, and it can't be overwritten while it is mapped.
+    if( m_cacheMap ) return true;
+    assert( m_timelineSource.threadEnd.size() == m_data.threads.size() );
+
+    std::vector<AnalysisCacheEntry> entries;
+    std::vector<const Vector<short_ptr<ZoneEvent>>*> zones;
+    std::vector<const Vector<short_ptr<GpuEvent>>*> gpuZones;
+    uint64_t zoneCount = 0;
+    for( size_t i=0; i<m_data.threads.size(); i++ )
+    {
+        auto& timeline = m_data.threads[i]->timeline;
+        entries.push_back( { zoneCount, timeline.size(), m_timelineSource.threadEnd[i] } );
+        zoneCount += timeline.size();
+        zones.push_back( &timeline );
+    }
+    for( auto& v : m_data.zoneChildren )
+    {
+        entries.push_back( { zoneCount, v.size(), 0 } );
+        zoneCount += v.size();
+        zones.push_back( &v );
+    }
+    uint64_t gpuCount = 0;
+    for( auto& v : m_timelineSource.gpu )
+    {
+        auto& threadData = m_data.gpuData[v.ctx]->threadData;
+        auto it = threadData.find( v.thread );
+        const auto tsz = it != threadData.end() ? it->second.timeline.size() : 0;
+        entries.push_back( { gpuCount, tsz, v.end } );
+        gpuCount += tsz;
+        if( tsz != 0 ) gpuZones.push_back( &it->second.timeline );
+    }
+    for( auto& v : m_data.gpuChildren )
+    {
+        entries.push_back( { gpuCount, v.size(), 0 } );
+        gpuCount += v.size();
+        gpuZones.push_back( &v );
+    }
+
+    const auto align = []( uint64_t pos ) { return ( pos + AnalysisCacheAlign - 1 ) & ~uint64_t( AnalysisCacheAlign - 1 ); };
+
+    AnalysisCacheHeader hdr = {};
+    memcpy( hdr.magic, AnalysisCacheMagic, sizeof( AnalysisCacheMagic ) );
+    hdr.zoneEventSize = sizeof( ZoneEvent );
+    hdr.gpuEventSize = sizeof( GpuEvent );
+    hdr.traceSize = m_timelineSource.size;
+    hdr.traceTime = m_timelineSource.time;
+    hdr.traceHash = m_timelineSource.hash;
+    hdr.threads = m_data.threads.size();
+    hdr.zoneChildren = m_data.zoneChildren.size();
+    hdr.gpuThreads = m_timelineSource.gpu.size();
+    hdr.gpuChildren = m_data.gpuChildren.size();
+    hdr.zoneData = align( sizeof( hdr ) + entries.size() * sizeof( AnalysisCacheEntry ) );
+    hdr.zoneCount = zoneCount;
+    hdr.gpuData = align( hdr.zoneData + zoneCount * sizeof( ZoneEvent ) );
+    hdr.gpuCount = gpuCount;
+
+    FILE* f = fopen( GetAnalysisCachePath( m_timelineSource.file ).c_str(), "wb" );
+    if( !f ) return false;
+    const char zero[AnalysisCacheAlign] = {};
+
+    fwrite( &hdr, 1, sizeof( hdr ), f );
+    fwrite( entries.data(), 1, entries.size() * sizeof( AnalysisCacheEntry ), f );
+    fwrite( zero, 1, hdr.zoneData - sizeof( hdr ) - entries.size() * sizeof( AnalysisCacheEntry ), f );
+    // Timelines of a loaded trace store the zones directly, see ReadTimeline().
+    for( auto& v : zones )
+    {
+        if( v->empty() ) continue;
+        assert( v->is_magic() );
+        fwrite( ((const Vector<ZoneEvent>*)v)->data(), 1, v->size() * sizeof( ZoneEvent ), f );
+    }
+    fwrite( zero, 1, hdr.gpuData - hdr.zoneData - zoneCount * sizeof( ZoneEvent ), f );
+    for( auto& v : gpuZones )
+    {
+        assert( v->is_magic() );
+        fwrite( ((const Vector<GpuEvent>*)v)->data(), 1, v->size() * sizeof( GpuEvent ), f );
+    }
+
+    const auto ok = ferror( f ) == 0;
+    fclose( f );
+    return ok;
+}
+
 void Worker::Disconnect()
 {
     //Query( ServerQueryDisconnect, 0 );
@@ -7626,6 +10195,8 @@ void Worker::Write( FileWrite& f, bool fiDict )
 {
     DoPostponedWorkAll();
 
+    uint64_t sectionStart[(int)FileSection::NUM_SECTIONS];
+    uint64_t sectionEnd[(int)FileSection::NUM_SECTIONS];
     f.Write( FileHeader, sizeof( FileHeader ) );
 
     f.Write( &m_delay, sizeof( m_delay ) );
@@ -7813,6 +10384,7 @@ void Worker::Write( FileWrite& f, bool fiDict )
     }
 #endif
 
+    sectionStart[(int)FileSection::Locks] = f.GetPosition();
     sz = m_data.lockMap.size();
     f.Write( &sz, sizeof( sz ) );
     for( auto& v : m_data.lockMap )
@@ -7842,6 +10414,7 @@ void Worker::Write( FileWrite& f, bool fiDict )
             f.Write( &lev.ptr->type, sizeof( lev.ptr->type ) );
         }
     }
+    sectionEnd[(int)FileSection::Locks] = f.GetPosition();
 
     {
         int64_t refTime = 0;
@@ -7869,6 +10442,7 @@ void Worker::Write( FileWrite& f, bool fiDict )
     f.Write( &sz, sizeof( sz ) );
     sz = m_data.threads.size();
     f.Write( &sz, sizeof( sz ) );
+    TimelineColumnWrite<ZoneColumnCount> timeline;
     for( auto& thread : m_data.threads )
     {
         int64_t refTime = 0;
@@ -7876,7 +10450,26 @@ void Worker::Write( FileWrite& f, bool fiDict )
         f.Write( &thread->count, sizeof( thread->count ) );
         f.Write( &thread->kernelSampleCnt, sizeof( thread->kernelSampleCnt ) );
         f.Write( &thread->isFiber, sizeof( thread->isFiber ) );
-        WriteTimeline( f, thread->timeline, refTime );
+        timeline.clear();
+        WriteTimeline( timeline, thread->timeline, 0 );
+        uint64_t zones = 0;
+        uint32_t children = 0;
+        CountTimeline( thread->timeline, zones, children );
+        const uint32_t tsz = thread->timeline.size();
+        uint64_t bytes = tsz != 0 ? timeline.size() : 0;
+        f.Write( &bytes, sizeof( bytes ) );
+        f.Write( &zones, sizeof( zones ) );
+        f.Write( &children, sizeof( children ) );
+        f.Write( &tsz, sizeof( tsz ) );
+        if( tsz != 0 )
+        {
+            timeline.WriteTo( f );
+            for( int i=0; i<ZoneColumnCount && !timeline.IsBuffered(); i++ )
+            {
+                TimelineColumnStream<ZoneColumnCount> column( f, i );
+                WriteTimeline( column, thread->timeline, 0 );
+            }
+        }
         sz = thread->messages.size();
         f.Write( &sz, sizeof( sz ) );
         for( auto& v : thread->messages )
@@ -7917,6 +10510,7 @@ void Worker::Write( FileWrite& f, bool fiDict )
     f.Write( &sz, sizeof( sz ) );
     sz = m_data.gpuData.size();
     f.Write( &sz, sizeof( sz ) );
+    TimelineColumnWrite<GpuColumnCount> gpuTimeline;
     for( auto& ctx : m_data.gpuData )
     {
         f.Write( &ctx->thread, sizeof( ctx->thread ) );
@@ -7931,14 +10525,32 @@ void Worker::Write( FileWrite& f, bool fiDict )
         f.Write( &sz, sizeof( sz ) );
         for( auto& td : ctx->threadData )
         {
-            int64_t refTime = 0;
-            int64_t refGpuTime = 0;
             uint64_t tid = td.first;
             f.Write( &tid, sizeof( tid ) );
-            WriteTimeline( f, td.second.timeline, refTime, refGpuTime );
+            gpuTimeline.clear();
+            WriteTimeline( gpuTimeline, td.second.timeline, 0, 0 );
+            uint64_t zones = 0;
+            uint32_t children = 0;
+            CountTimeline( td.second.timeline, zones, children );
+            const uint64_t tsz = td.second.timeline.size();
+            uint64_t bytes = tsz != 0 ? gpuTimeline.size() : 0;
+            f.Write( &bytes, sizeof( bytes ) );
+            f.Write( &zones, sizeof( zones ) );
+            f.Write( &children, sizeof( children ) );
+            f.Write( &tsz, sizeof( tsz ) );
+            if( tsz != 0 )
+            {
+                gpuTimeline.WriteTo( f );
+                for( int i=0; i<GpuColumnCount && !gpuTimeline.IsBuffered(); i++ )
+                {
+                    TimelineColumnStream<GpuColumnCount> column( f, i );
+                    WriteTimeline( column, td.second.timeline, 0, 0 );
+                }
+            }
         }
     }
 
+    sectionStart[(int)FileSection::Plots] = f.GetPosition();
     sz = m_data.plots.Data().size();
     for( auto& plot : m_data.plots.Data() ) { if( plot->type == PlotType::Memory ) sz--; }
     f.Write( &sz, sizeof( sz ) );
@@ -7963,7 +10575,9 @@ void Worker::Write( FileWrite& f, bool fiDict )
             f.Write( &v.val, sizeof( v.val ) );
         }
     }
+    sectionEnd[(int)FileSection::Plots] = f.GetPosition();
 
+    sectionStart[(int)FileSection::Memory] = f.GetPosition();
     sz = m_data.memNameMap.size();
     f.Write( &sz, sizeof( sz ) );
     sz = 0;
@@ -8010,6 +10624,7 @@ void Worker::Write( FileWrite& f, bool fiDict )
         f.Write( &memdata.usage, sizeof( memdata.usage ) );
         f.Write( &memdata.name, sizeof( memdata.name ) );
     }
+    sectionEnd[(int)FileSection::Memory] = f.GetPosition();
 
     sz = m_data.callstackPayload.size() - 1;
     f.Write( &sz, sizeof( sz ) );
@@ -8035,6 +10650,7 @@ void Worker::Write( FileWrite& f, bool fiDict )
     f.Write( &sz, sizeof( sz ) );
     if( sz != 0 ) f.Write( m_data.appInfo.data(), sizeof( m_data.appInfo[0] ) * sz );
 
+    sectionStart[(int)FileSection::FrameImages] = f.GetPosition();
     {
         sz = m_data.frameImage.size();
         if( fiDict )
@@ -8109,6 +10725,7 @@ void Worker::Write( FileWrite& f, bool fiDict )
             f.Write( image, fi->w * fi->h / 2 );
         }
     }
+    sectionEnd[(int)FileSection::FrameImages] = f.GetPosition();
 
     // Only save context switches relevant to active threads.
     std::vector<unordered_flat_map<uint64_t, ContextSwitch*>::const_iterator> ctxValid;
@@ -8121,6 +10738,7 @@ void Worker::Write( FileWrite& f, bool fiDict )
             ctxValid.emplace_back( it );
         }
     }
+    sectionStart[(int)FileSection::ContextSwitches] = f.GetPosition();
     sz = ctxValid.size();
     f.Write( &sz, sizeof( sz ) );
     for( auto& ctx : ctxValid )
@@ -8144,7 +10762,9 @@ void Worker::Write( FileWrite& f, bool fiDict )
             f.Write( &thread, sizeof( thread ) );
         }
     }
+    sectionEnd[(int)FileSection::ContextSwitches] = f.GetPosition();
 
+    sectionStart[(int)FileSection::ContextSwitchesPerCpu] = f.GetPosition();
     sz = GetContextSwitchPerCpuCount();
     f.Write( &sz, sizeof( sz ) );
     for( int i=0; i<256; i++ )
@@ -8160,6 +10780,7 @@ void Worker::Write( FileWrite& f, bool fiDict )
             f.Write( &thread, sizeof( thread ) );
         }
     }
+    sectionEnd[(int)FileSection::ContextSwitchesPerCpu] = f.GetPosition();
 
     sz = m_data.tidToPid.size();
     f.Write( &sz, sizeof( sz ) );
@@ -8189,6 +10810,7 @@ void Worker::Write( FileWrite& f, bool fiDict )
         f.Write( &v.second, sizeof( v.second ) );
     }
 
+    sectionStart[(int)FileSection::SymbolCode] = f.GetPosition();
     sz = m_data.symbolCode.size();
     f.Write( &sz, sizeof( sz ) );
     for( auto& v : m_data.symbolCode )
@@ -8197,6 +10819,7 @@ void Worker::Write( FileWrite& f, bool fiDict )
         f.Write( &v.second.len, sizeof( v.second.len ) );
         f.Write( v.second.data, v.second.len );
     }
+    sectionEnd[(int)FileSection::SymbolCode] = f.GetPosition();
 
     sz = m_data.codeSymbolMap.size();
     f.Write( &sz, sizeof( sz ) );
@@ -8206,6 +10829,10 @@ void Worker::Write( FileWrite& f, bool fiDict )
         f.Write( &v.second, sizeof( v.second ) );
     }
 
+    {
+        const uint8_t flag = m_data.hasHwSampleCounters;
+        f.Write( &flag, sizeof( flag ) );
+    }
     sz = m_data.hwSamples.size();
     f.Write( &sz, sizeof( sz ) );
     for( auto& v : m_data.hwSamples )
@@ -8217,8 +10844,10 @@ void Worker::Write( FileWrite& f, bool fiDict )
         WriteHwSampleVec( f, v.second.cacheMiss );
         WriteHwSampleVec( f, v.second.branchRetired );
         WriteHwSampleVec( f, v.second.branchMiss );
+        if( m_data.hasHwSampleCounters ) f.Write( &v.second.counters, sizeof( HwSampleCounters ) );
     }
 
+    sectionStart[(int)FileSection::SourceCache] = f.GetPosition();
     sz = m_data.sourceFileCache.size();
     f.Write( &sz, sizeof( sz ) );
     for( auto& v : m_data.sourceFileCache )
@@ -8229,12 +10858,121 @@ void Worker::Write( FileWrite& f, bool fiDict )
         f.Write( &v.second.len, sizeof( v.second.len ) );
         f.Write( v.second.data, v.second.len );
     }
+    sectionEnd[(int)FileSection::SourceCache] = f.GetPosition();
+
+    const uint64_t indexPos = f.GetPosition();
+    const uint32_t sectionCount = (uint32_t)FileSection::NUM_SECTIONS;
+    f.Write( &sectionCount, sizeof( sectionCount ) );
+    f.Write( sectionEnd, sizeof( sectionEnd ) );
+    f.Write( sectionStart, sizeof( sectionStart ) );
+    f.Write( &indexPos, sizeof( indexPos ) );
 }
 
-void Worker::WriteTimeline( FileWrite& f, const Vector<short_ptr<ZoneEvent>>& vec, int64_t& refTime )
+// The trace data is copied through a single buffer, so the memory use doesn't depend on the size of the trace.
+// Sections excluded by the event mask are replaced with empty ones, and the section index is rebuilt to match.
+bool Worker::CopyTrace( FileRead& f, FileWrite& out, EventType::Type eventMask )
+{
+    // Other data, such as frame images, which are referenced by the frames, can't be dropped without a full load.
+    enum : uint32_t { Droppable = EventType::Locks | EventType::Plots | EventType::Memory | EventType::ContextSwitches | EventType::SymbolCode | EventType::SourceCache };
+    if( !f.IsSeekable() || ( ~eventMask & ~Droppable ) != 0 ) return false;
+
+    uint8_t hdr[8];
+    f.Read( hdr, sizeof( hdr ) );
+    uint64_t sectionStart[(int)FileSection::NUM_SECTIONS];
+    uint64_t sectionEnd[(int)FileSection::NUM_SECTIONS];
+    const auto valid = memcmp( FileHeader, hdr, sizeof( hdr ) ) == 0 && ReadSectionIndex( f, sectionEnd, sectionStart );
+    f.Seek( 0 );
+    if( !valid ) return false;
+
+    auto buf = std::unique_ptr<char[]>( new char[FileBlockSize] );
+    auto copy = [&f, &out, &buf] ( uint64_t end ) {
+        while( f.GetPosition() < end )
+        {
+            const auto sz = std::min<uint64_t>( end - f.GetPosition(), FileBlockSize );
+            f.Read( buf.get(), sz );
+            out.Write( buf.get(), sz );
+        }
+    };
+
+    for( int i=0; i<(int)FileSection::NUM_SECTIONS; i++ )
+    {
+        copy( sectionStart[i] );
+        // Number of counts an empty section consists of, or zero if the section is kept.
+        int empty = 0;
+        switch( (FileSection)i )
+        {
+        case FileSection::Locks:
+            if( !( eventMask & EventType::Locks ) ) empty = 1;
+            break;
+        case FileSection::Plots:
+            if( !( eventMask & EventType::Plots ) ) empty = 1;
+            break;
+        case FileSection::Memory:
+            if( !( eventMask & EventType::Memory ) ) empty = 2;
+            break;
+        case FileSection::ContextSwitches:
+            if( !( eventMask & EventType::ContextSwitches ) ) empty = 1;
+            break;
+        case FileSection::ContextSwitchesPerCpu:
+            if( !( eventMask & EventType::ContextSwitches ) ) empty = 1 + 256;
+            break;
+        case FileSection::SymbolCode:
+            if( !( eventMask & EventType::SymbolCode ) ) empty = 1;
+            break;
+        case FileSection::SourceCache:
+            if( !( eventMask & EventType::SourceCache ) ) empty = 1;
+            break;
+        default:
+            break;
+        }
+
+        const auto start = out.GetPosition();
+        if( empty != 0 )
+        {
+            const uint64_t zero = 0;
+            for( int j=0; j<empty; j++ ) out.Write( &zero, sizeof( zero ) );
+            f.Seek( sectionEnd[i] );
+        }
+        else
+        {
+            copy( sectionEnd[i] );
+        }
+        sectionStart[i] = start;
+        sectionEnd[i] = out.GetPosition();
+    }
+
+    const uint64_t indexPos = out.GetPosition();
+    const uint32_t sectionCount = (uint32_t)FileSection::NUM_SECTIONS;
+    out.Write( &sectionCount, sizeof( sectionCount ) );
+    out.Write( sectionEnd, sizeof( sectionEnd ) );
+    out.Write( sectionStart, sizeof( sectionStart ) );
+    out.Write( &indexPos, sizeof( indexPos ) );
+    return true;
+}
+
+bool Worker::GetDictionarySampleRanges( FileRead& f, std::vector<std::pair<uint64_t, uint64_t>>& ranges )
+{
+    if( !f.IsSeekable() ) return false;
+
+    uint8_t hdr[8];
+    f.Read( hdr, sizeof( hdr ) );
+    uint64_t sectionStart[(int)FileSection::NUM_SECTIONS];
+    uint64_t sectionEnd[(int)FileSection::NUM_SECTIONS];
+    const auto valid = memcmp( FileHeader, hdr, sizeof( hdr ) ) == 0 && ReadSectionIndex( f, sectionEnd, sectionStart );
+    f.Seek( 0 );
+    if( !valid ) return false;
+
+    // The string tables and source locations, which precede the locks, the callstacks and callstack frames, which
+    // follow the memory events, and the symbols, symbol code and source files at the end of the trace.
+    ranges.emplace_back( 0, sectionStart[(int)FileSection::Locks] );
+    ranges.emplace_back( sectionEnd[(int)FileSection::Memory], sectionStart[(int)FileSection::FrameImages] );
+    ranges.emplace_back( sectionEnd[(int)FileSection::ContextSwitchesPerCpu], sectionEnd[(int)FileSection::SourceCache] );
+    return true;
+}
+
+template<typename C>
+void Worker::WriteTimeline( C& f, const Vector<short_ptr<ZoneEvent>>& vec, int64_t refTime )
 {
-    uint32_t sz = uint32_t( vec.size() );
-    f.Write( &sz, sizeof( sz ) );
     if( vec.is_magic() )
     {
         WriteTimelineImpl<VectorAdapterDirect<ZoneEvent>>( f, *(Vector<ZoneEvent>*)( &vec ), refTime );
@@ -8245,35 +10983,35 @@ void Worker::WriteTimeline( FileWrite& f, const Vector<short_ptr<ZoneEvent>>& ve
     }
 }
 
-template<typename Adapter, typename V>
-void Worker::WriteTimelineImpl( FileWrite& f, const V& vec, int64_t& refTime )
+template<typename Adapter, typename C, typename V>
+void Worker::WriteTimelineImpl( C& f, const V& vec, int64_t refTime )
 {
     Adapter a;
     for( auto& val : vec )
     {
         auto& v = a(val);
-        int16_t srcloc = v.SrcLoc();
-        f.Write( &srcloc, sizeof( srcloc ) );
-        int64_t start = v.Start();
-        WriteTimeOffset( f, refTime, start );
-        f.Write( &v.extra, sizeof( v.extra ) );
-        if( !v.HasChildren() )
-        {
-            const uint32_t sz = 0;
-            f.Write( &sz, sizeof( sz ) );
+        const auto start = v.Start();
+        f.WriteSigned( ZoneColumnSrcLoc, v.SrcLoc() );
+        f.WriteSigned( ZoneColumnStart, start - refTime );
+        f.Write( ZoneColumnExtra, v.extra );
+        if( !v.HasChildren() || GetZoneChildren( v.Child() ).empty() )
+        {
+            f.Write( ZoneColumnChildren, 0 );
         }
         else
         {
-            WriteTimeline( f, GetZoneChildren( v.Child() ), refTime );
+            auto& children = GetZoneChildren( v.Child() );
+            f.Write( ZoneColumnChildren, children.size() );
+            WriteTimeline( f, children, start );
         }
-        WriteTimeOffset( f, refTime, v.End() );
+        f.WriteSigned( ZoneColumnDuration, v.End() - start );
+        refTime = v.End();
     }
 }
 
-void Worker::WriteTimeline( FileWrite& f, const Vector<short_ptr<GpuEvent>>& vec, int64_t& refTime, int64_t& refGpuTime )
+template<typename C>
+void Worker::WriteTimeline( C& f, const Vector<short_ptr<GpuEvent>>& vec, int64_t refTime, int64_t refGpuTime )
 {
-    uint64_t sz = vec.size();
-    f.Write( &sz, sizeof( sz ) );
     if( vec.is_magic() )
     {
         WriteTimelineImpl<VectorAdapterDirect<GpuEvent>>( f, *(Vector<GpuEvent>*)( &vec ), refTime, refGpuTime );
@@ -8284,33 +11022,75 @@ void Worker::WriteTimeline( FileWrite& f, const Vector<short_ptr<GpuEvent>>& vec
     }
 }
 
-template<typename Adapter, typename V>
-void Worker::WriteTimelineImpl( FileWrite& f, const V& vec, int64_t& refTime, int64_t& refGpuTime )
+template<typename Adapter, typename C, typename V>
+void Worker::WriteTimelineImpl( C& f, const V& vec, int64_t refTime, int64_t refGpuTime )
 {
     Adapter a;
     for( auto& val : vec )
     {
         auto& v = a(val);
-        WriteTimeOffset( f, refTime, v.CpuStart() );
-        WriteTimeOffset( f, refGpuTime, v.GpuStart() );
-        const int16_t srcloc = v.SrcLoc();
-        f.Write( &srcloc, sizeof( srcloc ) );
-        f.Write( &v.callstack, sizeof( v.callstack ) );
-        const uint16_t thread = v.Thread();
-        f.Write( &thread, sizeof( thread ) );
-
-        if( v.Child() < 0 )
+        const auto cpuStart = v.CpuStart();
+        const auto gpuStart = v.GpuStart();
+        f.WriteSigned( GpuColumnCpuStart, cpuStart - refTime );
+        f.WriteSigned( GpuColumnGpuStart, gpuStart - refGpuTime );
+        f.WriteSigned( GpuColumnSrcLoc, v.SrcLoc() );
+        f.Write( GpuColumnCallstack, v.callstack.Val() );
+        f.Write( GpuColumnThread, v.Thread() );
+        if( v.Child() < 0 || GetGpuChildren( v.Child() ).empty() )
         {
-            const uint64_t sz = 0;
-            f.Write( &sz, sizeof( sz ) );
+            f.Write( GpuColumnChildren, 0 );
         }
         else
         {
-            WriteTimeline( f, GetGpuChildren( v.Child() ), refTime, refGpuTime );
+            auto& children = GetGpuChildren( v.Child() );
+            f.Write( GpuColumnChildren, children.size() );
+            WriteTimeline( f, children, cpuStart, gpuStart );
         }
+        f.WriteSigned( GpuColumnCpuDuration, v.CpuEnd() - cpuStart );
+        f.WriteSigned( GpuColumnGpuDuration, v.GpuEnd() - gpuStart );
+        refTime = v.CpuEnd();
+        refGpuTime = v.GpuEnd();
+    }
+}
+
+// Counts the events of a timeline and the child vectors it references, the same way the loader will see them.
+void Worker::CountTimeline( const Vector<short_ptr<ZoneEvent>>& vec, uint64_t& zones, uint32_t& children ) const
+{
+    zones += vec.size();
+    auto count = [this, &zones, &children] ( const ZoneEvent& v ) {
+        if( !v.HasChildren() ) return;
+        auto& c = GetZoneChildren( v.Child() );
+        if( c.empty() ) return;
+        children++;
+        CountTimeline( c, zones, children );
+    };
+    if( vec.is_magic() )
+    {
+        for( auto& v : *(const Vector<ZoneEvent>*)( &vec ) ) count( v );
+    }
+    else
+    {
+        for( auto& v : vec ) count( *v );
+    }
+}
 
-        WriteTimeOffset( f, refTime, v.CpuEnd() );
-        WriteTimeOffset( f, refGpuTime, v.GpuEnd() );
+void Worker::CountTimeline( const Vector<short_ptr<GpuEvent>>& vec, uint64_t& zones, uint32_t& children ) const
+{
+    zones += vec.size();
+    auto count = [this, &zones, &children] ( const GpuEvent& v ) {
+        if( v.Child() < 0 ) return;
+        auto& c = GetGpuChildren( v.Child() );
+        if( c.empty() ) return;
+        children++;
+        CountTimeline( c, zones, children );
+    };
+    if( vec.is_magic() )
+    {
+        for( auto& v : *(const Vector<GpuEvent>*)( &vec ) ) count( v );
+    }
+    else
+    {
+        for( auto& v : vec ) count( *v );
     }
 }
 
@@ -8380,6 +11160,7 @@ void Worker::CacheSource( const StringRef& str, const StringIdx& image )
     assert( str.active );
     assert( m_checkedFileStrings.find( str ) == m_checkedFileStrings.end() );
     m_checkedFileStrings.emplace( str );
+    if( m_memoryBudget != MemoryBudget::Normal ) return;
     auto file = GetString( str );
     // Possible duplication of pointer and index strings
     if( m_data.sourceFileCache.find( file ) != m_data.sourceFileCache.end() ) return;
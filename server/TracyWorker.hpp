@@ -2,8 +2,10 @@
 #define __TRACYWORKER_HPP__
 
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <limits>
+#include <memory>
 #include <mutex>
 #include <shared_mutex>
 #include <stdexcept>
@@ -22,6 +24,7 @@
 #include "TracyShortPtr.hpp"
 #include "TracySlab.hpp"
 #include "TracyStringDiscovery.hpp"
+#include "TracyTaskDispatch.hpp"
 #include "TracyTextureCompression.hpp"
 #include "TracyThreadCompress.hpp"
 #include "TracyVarArray.hpp"
@@ -98,6 +101,22 @@ struct LoadProgress
 class Worker
 {
 public:
+    enum { DefaultNetBufferDepth = 16 };
+
+    struct FlightRecorder
+    {
+        int seconds = 0;            // time span of events to keep, 0 for no limit
+        uint64_t size = 0;          // size of event data to keep, in bytes, 0 for no limit
+        std::string freezeMessage;  // message text which stops the recording, empty if not used
+    };
+
+    struct ReplayProfile
+    {
+        uint64_t count[(int)QueueType::NUM_TYPES] = {};     // events processed, per event type
+        int64_t time[(int)QueueType::NUM_TYPES] = {};       // time spent in event handlers, in ns
+        size_t peakMemory = 0;                              // peak memory usage of trace data
+    };
+
     struct ImportEventTimeline
     {
         uint64_t tid;
@@ -194,6 +213,39 @@ public:
         }
     };
 
+    // Event processing holds the data lock for a whole network buffer. Threads waiting in lock() are
+    // noticed by the processing loop, which hands the lock over at the next event boundary, where
+    // all data received so far is already published.
+    class DataLock
+    {
+    public:
+        void lock()
+        {
+            m_waiters.fetch_add( 1, std::memory_order_relaxed );
+            m_lock.lock();
+            m_waiters.fetch_sub( 1, std::memory_order_relaxed );
+            m_acquired.fetch_add( 1, std::memory_order_relaxed );
+        }
+        bool try_lock() { return m_lock.try_lock(); }
+        void unlock() { m_lock.unlock(); }
+
+        tracy_force_inline bool HasWaiters() const { return m_waiters.load( std::memory_order_relaxed ) != 0; }
+
+        // Must be called with the lock held. Returns once a waiting thread had its turn.
+        void Handoff()
+        {
+            const auto acquired = m_acquired.load( std::memory_order_relaxed );
+            m_lock.unlock();
+            while( m_acquired.load( std::memory_order_relaxed ) == acquired ) std::this_thread::yield();
+            m_lock.lock();
+        }
+
+    private:
+        std::mutex m_lock;
+        std::atomic<uint32_t> m_waiters { 0 };
+        std::atomic<uint32_t> m_acquired { 0 };
+    };
+
 private:
     struct SourceLocationZones
     {
@@ -276,9 +328,9 @@ private:
 
     struct DataBlock
     {
-        std::mutex lock;
+        DataLock lock;
         StringDiscovery<FrameData*> frames;
-        FrameData* framesBase;
+        FrameData* framesBase = nullptr;
         Vector<GpuCtxData*> gpuData;
         Vector<short_ptr<MessageData>> messages;
         StringDiscovery<PlotData*> plots;
@@ -340,6 +392,11 @@ private:
         unordered_flat_map<uint64_t, Vector<SampleDataRange>> symbolSamples;
         unordered_flat_map<CallstackFrameId, Vector<SampleDataRange>, CallstackFrameIdHash, CallstackFrameIdCompare> pendingSymbolSamples;
         unordered_flat_map<uint64_t, Vector<ChildSample>> childSamples;
+        unordered_flat_map<uint64_t, ThreadWaitTime> threadWaitTime;
+        Vector<ThreadData*> threadWaitPending;
+        unordered_flat_map<uint64_t, uint32_t> kernelEntryStats;
+        uint64_t kernelSamples = 0;
+        uint64_t userSamples = 0;
         bool newFramesWereReceived = false;
         bool callstackSamplesReady = false;
         bool newContextSwitchesReceived = false;
@@ -402,6 +459,7 @@ private:
 
         unordered_flat_map<uint64_t, HwSampleData> hwSamples;
         bool hasBranchRetirement = false;
+        bool hasHwSampleCounters = false;
 
         unordered_flat_map<uint64_t, uint64_t> fiberToThreadMap;
     };
@@ -452,11 +510,23 @@ public:
         NUM_FAILURES
     };
 
-    Worker( const char* addr, uint16_t port );
+    Worker( const char* addr, uint16_t port, int netBufferDepth = DefaultNetBufferDepth, FileWrite* streamOut = nullptr, const FlightRecorder* recorder = nullptr, bool streamJournal = false );
+    Worker( const char* name, const char* program );
     Worker( const char* name, const char* program, const std::vector<ImportEventTimeline>& timeline, const std::vector<ImportEventMessages>& messages, const std::vector<ImportEventPlots>& plots, const std::unordered_map<uint64_t, std::string>& threadNames );
-    Worker( FileRead& f, EventType::Type eventMask = EventType::All, bool bgTasks = true, bool allowStringModification = false);
+    Worker( FileRead& f, EventType::Type eventMask = EventType::All, bool bgTasks = true, bool allowStringModification = false, ReplayProfile* replayProfile = nullptr );
     ~Worker();
 
+    // Server memory budget in bytes, 0 disables it. It applies to the memory usage of the whole process.
+    void SetMemoryLimit( uint64_t limit ) { m_memoryLimit.store( limit, std::memory_order_relaxed ); }
+    bool IsTimelineDropped() const { return m_memoryBudget == MemoryBudget::DropTimeline; }
+    // The recorded event stream is made durable every given number of seconds, 0 disables checkpoints.
+    void SetCheckpointInterval( int seconds ) { m_checkpointInterval.store( seconds, std::memory_order_relaxed ); }
+    // Time of the last checkpoint, in seconds since epoch, 0 if there was none yet.
+    int64_t GetCheckpointTime() const { return m_checkpointTime.load( std::memory_order_relaxed ); }
+
+    // Appends the trace of another process, with its timestamps shifted by the given offset.
+    void Merge( Worker& src, int64_t offset, const char* prefix );
+
     const std::string& GetAddr() const { return m_addr; }
     uint16_t GetPort() const { return m_port; }
     const std::string& GetCaptureName() const { return m_captureName; }
@@ -471,7 +541,7 @@ public:
     uint32_t GetCpuId() const { return m_data.cpuId; }
     const char* GetCpuManufacturer() const { return m_data.cpuManufacturer; }
 
-    std::mutex& GetDataLock() { return m_data.lock; }
+    DataLock& GetDataLock() { return m_data.lock; }
     size_t GetFrameCount( const FrameData& fd ) const { return fd.frames.size(); }
     size_t GetFullFrameCount( const FrameData& fd ) const;
     bool AreFramesUsed() const;
@@ -479,6 +549,7 @@ public:
     int64_t GetLastTime() const { return m_data.lastTime; }
     uint64_t GetZoneCount() const { return m_data.zonesCnt; }
     uint64_t GetZoneExtraCount() const { return m_data.zoneExtra.size() - 1; }
+    uint64_t GetEventCount() const { return m_eventCount; }     // events processed by an event stream replay
     uint64_t GetGpuZoneCount() const { return m_data.gpuCnt; }
     uint64_t GetLockCount() const;
     uint64_t GetPlotCount() const;
@@ -503,10 +574,16 @@ public:
     uint64_t GetHwSampleCountAddress() const { return m_data.hwSamples.size(); }
     uint64_t GetHwSampleCount() const;
     bool HasHwBranchRetirement() const { return m_data.hasBranchRetirement; }
+    bool HasHwSampleCounters() const { return m_data.hasHwSampleCounters; }
 #ifndef TRACY_NO_STATISTICS
     uint64_t GetChildSamplesCountSyms() const { return m_data.childSamples.size(); }
     uint64_t GetChildSamplesCountFull() const;
     uint64_t GetContextSwitchSampleCount() const;
+    const ThreadWaitTime* GetThreadWaitTime( uint64_t thread ) const;
+    uint64_t GetKernelSampleCount() const { return m_data.kernelSamples; }
+    uint64_t GetUserSampleCount() const { return m_data.userSamples; }
+    const unordered_flat_map<uint64_t, uint32_t>& GetKernelEntryStats() const { return m_data.kernelEntryStats; }
+    int64_t GetContextSwitchSampleWaitTime( uint64_t thread, int64_t time );
 #endif
     uint64_t GetFrameOffset() const { return m_data.frameOffset; }
     const FrameData* GetFramesBase() const { return m_data.framesBase; }
@@ -636,7 +713,7 @@ public:
     uint64_t GetDataTransferred() const { return m_mbpsData.transferred; }
 
     bool HasData() const { return m_hasData.load( std::memory_order_acquire ); }
-    bool IsConnected() const { return m_connected.load( std::memory_order_relaxed ); }
+    bool IsConnected() const { return m_connected.load( std::memory_order_acquire ); }
     bool IsDataStatic() const { return !m_thread.joinable(); }
     bool IsBackgroundDone() const { return m_backgroundDone.load( std::memory_order_relaxed ); }
     bool IsOnDemand() const { return m_onDemand; }
@@ -645,6 +722,21 @@ public:
     bool WasDisconnectIssued() const { return m_disconnect; }
 
     void Write( FileWrite& f, bool fiDict );
+    // Copies a trace in the current format without loading it, which only allows removing the data in the sections
+    // listed in the section index. Returns false, with the input rewound, if the trace has to be loaded instead.
+    static bool CopyTrace( FileRead& f, FileWrite& out, EventType::Type eventMask );
+    // Ranges of the uncompressed data of a trace in the current format which mostly repeat between traces of the
+    // same program build, to be used as samples for training a compression dictionary. Returns false, with the
+    // input rewound, if the trace has a different format.
+    static bool GetDictionarySampleRanges( FileRead& f, std::vector<std::pair<uint64_t, uint64_t>>& ranges );
+    // The analysis cache stores the zone timelines of a trace file in their in-memory form. When the cache is
+    // present, later loads of the same trace map it into memory, instead of decoding the timelines.
+    bool WriteAnalysisCache() const;
+    static std::string GetAnalysisCachePath( const std::string& traceFile ) { return traceFile + ".cache"; }
+    bool IsAnalysisCacheUsed() const { return m_cacheMap != nullptr; }
+    void WriteFlightRecording( FileWrite& f );
+    void FreezeFlightRecording();
+    bool IsFlightRecordingFrozen() const;
     int GetTraceVersion() const { return m_traceVersion; }
     uint8_t GetHandshakeStatus() const { return m_handshake.load( std::memory_order_relaxed ); }
     int64_t GetSamplingPeriod() const { return m_samplingPeriod; }
@@ -678,15 +770,71 @@ public:
     StringLocation StoreString(const char* str, size_t sz);
 
 private:
+    struct NetBuffer
+    {
+        int bufferOffset;
+        int size;
+    };
+
+    // Buffer offsets which don't point to data: the network thread has finished, or nothing arrived in time.
+    enum { NetBufferClosed = -1, NetBufferTimeout = -2 };
+
     void Network();
     void Exec();
+
+    bool NetBufferReserve();
+    void NetBufferPublish( const NetBuffer& buf );
+    NetBuffer NetBufferAcquire( std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max() );
+    void NetBufferRelease();
+    void NetBufferWakeWriter();
+
     void Query( ServerQuery type, uint64_t data, uint32_t extra = 0 );
     void QueryTerminate();
     void QuerySourceFile( const char* fn, const char* image );
     void QueryDataTransfer( const void* ptr, size_t size );
 
+    tracy_force_inline bool DispatchProcess( const QueueItem& ev, const char*& ptr, const char* end );
     tracy_force_inline bool DispatchProcess( const QueueItem& ev, const char*& ptr );
     tracy_force_inline bool Process( const QueueItem& ev );
+    struct StreamState;
+    struct FlightRecorderData;
+    bool ProcessStreamed( const QueueItem& ev );
+    bool DispatchRecorded( const QueueItem& ev, const char*& ptr );
+    void RecordFrame( const char* ptr, uint32_t sz );
+    void RecordDictionary( uint32_t kind, const char* ptr, size_t sz, const StreamState& state );
+
+    enum class MemoryBudget
+    {
+        Normal,
+        DropOptional,   // frame images, symbol code, source files and hardware samples are not retained
+        DropTimeline    // only the events needed to answer client queries are processed
+    };
+
+    void CheckMemoryLimit();
+    void AddMemoryLimitNote( const char* what );
+
+    struct MergeState;
+    int16_t GetImportSourceLocation( const SourceLocation& srcloc );
+    void EndImportedZone( uint64_t tid, int64_t time );
+    void MergeTimeline( Worker& src, const Vector<short_ptr<ZoneEvent>>& vec, MergeState& state );
+    template<typename Adapter, typename V>
+    void MergeTimelineImpl( Worker& src, const V& vec, MergeState& state );
+
+    void InitCaptureData();
+    void ProcessWelcome( const WelcomeMessage& welcome );
+    void ProcessOnDemandPayload( const OnDemandPayloadMessage& onDemand );
+    void ReplayStream( FileRead& f, ReplayProfile* profile );
+    void ReplayFailure();
+    void WriteCheckpoint();
+
+    struct IngestJob;
+    struct IngestContext;
+    bool DispatchIngest( const char*& ptr, const char* end );
+    void RunIngestJob( IngestJob& job, IngestContext& ctx );
+    tracy_force_inline void IngestZoneBegin( IngestJob& job, IngestContext& ctx, const QueueZoneBegin& ev, int16_t srcloc );
+    tracy_force_inline bool IngestZoneEnd( IngestJob& job, IngestContext& ctx, const QueueZoneEnd& ev );
+    tracy_force_inline Vector<short_ptr<ZoneEvent>>& GetIngestChildren( IngestJob& job, int32_t idx );
+
     tracy_force_inline void ProcessThreadContext( const QueueThreadContext& ev );
     tracy_force_inline void ProcessZoneBegin( const QueueZoneBegin& ev );
     tracy_force_inline void ProcessZoneBeginCallstack( const QueueZoneBegin& ev );
@@ -738,6 +886,7 @@ private:
     tracy_force_inline void ProcessGpuContextName( const QueueGpuContextName& ev );
     tracy_force_inline MemEvent* ProcessMemAlloc( const QueueMemAlloc& ev );
     tracy_force_inline MemEvent* ProcessMemAllocNamed( const QueueMemAlloc& ev );
+    tracy_force_inline MemData& ConsumeMemNamePayload();
     tracy_force_inline MemEvent* ProcessMemFree( const QueueMemFree& ev );
     tracy_force_inline MemEvent* ProcessMemFreeNamed( const QueueMemFree& ev );
     tracy_force_inline void ProcessMemAllocCallstack( const QueueMemAlloc& ev );
@@ -763,6 +912,7 @@ private:
     tracy_force_inline void ProcessHwSampleCacheMiss( const QueueHwSample& ev );
     tracy_force_inline void ProcessHwSampleBranchRetired( const QueueHwSample& ev );
     tracy_force_inline void ProcessHwSampleBranchMiss( const QueueHwSample& ev );
+    tracy_force_inline void ProcessHwSampleGroup( const QueueHwSampleGroup& ev );
     tracy_force_inline void ProcessParamSetup( const QueueParamSetup& ev );
     tracy_force_inline void ProcessSourceCodeNotAvailable( const QueueSourceCodeNotAvailable& ev );
     tracy_force_inline void ProcessCpuTopology( const QueueCpuTopology& ev );
@@ -771,12 +921,16 @@ private:
     tracy_force_inline void ProcessFiberLeave( const QueueFiberLeave& ev );
 
     tracy_force_inline ZoneEvent* AllocZoneEvent();
+    tracy_force_inline ZoneEvent* AllocZoneEventBatched();
+    tracy_force_inline bool ProcessLeafZone( const char*& ptr, const char* end );
+    tracy_force_inline void AppendZoneChild( ZoneEvent* parent, ZoneEvent* zone );
     tracy_force_inline void ProcessZoneBeginImpl( ZoneEvent* zone, const QueueZoneBegin& ev );
     tracy_force_inline void ProcessZoneBeginAllocSrcLocImpl( ZoneEvent* zone, const QueueZoneBeginLean& ev );
     tracy_force_inline void ProcessGpuZoneBeginImpl( GpuEvent* zone, const QueueGpuZoneBegin& ev, bool serial );
     tracy_force_inline void ProcessGpuZoneBeginAllocSrcLocImpl( GpuEvent* zone, const QueueGpuZoneBeginLean& ev, bool serial );
     tracy_force_inline void ProcessGpuZoneBeginImplCommon( GpuEvent* zone, const QueueGpuZoneBeginLean& ev, bool serial );
     tracy_force_inline void ProcessPlotDataImpl( uint64_t name, int64_t evTime, double val );
+    tracy_force_inline PlotData* RetrieveUserPlot( uint64_t name );
     tracy_force_inline MemEvent* ProcessMemAllocImpl( MemData& memdata, const QueueMemAlloc& ev );
     tracy_force_inline MemEvent* ProcessMemFreeImpl( MemData& memdata, const QueueMemFree& ev );
     tracy_force_inline void ProcessCallstackSampleImpl( const SampleData& sd, ThreadData& td );
@@ -892,9 +1046,12 @@ private:
     void InsertPlot( PlotData* plot, int64_t time, double val );
     void HandlePlotName( uint64_t name, const char* str, size_t sz );
     void HandleFrameName( uint64_t name, const char* str, size_t sz );
+    void AddEmptyFramesBase();
 
     void HandlePostponedSamples();
     void HandlePostponedGhostZones();
+    void QueueThreadWaitTime( ThreadData& td );
+    void UpdateThreadWaitTimes();
 
     bool IsFailureThreadStringRetrieved();
     bool IsSourceLocationRetrieved( int16_t srcloc );
@@ -926,13 +1083,16 @@ private:
 #endif
 
     tracy_force_inline int64_t ReadTimeline( FileRead& f, ZoneEvent* zone, int64_t refTime, int32_t& childIdx );
-    tracy_force_inline int64_t ReadTimelineHaveSize( FileRead& f, ZoneEvent* zone, int64_t refTime, int32_t& childIdx, uint32_t sz );
+    template<typename R>
+    tracy_force_inline int64_t ReadTimelineHaveSize( R& f, ZoneEvent* zone, int64_t refTime, int32_t& childIdx, uint32_t sz );
     tracy_force_inline void ReadTimeline( FileRead& f, GpuEvent* zone, int64_t& refTime, int64_t& refGpuTime, int32_t& childIdx );
-    tracy_force_inline void ReadTimelineHaveSize( FileRead& f, GpuEvent* zone, int64_t& refTime, int64_t& refGpuTime, int32_t& childIdx, uint64_t sz );
+    template<typename R>
+    tracy_force_inline void ReadTimelineHaveSize( R& f, GpuEvent* zone, int64_t& refTime, int64_t& refGpuTime, int32_t& childIdx, uint64_t sz );
 
 #ifndef TRACY_NO_STATISTICS
     tracy_force_inline void ReconstructZoneStatistics( uint8_t* countMap, ZoneEvent& zone, uint16_t thread );
     tracy_force_inline void ReconstructZoneStatistics( GpuEvent& zone, uint16_t thread );
+    tracy_force_inline void AddZoneStatistics( ZoneEvent* zone, uint16_t thread, int64_t timeSpan, int64_t selfSpan, bool isReentry );
 #else
     tracy_force_inline void CountZoneStatistics( ZoneEvent* zone );
     tracy_force_inline void CountZoneStatistics( GpuEvent* zone );
@@ -945,17 +1105,31 @@ private:
     int64_t GetZoneEndImpl( const ZoneEvent& ev );
     int64_t GetZoneEndImpl( const GpuEvent& ev );
 
+    bool IsQueryPending() const;
+    static std::shared_ptr<TaskDispatch> GetIngestDispatch( size_t workers );
     void UpdateMbps( int64_t td );
 
-    int64_t ReadTimeline( FileRead& f, Vector<short_ptr<ZoneEvent>>& vec, uint32_t size, int64_t refTime, int32_t& childIdx );
-    void ReadTimeline( FileRead& f, Vector<short_ptr<GpuEvent>>& vec, uint64_t size, int64_t& refTime, int64_t& refGpuTime, int32_t& childIdx );
-
-    tracy_force_inline void WriteTimeline( FileWrite& f, const Vector<short_ptr<ZoneEvent>>& vec, int64_t& refTime );
-    tracy_force_inline void WriteTimeline( FileWrite& f, const Vector<short_ptr<GpuEvent>>& vec, int64_t& refTime, int64_t& refGpuTime );
-    template<typename Adapter, typename V>
-    void WriteTimelineImpl( FileWrite& f, const V& vec, int64_t& refTime );
-    template<typename Adapter, typename V>
-    void WriteTimelineImpl( FileWrite& f, const V& vec, int64_t& refTime, int64_t& refGpuTime );
+    template<typename R>
+    int64_t ReadTimeline( R& f, Vector<short_ptr<ZoneEvent>>& vec, uint32_t size, int64_t refTime, int32_t& childIdx );
+    template<typename R>
+    void ReadTimeline( R& f, Vector<short_ptr<GpuEvent>>& vec, uint64_t size, int64_t& refTime, int64_t& refGpuTime, int32_t& childIdx );
+    const char* MapAnalysisCache();
+
+    template<typename C>
+    void ReadTimelineColumns( C& f, Vector<short_ptr<ZoneEvent>>& vec, uint32_t size, int64_t refTime, int32_t& childIdx );
+    template<typename C>
+    void ReadTimelineColumns( C& f, Vector<short_ptr<GpuEvent>>& vec, uint64_t size, int64_t refTime, int64_t refGpuTime, int32_t& childIdx );
+
+    template<typename C>
+    tracy_force_inline void WriteTimeline( C& f, const Vector<short_ptr<ZoneEvent>>& vec, int64_t refTime );
+    template<typename C>
+    tracy_force_inline void WriteTimeline( C& f, const Vector<short_ptr<GpuEvent>>& vec, int64_t refTime, int64_t refGpuTime );
+    template<typename Adapter, typename C, typename V>
+    void WriteTimelineImpl( C& f, const V& vec, int64_t refTime );
+    template<typename Adapter, typename C, typename V>
+    void WriteTimelineImpl( C& f, const V& vec, int64_t refTime, int64_t refGpuTime );
+    void CountTimeline( const Vector<short_ptr<ZoneEvent>>& vec, uint64_t& zones, uint32_t& children ) const;
+    void CountTimeline( const Vector<short_ptr<GpuEvent>>& vec, uint64_t& zones, uint32_t& children ) const;
 
     int64_t TscTime( int64_t tsc ) { return int64_t( ( tsc - m_data.baseTime ) * m_timerMul ); }
     int64_t TscTime( uint64_t tsc ) { return int64_t( ( tsc - m_data.baseTime ) * m_timerMul ); }
@@ -990,6 +1164,16 @@ private:
     void* m_stream;     // LZ4_streamDecode_t*
     char* m_buffer;
     int m_bufferOffset;
+    FileWrite* m_streamOut = nullptr;   // raw event stream recording, timeline data is not kept in memory, unless the stream is a journal
+    std::unique_ptr<FlightRecorderData> m_recorder;     // only the most recent events are kept, in raw form
+    bool m_processStreamed = false;     // bulk events only do the work needed to keep client queries in step
+    bool m_windowReplay = false;        // the replayed stream starts in the middle of the capture
+    uint64_t m_queryCount = 0;
+    uint32_t m_mergeCount = 0;
+    std::atomic<uint64_t> m_memoryLimit { 0 };
+    std::atomic<int> m_checkpointInterval { 0 };
+    std::atomic<int64_t> m_checkpointTime { 0 };
+    MemoryBudget m_memoryBudget = MemoryBudget::Normal;
     bool m_onDemand;
     bool m_ignoreMemFreeFaults;
     bool m_ignoreFrameEndFaults;
@@ -1038,6 +1222,27 @@ private:
     int m_traceVersion;
     std::atomic<uint8_t> m_handshake { 0 };
 
+    // Trace file the data was loaded from, and the positions in it at which the timelines of each thread end.
+    struct TimelineSource
+    {
+        struct GpuTimeline
+        {
+            uint32_t ctx;
+            uint64_t thread;
+            uint64_t end;
+        };
+
+        std::string file;
+        uint64_t size = 0;
+        int64_t time = 0;
+        uint64_t hash = 0;
+        std::vector<uint64_t> threadEnd;
+        std::vector<GpuTimeline> gpu;
+    };
+    TimelineSource m_timelineSource;
+    char* m_cacheMap = nullptr;
+    size_t m_cacheMapSize = 0;
+
     static LoadProgress s_loadProgress;
     int64_t m_loadTime;
 
@@ -1064,23 +1269,85 @@ private:
     std::atomic<uint64_t> m_bytes { 0 };
     std::atomic<uint64_t> m_decBytes { 0 };
 
-    struct NetBuffer
-    {
-        int bufferOffset;
-        int size;
-    };
-
-    std::vector<NetBuffer> m_netRead;
+    // Decompressed frames are passed from Network to Exec through a single producer, single consumer
+    // ring of descriptors. A frame stays reserved until Exec is done with it. The mutexes and condition
+    // variables are only used by a side that has to go to sleep on an empty or full ring.
+    std::unique_ptr<NetBuffer[]> m_netRing;
+    uint32_t m_netRingSize = 0;     // descriptor slots, depth + 1 for the end of stream marker
+    uint32_t m_netRingDepth = 0;    // frames in flight
+    int m_netBufferSize = 0;        // bytes in m_buffer
+    std::atomic<uint32_t> m_netRingWrite { 0 };
+    std::atomic<uint32_t> m_netRingRead { 0 };
+
+    std::atomic<bool> m_netReadSleeping { false };
     std::mutex m_netReadLock;
     std::condition_variable m_netReadCv;
 
-    int m_netWriteCnt = 0;
+    std::atomic<bool> m_netWriteSleeping { false };
     std::mutex m_netWriteLock;
     std::condition_variable m_netWriteCv;
 
 #ifdef TRACY_NO_STATISTICS
     Vector<ZoneEvent*> m_zoneEventPool;
 #endif
+    ZoneEvent* m_zoneEventBatch = nullptr;
+    uint32_t m_zoneEventBatchLeft = 0;
+    uint64_t m_eventCount = 0;
+
+    struct IngestEvent
+    {
+        const QueueItem* ev;
+        int16_t srcloc;
+    };
+
+#ifndef TRACY_NO_STATISTICS
+    struct IngestZoneStat
+    {
+        ZoneEvent* zone;
+        int64_t selfSpan;
+        bool isReentry;
+    };
+#endif
+
+    // Events of a single thread, processed concurrently with the other threads.
+    // Anything touching cross-thread data is deferred and merged afterwards.
+    struct IngestJob
+    {
+        ThreadData* td;
+        std::vector<IngestEvent> events;
+        uint32_t zoneBegins;
+        int32_t childBase;
+        int64_t refTime;
+        int64_t lastTime;
+        uint64_t zonesCnt;
+        Vector<Vector<short_ptr<ZoneEvent>>> children;
+        Vector<ZoneEvent*> childParents;
+#ifndef TRACY_NO_STATISTICS
+        uint16_t thread;
+        Vector<IngestZoneStat> stats;
+#else
+        Vector<int16_t> stats;
+#endif
+        Failure failure;
+        int16_t failureSrcloc;
+    };
+
+    // Per ingest task allocation state.
+    struct IngestContext
+    {
+        Slab<16*1024*1024> slab;
+        Vector<Vector<short_ptr<ZoneEvent>>> vectorCache;
+#ifdef TRACY_NO_STATISTICS
+        Vector<ZoneEvent*> zoneEventPool;
+#endif
+        size_t memUsage = 0;
+    };
+
+    std::shared_ptr<TaskDispatch> m_ingestDispatch;
+    size_t m_ingestTasks = 0;
+    std::vector<IngestJob> m_ingestJobs;
+    unordered_flat_map<ThreadData*, size_t> m_ingestJobMap;
+    std::vector<std::unique_ptr<IngestContext>> m_ingestContexts;
 
     Vector<Parameter> m_params;
 
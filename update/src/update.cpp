@@ -1,11 +1,22 @@
 #ifdef _WIN32
 #  include <windows.h>
+#  include <io.h>
+#else
+#  include <sys/file.h>
+#  include <unistd.h>
 #endif
 
 #include <chrono>
+#include <memory>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 #include "../../public/common/TracyVersion.hpp"
 #include "../../server/TracyFileRead.hpp"
@@ -13,22 +24,29 @@
 #include "../../server/TracyPrint.hpp"
 #include "../../server/TracyWorker.hpp"
 #include "../../zstd/zstd.h"
+#define ZDICT_STATIC_LINKING_ONLY
+#include "../../zstd/zdict.h"
 #include "../../getopt/getopt.h"
 
 #include "OfflineSymbolResolver.h"
 
 #ifdef __APPLE__
 #  define ftello64(x) ftello(x)
+#  define fseeko64(x,y,z) fseeko(x,y,z)
 #elif defined _WIN32
 #  define ftello64(x) _ftelli64(x)
+#  define fseeko64(x,y,z) _fseeki64(x,y,z)
 #endif
 
 void Usage()
 {
-    printf( "Usage: update [options] input.tracy output.tracy\n\n" );
+    printf( "Usage: update [options] input.tracy output.tracy\n" );
+    printf( "       update -t dictionary.zdict input1.tracy [input2.tracy ...]\n\n" );
     printf( "  -h: enable LZ4HC compression\n" );
     printf( "  -e: enable extreme LZ4HC compression (very slow)\n" );
     printf( "  -z level: use Zstd compression with given compression level\n" );
+    printf( "  -D dictionary: use Zstd compression with a dictionary trained with -t (level 3 unless -z is given)\n" );
+    printf( "  -j threads: number of compression threads (all cores by default, 0 to compress on the main thread)\n" );
     printf( "  -d: build dictionary for frame images\n" );
     printf( "  -s flags: strip selected data from capture:\n" );
     printf( "      l: locks, m: messages, p: plots, M: memory, i: frame images\n" );
@@ -36,10 +54,331 @@ void Usage()
     printf( "  -c: scan for source files missing in cache and add if found\n" );
     printf( "  -r: resolve symbols and patch callstack frames\n");
     printf( "  -p: substitute symbol resolution path with an alternative: \"REGEX_MATCH;REPLACEMENT\"\n");
+    printf( "  -a: write an analysis cache for the output file, which makes loading it faster\n" );
+    printf( "  -t dictionary: train a Zstd dictionary on traces of a single program build\n" );
+    printf( "  -A pack: store the output data in a pack shared with other traces in the output directory\n" );
+    printf( "      (Zstd level 3 unless -z is given)\n" );
+    printf( "\n  The input may also be an event stream recorded with capture -r, or a profiler journal.\n" );
+    printf( "  Traces in the current format are copied without being loaded into memory, unless -d, -c, -r\n" );
+    printf( "  or stripping of messages, frame images or sampling data is requested.\n" );
 
     exit( 1 );
 }
 
+// Only the parts of the traces which repeat between traces of the same program build are sampled. If these add up
+// to more than the sample limit, the samples are spread evenly over them.
+static void TrainDictionary( const char* output, char** inputs, int count )
+{
+    enum { DictSize = 1024 * 1024 };
+    enum { SampleSize = 16 * 1024 };
+    enum : uint64_t { SamplesLimit = 256 * 1024 * 1024 };
+
+    std::vector<std::unique_ptr<tracy::FileRead>> files;
+    std::vector<std::vector<std::pair<uint64_t, uint64_t>>> ranges;
+    uint64_t total = 0;
+    for( int i=0; i<count; i++ )
+    {
+        auto f = std::unique_ptr<tracy::FileRead>( tracy::FileRead::Open( inputs[i] ) );
+        if( !f )
+        {
+            fprintf( stderr, "Cannot open input file %s!\n", inputs[i] );
+            exit( 1 );
+        }
+        std::vector<std::pair<uint64_t, uint64_t>> r;
+        if( !tracy::Worker::GetDictionarySampleRanges( *f, r ) )
+        {
+            fprintf( stderr, "%s is not a trace in the current format, convert it first.\n", inputs[i] );
+            exit( 1 );
+        }
+        for( auto& v : r ) total += v.second - v.first;
+        files.emplace_back( std::move( f ) );
+        ranges.emplace_back( std::move( r ) );
+    }
+
+    const auto step = total / SamplesLimit + 1;
+    std::vector<char> samples;
+    std::vector<size_t> sizes;
+    for( size_t i=0; i<files.size(); i++ )
+    {
+        for( auto& v : ranges[i] )
+        {
+            for( uint64_t pos = v.first; pos < v.second; pos += SampleSize * step )
+            {
+                const auto sz = std::min<uint64_t>( v.second - pos, SampleSize );
+                files[i]->Seek( pos );
+                samples.resize( samples.size() + sz );
+                files[i]->Read( samples.data() + samples.size() - sz, sz );
+                sizes.push_back( sz );
+            }
+        }
+    }
+    files.clear();
+
+    ZDICT_fastCover_params_t params = {};
+    params.d = 8;
+    params.k = 2000;
+    params.nbThreads = std::thread::hardware_concurrency();
+    params.zParams.compressionLevel = 3;
+
+    auto dict = std::unique_ptr<char[]>( new char[DictSize] );
+    const auto dictSize = ZDICT_trainFromBuffer_fastCover( dict.get(), DictSize, samples.data(), sizes.data(), sizes.size(), params );
+    if( ZDICT_isError( dictSize ) )
+    {
+        fprintf( stderr, "Cannot train dictionary: %s\n", ZDICT_getErrorName( dictSize ) );
+        exit( 1 );
+    }
+
+    FILE* f = fopen( output, "wb" );
+    if( !f || fwrite( dict.get(), 1, dictSize, f ) != dictSize )
+    {
+        fprintf( stderr, "Cannot write dictionary!\n" );
+        exit( 1 );
+    }
+    fclose( f );
+    printf( "Dictionary %s {%s} trained on %s of data written to %s\n", tracy::GetDictionaryFileName( tracy::GetDictionaryHash( dict.get(), dictSize ) ).c_str(),
+        tracy::MemSizeToString( dictSize ), tracy::MemSizeToString( samples.size() ), output );
+}
+
+static bool IsSameFile( const char* a, const char* b )
+{
+#ifdef _WIN32
+    char pa[_MAX_PATH], pb[_MAX_PATH];
+    return _fullpath( pa, a, _MAX_PATH ) && _fullpath( pb, b, _MAX_PATH ) && _stricmp( pa, pb ) == 0;
+#else
+    struct stat sa, sb;
+    return stat( a, &sa ) == 0 && stat( b, &sb ) == 0 && sa.st_dev == sb.st_dev && sa.st_ino == sb.st_ino;
+#endif
+}
+
+// Chunks end where the rolling hash of the last 64 bytes has its top bits clear, so data which is the same in two
+// traces is split into the same chunks, no matter where it is placed in the traces. This gives 20 KB chunks on
+// average, which is a trade-off between finding the shared data and compressing each chunk well.
+enum { ChunkMinSize = 4 * 1024 };
+enum : uint64_t { ChunkMask = ~0ull << ( 64 - 14 ) };
+
+struct PackHash
+{
+    size_t operator()( const XXH128_hash_t& hash ) const { return hash.low64; }
+};
+
+struct PackHashEqual
+{
+    bool operator()( const XXH128_hash_t& lhs, const XXH128_hash_t& rhs ) const { return XXH128_isEqual( lhs, rhs ); }
+};
+
+static size_t FindChunkEnd( const char* data, size_t size, const uint64_t* gear )
+{
+    if( size <= ChunkMinSize ) return size;
+    const auto limit = std::min<size_t>( size, tracy::PackChunkMaxSize );
+    uint64_t hash = 0;
+    for( size_t i=ChunkMinSize; i<limit; i++ )
+    {
+        hash = ( hash << 1 ) + gear[(uint8_t)data[i]];
+        if( ( hash & ChunkMask ) == 0 ) return i+1;
+    }
+    return limit;
+}
+
+// Opens the pack, or creates it, and collects its records. An incomplete record at the end of the pack, which
+// is left behind when an update is interrupted, is removed. The pack is locked until it's closed with ClosePack(),
+// so that any number of updates can add to it at the same time. Writes always go to the end of the pack.
+static FILE* OpenPack( const std::string& path, std::unordered_map<XXH128_hash_t, uint64_t, PackHash, PackHashEqual>& records, uint64_t& end )
+{
+    FILE* f = fopen( path.c_str(), "a+b" );
+    if( !f ) return nullptr;
+#ifdef _WIN32
+    OVERLAPPED overlapped = {};
+    if( !LockFileEx( (HANDLE)_get_osfhandle( _fileno( f ) ), LOCKFILE_EXCLUSIVE_LOCK, 0, MAXDWORD, MAXDWORD, &overlapped ) )
+#else
+    if( flock( fileno( f ), LOCK_EX ) != 0 )
+#endif
+    {
+        fclose( f );
+        return nullptr;
+    }
+
+    fseeko64( f, 0, SEEK_END );
+    const uint64_t size = ftello64( f );
+    if( size == 0 )
+    {
+        fwrite( tracy::PackHeader, 1, sizeof( tracy::PackHeader ), f );
+        end = sizeof( tracy::PackHeader );
+        return f;
+    }
+
+    char hdr[sizeof( tracy::PackHeader )];
+    fseeko64( f, 0, SEEK_SET );
+    if( fread( hdr, 1, sizeof( hdr ), f ) != sizeof( hdr ) || memcmp( hdr, tracy::PackHeader, sizeof( hdr ) ) != 0 )
+    {
+        fclose( f );
+        return nullptr;
+    }
+
+    end = sizeof( hdr );
+    fseeko64( f, end, SEEK_SET );
+    tracy::PackRecord rec;
+    while( fread( &rec, 1, sizeof( rec ), f ) == sizeof( rec ) && end + sizeof( rec ) + rec.compressedSize <= size )
+    {
+        records.emplace( rec.hash, end );
+        end += sizeof( rec ) + rec.compressedSize;
+        fseeko64( f, end, SEEK_SET );
+    }
+    if( end != size )
+    {
+        fprintf( stderr, "Removing incomplete record at the end of %s.\n", path.c_str() );
+        fflush( f );
+#ifdef _WIN32
+        _chsize_s( _fileno( f ), end );
+#else
+        if( ftruncate( fileno( f ), end ) != 0 )
+        {
+            fclose( f );
+            return nullptr;
+        }
+#endif
+    }
+    fseeko64( f, end, SEEK_SET );
+    return f;
+}
+
+// Returns false if the new records couldn't be written.
+static bool ClosePack( FILE* f )
+{
+    const auto ok = fflush( f ) == 0 && !ferror( f );
+#ifdef _WIN32
+    OVERLAPPED overlapped = {};
+    UnlockFileEx( (HANDLE)_get_osfhandle( _fileno( f ) ), 0, MAXDWORD, MAXDWORD, &overlapped );
+#endif
+    fclose( f );
+    return ok;
+}
+
+// The trace data is split into chunks, which are stored in the pack, unless the pack already has them. The output
+// file, written to target, only lists the chunks. The data is archived as it is, without conversion to the current
+// format.
+static void ArchiveTrace( tracy::FileRead& f, const char* input, const char* output, const char* target, const char* packName, int level )
+{
+    if( strpbrk( packName, "/\\" ) || strlen( packName ) > std::numeric_limits<uint16_t>::max() )
+    {
+        fprintf( stderr, "The pack has to be given as a file name, it is kept in the directory of the output file.\n" );
+        exit( 1 );
+    }
+    if( !f.IsSeekable() )
+    {
+        fprintf( stderr, "%s is a legacy trace, convert it first.\n", input );
+        exit( 1 );
+    }
+
+    const auto t0 = std::chrono::high_resolution_clock::now();
+    const auto path = tracy::GetDirectory( output ) + packName;
+    std::unordered_map<XXH128_hash_t, uint64_t, PackHash, PackHashEqual> records;
+    uint64_t end;
+    FILE* pack = OpenPack( path, records, end );
+    if( !pack )
+    {
+        fprintf( stderr, "Cannot open pack %s!\n", path.c_str() );
+        exit( 1 );
+    }
+    const auto packStart = end;
+
+    // The gear table sets the chunk boundaries. It must not change, or the chunks of new traces won't match the
+    // chunks already in the packs.
+    uint64_t gear[256];
+    uint64_t seed = 0x9e3779b97f4a7c15;
+    for( auto& v : gear )
+    {
+        seed += 0x9e3779b97f4a7c15;
+        auto z = seed;
+        z = ( z ^ ( z >> 30 ) ) * 0xbf58476d1ce4e5b9;
+        z = ( z ^ ( z >> 27 ) ) * 0x94d049bb133111eb;
+        v = z ^ ( z >> 31 );
+    }
+
+    auto zstd = ZSTD_createCCtx();
+    ZSTD_CCtx_setParameter( zstd, ZSTD_c_compressionLevel, level );
+    std::vector<char> dst( ZSTD_COMPRESSBOUND( tracy::PackChunkMaxSize ) );
+    std::vector<char> buf( tracy::FileBlockSize + tracy::PackChunkMaxSize );
+    std::vector<std::pair<XXH128_hash_t, uint64_t>> chunks;
+    size_t pos = 0;
+    size_t len = 0;
+    size_t added = 0;
+    auto remaining = f.GetSize();
+    const auto dataSize = remaining;
+    for(;;)
+    {
+        // A chunk may only be cut short at the end of the data.
+        if( len - pos < tracy::PackChunkMaxSize && remaining > 0 )
+        {
+            memmove( buf.data(), buf.data() + pos, len - pos );
+            len -= pos;
+            pos = 0;
+            const auto sz = std::min<uint64_t>( remaining, buf.size() - len );
+            f.Read( buf.data() + len, sz );
+            len += sz;
+            remaining -= sz;
+        }
+        if( pos == len ) break;
+
+        const auto size = FindChunkEnd( buf.data() + pos, len - pos, gear );
+        const auto hash = XXH3_128bits( buf.data() + pos, size );
+        auto it = records.find( hash );
+        if( it == records.end() )
+        {
+            const auto csz = ZSTD_compress2( zstd, dst.data(), dst.size(), buf.data() + pos, size );
+            assert( !ZSTD_isError( csz ) );
+            const tracy::PackRecord rec = { hash, uint32_t( size ), uint32_t( csz ) };
+            fwrite( &rec, 1, sizeof( rec ), pack );
+            fwrite( dst.data(), 1, csz, pack );
+            it = records.emplace( hash, end ).first;
+            end += sizeof( rec ) + csz;
+            added++;
+        }
+        chunks.emplace_back( hash, it->second );
+        pos += size;
+    }
+    ZSTD_freeCCtx( zstd );
+
+    // The pack has to be complete before anything refers to its new records.
+    if( !ClosePack( pack ) )
+    {
+        fprintf( stderr, "Cannot write pack %s!\n", path.c_str() );
+        exit( 1 );
+    }
+
+    FILE* out = fopen( target, "wb" );
+    if( !out )
+    {
+        fprintf( stderr, "Cannot open output file!\n" );
+        exit( 1 );
+    }
+    const auto type = tracy::FileCompression::Archive;
+    const uint16_t nameLen = strlen( packName );
+    const uint64_t cnt = chunks.size();
+    fwrite( tracy::BlockHeader, 1, sizeof( tracy::BlockHeader ), out );
+    fwrite( &type, 1, sizeof( type ), out );
+    fwrite( &nameLen, 1, sizeof( nameLen ), out );
+    fwrite( packName, 1, nameLen, out );
+    fwrite( &cnt, 1, sizeof( cnt ), out );
+    for( auto& v : chunks )
+    {
+        fwrite( &v.first, 1, sizeof( v.first ), out );
+        fwrite( &v.second, 1, sizeof( v.second ), out );
+    }
+    const uint64_t outSize = ftello64( out );
+    fclose( out );
+
+    FILE* in = fopen( input, "rb" );
+    fseek( in, 0, SEEK_END );
+    const auto inSize = ftello64( in );
+    fclose( in );
+
+    const auto t1 = std::chrono::high_resolution_clock::now();
+    printf( "%s {%s} -> %s {%s}, %s of data in %zu chunks, %zu new  %s\n", input, tracy::MemSizeToString( inSize ), output,
+        tracy::MemSizeToString( outSize ), tracy::MemSizeToString( dataSize ), chunks.size(), added,
+        tracy::TimeToString( std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count() ) );
+    printf( "Pack %s {%s}, %s added\n", path.c_str(), tracy::MemSizeToString( end ), tracy::MemSizeToString( end - packStart ) );
+}
+
 int main( int argc, char** argv )
 {
 #ifdef _WIN32
@@ -53,13 +392,18 @@ int main( int argc, char** argv )
     tracy::FileWrite::Compression clev = tracy::FileWrite::Compression::Fast;
     uint32_t events = tracy::EventType::All;
     int zstdLevel = 1;
+    int threads = -1;
     bool buildDict = false;
     bool cacheSource = false;
     bool resolveSymbols = false;
+    bool analysisCache = false;
+    const char* dictFile = nullptr;
+    const char* trainDict = nullptr;
+    const char* packName = nullptr;
     std::vector<std::string> pathSubstitutions;
 
     int c;
-    while( ( c = getopt( argc, argv, "hez:ds:crp:" ) ) != -1 )
+    while( ( c = getopt( argc, argv, "hez:D:j:ds:crp:at:A:" ) ) != -1 )
     {
         switch( c )
         {
@@ -78,6 +422,12 @@ int main( int argc, char** argv )
                 exit( 1 );
             }
             break;
+        case 'D':
+            dictFile = optarg;
+            break;
+        case 'j':
+            threads = atoi( optarg );
+            break;
         case 'd':
             buildDict = true;
             break;
@@ -132,76 +482,210 @@ int main( int argc, char** argv )
         case 'p':
             pathSubstitutions.push_back(optarg);
             break;
+        case 'a':
+            analysisCache = true;
+            break;
+        case 't':
+            trainDict = optarg;
+            break;
+        case 'A':
+            packName = optarg;
+            break;
         default:
             Usage();
             break;
         }
     }
 
+    if( trainDict )
+    {
+        if( argc == optind ) Usage();
+        try
+        {
+            TrainDictionary( trainDict, argv + optind, argc - optind );
+        }
+        catch( const tracy::NotTracyDump& e )
+        {
+            fprintf( stderr, "The file you are trying to open is not a tracy dump.\n" );
+            exit( 1 );
+        }
+        catch( const tracy::FileReadError& e )
+        {
+            fprintf( stderr, "The file you are trying to open cannot be mapped to memory.\n" );
+            exit( 1 );
+        }
+        return 0;
+    }
+
     if (argc != optind + 2) Usage();
 
     const char* input = argv[optind];
     const char* output = argv[optind+1];
 
-    printf( "Loading...\r" );
-    fflush( stdout );
-    auto f = std::unique_ptr<tracy::FileRead>( tracy::FileRead::Open( input ) );
-    if( !f )
+    std::vector<char> dict;
+    if( dictFile )
+    {
+        FILE* df = fopen( dictFile, "rb" );
+        if( !df )
+        {
+            fprintf( stderr, "Cannot open dictionary file!\n" );
+            exit( 1 );
+        }
+        fseek( df, 0, SEEK_END );
+        dict.resize( ftell( df ) );
+        fseek( df, 0, SEEK_SET );
+        if( fread( dict.data(), 1, dict.size(), df ) != dict.size() )
+        {
+            fprintf( stderr, "Cannot read dictionary file!\n" );
+            exit( 1 );
+        }
+        fclose( df );
+        // The fast Zstd levels make little use of the dictionary.
+        if( clev != tracy::FileWrite::Compression::Zstd ) zstdLevel = 3;
+        clev = tracy::FileWrite::Compression::Zstd;
+    }
+
+    if( packName && ( dictFile || buildDict || cacheSource || resolveSymbols || events != tracy::EventType::All || clev == tracy::FileWrite::Compression::Slow || clev == tracy::FileWrite::Compression::Extreme ) )
     {
-        fprintf( stderr, "Cannot open input file!\n" );
+        fprintf( stderr, "Traces are stored in a pack as they are, convert them first.\n" );
         exit( 1 );
     }
 
     try
     {
-        int64_t t;
-        float ratio;
-        int inVer;
+        printf( "Loading...\r" );
+        fflush( stdout );
+        auto f = std::unique_ptr<tracy::FileRead>( tracy::FileRead::Open( input ) );
+        if( !f )
         {
-            const auto t0 = std::chrono::high_resolution_clock::now();
-            const bool allowBgThreads = false;
-            const bool allowStringModification = resolveSymbols;
-            tracy::Worker worker( *f, (tracy::EventType::Type)events, allowBgThreads, allowStringModification);
+            fprintf( stderr, "Cannot open input file!\n" );
+            exit( 1 );
+        }
+
+        // The input is mapped into memory, so it can't be overwritten while it's being read. When the output is the
+        // input, it is written next to it and moved in place once the input is closed.
+        const bool inPlace = IsSameFile( input, output );
+        const auto target = inPlace ? std::string( output ) + ".tmp" : std::string( output );
+
+        if( packName )
+        {
+            ArchiveTrace( *f, input, output, target.c_str(), packName, clev == tracy::FileWrite::Compression::Zstd ? zstdLevel : 3 );
+        }
+        else
+        {
+            int64_t t;
+            float ratio;
+            int inVer;
+            {
+                const auto t0 = std::chrono::high_resolution_clock::now();
+                auto w = std::unique_ptr<tracy::FileWrite>( tracy::FileWrite::Open( target.c_str(), clev, zstdLevel, threads, dict.empty() ? nullptr : dict.data(), dict.size() ) );
+                if( !w )
+                {
+                    fprintf( stderr, "Cannot open output file!\n" );
+                    exit( 1 );
+                }
+
+                // Recompression and stripping of the indexed sections don't need the trace to be loaded into memory.
+                if( !buildDict && !cacheSource && !resolveSymbols && tracy::Worker::CopyTrace( *f, *w, (tracy::EventType::Type)events ) )
+                {
+                    inVer = tracy::FileVersion( tracy::Version::Major, tracy::Version::Minor, tracy::Version::Patch );
+                }
+                else
+                {
+                    const bool allowBgThreads = false;
+                    const bool allowStringModification = resolveSymbols;
+                    tracy::Worker worker( *f, (tracy::EventType::Type)events, allowBgThreads, allowStringModification);
 
 #ifndef TRACY_NO_STATISTICS
-            while( !worker.AreSourceLocationZonesReady() ) std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+                    while( !worker.AreSourceLocationZonesReady() ) std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
 #endif
 
-            if( cacheSource ) worker.CacheSourceFiles();
+                    if( cacheSource ) worker.CacheSourceFiles();
+
+                    if ( resolveSymbols ) PatchSymbols( worker, pathSubstitutions );
+
+                    printf( "Saving... \r" );
+                    fflush( stdout );
+                    worker.Write( *w, buildDict );
+                    inVer = worker.GetTraceVersion();
+                }
+                w->Finish();
+                const auto t1 = std::chrono::high_resolution_clock::now();
+                const auto stats = w->GetCompressionStatistics();
+                ratio = 100.f * stats.second / stats.first;
+                t = std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count();
+            }
+
+            FILE* in = fopen( input, "rb" );
+            fseek( in, 0, SEEK_END );
+            const auto inSize = ftello64( in );
+            fclose( in );
 
-            if ( resolveSymbols ) PatchSymbols( worker, pathSubstitutions );
+            FILE* out = fopen( target.c_str(), "rb" );
+            fseek( out, 0, SEEK_END );
+            const auto outSize = ftello64( out );
+            fclose( out );
 
-            auto w = std::unique_ptr<tracy::FileWrite>( tracy::FileWrite::Open( output, clev, zstdLevel ) );
-            if( !w )
+            printf( "%s (%i.%i.%i) {%s} -> %s (%i.%i.%i) {%s, %.2f%%}  %s, %.2f%% change\n",
+                input, inVer >> 16, ( inVer >> 8 ) & 0xFF, inVer & 0xFF, tracy::MemSizeToString( inSize ),
+                output, tracy::Version::Major, tracy::Version::Minor, tracy::Version::Patch, tracy::MemSizeToString( outSize ), ratio,
+                tracy::TimeToString( t ), float( outSize ) / inSize * 100 );
+
+            if( !dict.empty() )
             {
-                fprintf( stderr, "Cannot open output file!\n" );
+                // The output can only be read with the dictionary in its directory.
+                const auto path = tracy::GetDirectory( output ) + tracy::GetDictionaryFileName( tracy::GetDictionaryHash( dict.data(), dict.size() ) );
+                FILE* df = fopen( path.c_str(), "rb" );
+                if( df )
+                {
+                    fclose( df );
+                }
+                else
+                {
+                    df = fopen( path.c_str(), "wb" );
+                    if( !df || fwrite( dict.data(), 1, dict.size(), df ) != dict.size() )
+                    {
+                        fprintf( stderr, "Cannot write dictionary %s!\n", path.c_str() );
+                        exit( 1 );
+                    }
+                    fclose( df );
+                    printf( "Dictionary copied to %s\n", path.c_str() );
+                }
+            }
+        }
+
+        if( inPlace )
+        {
+            f.reset();
+#ifdef _WIN32
+            remove( output );
+#endif
+            if( rename( target.c_str(), output ) != 0 )
+            {
+                fprintf( stderr, "Cannot replace %s with %s!\n", output, target.c_str() );
                 exit( 1 );
             }
-            printf( "Saving... \r" );
+        }
+
+        if( analysisCache )
+        {
+            // The cache refers to the positions of timelines in the output file, which are known once it's loaded.
+            printf( "Writing analysis cache...\r" );
             fflush( stdout );
-            worker.Write( *w, buildDict );
-            w->Finish();
-            const auto t1 = std::chrono::high_resolution_clock::now();
-            const auto stats = w->GetCompressionStatistics();
-            ratio = 100.f * stats.second / stats.first;
-            inVer = worker.GetTraceVersion();
-            t = std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count();
-        }
-
-        FILE* in = fopen( input, "rb" );
-        fseek( in, 0, SEEK_END );
-        const auto inSize = ftello64( in );
-        fclose( in );
-
-        FILE* out = fopen( output, "rb" );
-        fseek( out, 0, SEEK_END );
-        const auto outSize = ftello64( out );
-        fclose( out );
-
-        printf( "%s (%i.%i.%i) {%s} -> %s (%i.%i.%i) {%s, %.2f%%}  %s, %.2f%% change\n",
-            input, inVer >> 16, ( inVer >> 8 ) & 0xFF, inVer & 0xFF, tracy::MemSizeToString( inSize ),
-            output, tracy::Version::Major, tracy::Version::Minor, tracy::Version::Patch, tracy::MemSizeToString( outSize ), ratio,
-            tracy::TimeToString( t ), float( outSize ) / inSize * 100 );
+            auto o = std::unique_ptr<tracy::FileRead>( tracy::FileRead::Open( output ) );
+            if( !o )
+            {
+                fprintf( stderr, "Cannot open output file!\n" );
+                exit( 1 );
+            }
+            tracy::Worker worker( *o, tracy::EventType::None, false );
+            if( !worker.WriteAnalysisCache() )
+            {
+                fprintf( stderr, "Cannot write analysis cache!\n" );
+                exit( 1 );
+            }
+            printf( "Analysis cache written to %s\n", tracy::Worker::GetAnalysisCachePath( output ).c_str() );
+        }
     }
     catch( const tracy::UnsupportedVersion& e )
     {
@@ -213,6 +697,16 @@ int main( int argc, char** argv )
         fprintf( stderr, "The file you are trying to open is not a tracy dump.\n" );
         exit( 1 );
     }
+    catch( const tracy::DictionaryNotFound& e )
+    {
+        fprintf( stderr, "The file you are trying to open needs the dictionary %s.\n", e.path.c_str() );
+        exit( 1 );
+    }
+    catch( const tracy::PackNotFound& e )
+    {
+        fprintf( stderr, "The file you are trying to open needs the pack %s.\n", e.path.c_str() );
+        exit( 1 );
+    }
     catch( const tracy::FileReadError& e )
     {
         fprintf( stderr, "The file you are trying to open cannot be mapped to memory.\n" );
@@ -223,6 +717,11 @@ int main( int argc, char** argv )
         fprintf( stderr, "The file you are trying to open is from a legacy version.\n" );
         exit( 1 );
     }
+    catch( const tracy::LoadFailure& e )
+    {
+        fprintf( stderr, "Failed to load the file: %s\n", e.msg.c_str() );
+        exit( 1 );
+    }
 
     return 0;
 }